@@ -0,0 +1,157 @@
+#ifndef _HEAP_COUNTER_HPP_INCLUDED_
+#define _HEAP_COUNTER_HPP_INCLUDED_
+
+// Replacement global allocation functions keeping `heap_in_use` up to date,
+// for the memory figures of the benchmarks. They are defined here: include
+// this header in a single translation unit of the program.
+//
+// Every form is replaced (single object and array, nothrow, sized deletes,
+// and the std::align_val_t forms when the compiler has aligned new), so that
+// no block is allocated by one family and released by the other.
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Heap bytes in use, counted by the global allocation functions: each block
+// starts with a header holding its size
+static std::size_t heap_in_use = 0;
+static const std::size_t block_header = sizeof(std::max_align_t);
+
+// Header size of the blocks aligned to @align: the header keeps the user
+// part aligned
+static std::size_t header_size(std::size_t align) noexcept {
+    return align > block_header ? align : block_header;
+}
+
+// counted_allocate - A block of @n bytes aligned to @align, or nullptr
+static void *counted_allocate(std::size_t n, std::size_t align) noexcept {
+    std::size_t header = header_size(align);
+    char *block;
+    if (align <= block_header) {
+        block = static_cast<char*>(std::malloc(n + header));
+    } else {
+#if defined(__cpp_aligned_new)
+        // aligned_alloc wants a multiple of the alignment
+        block = static_cast<char*>(std::aligned_alloc(align, (n + header + align - 1) / align * align));
+#else
+        block = nullptr;
+#endif
+    }
+    if (!block) {
+        return nullptr;
+    }
+    std::memcpy(block, &n, sizeof(n));
+    heap_in_use += n;
+    return block + header;
+}
+
+// Out of line: inlined into the containers, the header access looks out of
+// bounds to the compiler
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void counted_release(void *ptr, std::size_t align) noexcept {
+    if (ptr) {
+        char *block = static_cast<char*>(ptr) - header_size(align);
+        std::size_t n;
+        std::memcpy(&n, block, sizeof(n));
+        heap_in_use -= n;
+        std::free(block);
+    }
+}
+
+static void *counted_new(std::size_t n, std::size_t align) {
+    void *ptr = counted_allocate(n, align);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new(std::size_t n) {
+    return counted_new(n, 0);
+}
+
+void *operator new[](std::size_t n) {
+    return counted_new(n, 0);
+}
+
+void *operator new(std::size_t n, std::nothrow_t const &) noexcept {
+    return counted_allocate(n, 0);
+}
+
+void *operator new[](std::size_t n, std::nothrow_t const &) noexcept {
+    return counted_allocate(n, 0);
+}
+
+#if defined(__cpp_aligned_new)
+void *operator new(std::size_t n, std::align_val_t align) {
+    return counted_new(n, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t n, std::align_val_t align) {
+    return counted_new(n, static_cast<std::size_t>(align));
+}
+
+void *operator new(std::size_t n, std::align_val_t align, std::nothrow_t const &) noexcept {
+    return counted_allocate(n, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t n, std::align_val_t align, std::nothrow_t const &) noexcept {
+    return counted_allocate(n, static_cast<std::size_t>(align));
+}
+#endif
+
+void operator delete(void *ptr) noexcept {
+    counted_release(ptr, 0);
+}
+
+void operator delete[](void *ptr) noexcept {
+    counted_release(ptr, 0);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    counted_release(ptr, 0);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    counted_release(ptr, 0);
+}
+
+void operator delete(void *ptr, std::nothrow_t const &) noexcept {
+    counted_release(ptr, 0);
+}
+
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept {
+    counted_release(ptr, 0);
+}
+
+#if defined(__cpp_aligned_new)
+void operator delete(void *ptr, std::align_val_t align) noexcept {
+    counted_release(ptr, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void *ptr, std::align_val_t align) noexcept {
+    counted_release(ptr, static_cast<std::size_t>(align));
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t align) noexcept {
+    counted_release(ptr, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t align) noexcept {
+    counted_release(ptr, static_cast<std::size_t>(align));
+}
+
+void operator delete(void *ptr, std::align_val_t align, std::nothrow_t const &) noexcept {
+    counted_release(ptr, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void *ptr, std::align_val_t align, std::nothrow_t const &) noexcept {
+    counted_release(ptr, static_cast<std::size_t>(align));
+}
+#endif
+
+#endif // _HEAP_COUNTER_HPP_INCLUDED_
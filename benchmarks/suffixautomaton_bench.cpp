@@ -0,0 +1,102 @@
+// Suffix automaton against suffix tree on repetitive collections: memory
+// (heap bytes in use after construction), construction time and query
+// throughput of is_substring and count.
+//
+//   cmake --build build --target suffixautomaton_bench
+//   build/benchmarks/suffixautomaton_bench [total length]
+
+#include "suffixtree.h"
+#include "suffixautomaton.h"
+#include "heapcounter.h"
+#include "corpus.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using corpus::Corpus;
+
+// Half substrings of the corpus, half random strings
+static std::vector<std::string> make_queries(Corpus const & corpus, std::size_t n, std::mt19937 & rng) {
+    std::vector<std::string> queries;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t len = 8 + rng() % 25;
+        std::string const & s = corpus[rng() % corpus.size()];
+        if (0 == i % 2 && s.size() > len) {
+            queries.push_back(s.substr(rng() % (s.size() - len), len));
+        } else {
+            std::string q(len, 'a');
+            for (auto & c : q) {
+                c = "acgt"[rng() % 4];
+            }
+            queries.push_back(q);
+        }
+    }
+    return queries;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Index>
+static void run(const char *index_name, const char *corpus_name, Corpus const & corpus,
+                std::vector<std::string> const & queries, std::size_t total) {
+    std::size_t before = heap_in_use;
+    auto start = std::chrono::steady_clock::now();
+    Index *index = new Index();
+    for (auto const & s : corpus) {
+        index->add_string(s.begin(), s.end());
+    }
+    double build = seconds_since(start);
+    std::size_t bytes = heap_in_use - before;
+
+    // Each query loop stops after max_seconds (the tree's count visits every
+    // occurrence, which takes long on the most repetitive corpora)
+    const double max_seconds = 2;
+    std::size_t found = 0;
+    std::size_t done = 0;
+    start = std::chrono::steady_clock::now();
+    for (; done < queries.size() && (0 != done % 256 || seconds_since(start) < max_seconds); ++done) {
+        found += index->is_substring(queries[done].begin(), queries[done].end());
+    }
+    double membership = done / seconds_since(start);
+    std::size_t occurrences = index->count(queries[0].begin(), queries[0].end());
+    start = std::chrono::steady_clock::now();
+    for (done = 0; done < queries.size() && (0 != done % 256 || seconds_since(start) < max_seconds); ++done) {
+        occurrences += index->count(queries[done].begin(), queries[done].end());
+    }
+    double counting = done / seconds_since(start);
+
+    std::printf("%-12s %-10s %8.1f B/char %8.3f s build %10.0f is_substring/s %10.0f count/s\n",
+                corpus_name, index_name, double(bytes) / total, build, membership, counting);
+    // Keeps the query loops from being optimized away
+    if (found + occurrences == 0) {
+        std::printf("(no match)\n");
+    }
+    std::fflush(stdout);
+    delete index;
+}
+
+int main(int argc, char **argv) {
+    std::size_t total = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 300000;
+    std::mt19937 rng(42);
+    std::size_t strings = std::max<std::size_t>(total / 10000, 1);
+    struct Named {
+        const char *name;
+        Corpus corpus;
+    };
+    std::vector<Named> corpora;
+    corpora.push_back(Named{"copies-0.1%", corpus::mutated_genome(total, strings, 0.001, 42)});
+    corpora.push_back(Named{"copies-1%", corpus::mutated_genome(total, strings, 0.01, 42)});
+    corpora.push_back(Named{"fibonacci", corpus::fibonacci(total, strings)});
+    corpora.push_back(Named{"uniform", corpus::uniform(total, strings, 4, 42)});
+    for (auto const & c : corpora) {
+        std::vector<std::string> queries = make_queries(c.corpus, 20000, rng);
+        run<SuffixTree<char>>("tree", c.name, c.corpus, queries, total);
+        run<SuffixAutomaton<char>>("automaton", c.name, c.corpus, queries, total);
+    }
+}
@@ -0,0 +1,198 @@
+// SuffixTree construction, queries and teardown, with Google Benchmark.
+//
+// The generated inputs (corpus.h) take four arguments: the total length, the
+// alphabet size, the number of strings, and the corpus kind (0 uniform,
+// 1 mutated genomes, 2 Fibonacci word, 3 tandem repeats, 4 Zipf words).
+//   - AddString: add_string throughput (MB/s), and the heap bytes held by
+//     the tree per input character (bytes_per_char)
+//   - IsSubstring, IsSuffix: one query per iteration, so the time column is
+//     the latency in ns/query; half of the queries match
+//   - Destroy: time to free a tree
+//
+// With SUFFIXTREE_CORPUS set to a file (one string per line, as written by
+// corpusgen), the same benchmarks also run on it, as "<name>/file".
+//
+//   cmake -S .. -B build && cmake --build build --target suffixtree_bench
+//   build/benchmarks/suffixtree_bench --benchmark_filter=AddString
+
+#include "suffixtree.h"
+#include "heapcounter.h"
+#include "corpus.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using corpus::Corpus;
+
+// The corpus kinds of the last argument
+enum CorpusKind {
+    uniform_text,
+    genome,
+    fibonacci_word,
+    tandem_repeats,
+    zipf_words
+};
+
+static Corpus make_corpus(benchmark::State const & state) {
+    std::size_t length = state.range(0);
+    std::size_t sigma = state.range(1);
+    std::size_t strings = state.range(2);
+    switch (state.range(3)) {
+    case genome:
+        return corpus::mutated_genome(length, strings, 0.01, 42);
+    case fibonacci_word:
+        return corpus::fibonacci(length, strings);
+    case tandem_repeats:
+        return corpus::tandem(length, strings, 7, sigma, 42);
+    case zipf_words:
+        return corpus::zipf_text(length, strings, 10000, 1.1, 42);
+    default:
+        return corpus::uniform(length, strings, sigma, 42);
+    }
+}
+
+// The characters of a corpus
+static std::string symbols_of(Corpus const & c) {
+    std::set<char> seen;
+    for (auto const & s : c) {
+        seen.insert(s.begin(), s.end());
+    }
+    return seen.empty() ? std::string("a") : std::string(seen.begin(), seen.end());
+}
+
+static SuffixTree<char> *build(Corpus const & corpus) {
+    SuffixTree<char> *tree = new SuffixTree<char>();
+    for (auto const & s : corpus) {
+        tree->add_string(s.begin(), s.end());
+    }
+    return tree;
+}
+
+// Half substrings (or suffixes) of the corpus, half random strings
+static Corpus make_queries(Corpus const & corpus, std::string const & symbols, bool suffixes) {
+    std::mt19937 rng(7);
+    Corpus queries;
+    for (std::size_t i = 0; i < 4096; ++i) {
+        std::size_t len = 8 + rng() % 25;
+        std::string const & s = corpus[rng() % corpus.size()];
+        if (0 == i % 2 && s.size() > len) {
+            std::size_t start = suffixes ? s.size() - len : rng() % (s.size() - len);
+            queries.push_back(s.substr(start, len));
+        } else {
+            std::string q(len, symbols[0]);
+            for (auto & c : q) {
+                c = symbols[rng() % symbols.size()];
+            }
+            queries.push_back(q);
+        }
+    }
+    return queries;
+}
+
+static void add_string(benchmark::State & state, Corpus const & corpus) {
+    std::size_t total = corpus::total_length(corpus);
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        std::size_t before = heap_in_use;
+        SuffixTree<char> *tree = build(corpus);
+        bytes = heap_in_use - before;
+        state.PauseTiming();
+        delete tree;
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+    state.counters["bytes_per_char"] = double(bytes) / total;
+}
+
+template <bool suffix_queries>
+static void query(benchmark::State & state, Corpus const & corpus) {
+    Corpus queries = make_queries(corpus, symbols_of(corpus), suffix_queries);
+    SuffixTree<char> *tree = build(corpus);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        std::string const & q = queries[i++ % queries.size()];
+        bool found = suffix_queries ? tree->is_suffix(q.begin(), q.end()) : tree->is_substring(q.begin(), q.end());
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations());
+    delete tree;
+}
+
+static void destroy(benchmark::State & state, Corpus const & corpus) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        SuffixTree<char> *tree = build(corpus);
+        state.ResumeTiming();
+        delete tree;
+    }
+    state.SetBytesProcessed(state.iterations() * corpus::total_length(corpus));
+}
+
+static void BM_AddString(benchmark::State & state) {
+    add_string(state, make_corpus(state));
+}
+
+static void BM_IsSubstring(benchmark::State & state) {
+    query<false>(state, make_corpus(state));
+}
+
+static void BM_IsSuffix(benchmark::State & state) {
+    query<true>(state, make_corpus(state));
+}
+
+static void BM_Destroy(benchmark::State & state) {
+    destroy(state, make_corpus(state));
+}
+
+// One dimension at a time around DNA-like input: length and corpus kind,
+// alphabet size, number of strings
+static void sweep(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"length", "sigma", "strings", "corpus"});
+    for (long length : {1L << 14, 1L << 17, 1L << 20}) {
+        for (long kind : {uniform_text, genome, fibonacci_word, tandem_repeats, zipf_words}) {
+            if (length < (1L << 20) || kind <= genome) {
+                b->Args({length, 4, 16, kind});
+            }
+        }
+    }
+    for (long sigma : {2, 26, 90}) {
+        b->Args({1L << 17, sigma, 16, uniform_text});
+    }
+    for (long strings : {1, 1024}) {
+        b->Args({1L << 17, 4, strings, uniform_text});
+    }
+}
+
+BENCHMARK(BM_AddString)->Apply(sweep)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IsSubstring)->Apply(sweep);
+BENCHMARK(BM_IsSuffix)->Apply(sweep);
+BENCHMARK(BM_Destroy)->Apply(sweep)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    static Corpus file;
+    if (char const *path = std::getenv("SUFFIXTREE_CORPUS")) {
+        try {
+            file = corpus::read_file(path);
+        } catch (std::exception const & e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        if (!file.empty()) {
+            benchmark::RegisterBenchmark("BM_AddString/file", [](benchmark::State & s) { add_string(s, file); })
+                ->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark("BM_IsSubstring/file", [](benchmark::State & s) { query<false>(s, file); });
+            benchmark::RegisterBenchmark("BM_IsSuffix/file", [](benchmark::State & s) { query<true>(s, file); });
+            benchmark::RegisterBenchmark("BM_Destroy/file", [](benchmark::State & s) { destroy(s, file); })
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
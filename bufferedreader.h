@@ -0,0 +1,160 @@
+#ifndef _BUFFERED_READER_HPP_INCLUDED_
+#define _BUFFERED_READER_HPP_INCLUDED_
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// BufferedReader - Input source with a large read buffer
+//
+// The counterpart of BufferedWriter: the source is read 1 MiB (by default)
+// at a time, and lines, raw bytes and varints are taken from the buffer. The
+// source is a C file, a std::istream or a string.
+//
+// Read errors on a file source, and binary reads past the end of the input,
+// throw std::runtime_error.
+class BufferedReader {
+public:
+    explicit BufferedReader(std::FILE *f, std::size_t capacity = 1 << 20) :
+      buffer(capacity),
+      begin(0),
+      end(0),
+      file(f),
+      stream(nullptr),
+      str(nullptr),
+      str_pos(0)
+      {}
+
+    explicit BufferedReader(std::istream& is, std::size_t capacity = 1 << 20) :
+      buffer(capacity),
+      begin(0),
+      end(0),
+      file(nullptr),
+      stream(&is),
+      str(nullptr),
+      str_pos(0)
+      {}
+
+    explicit BufferedReader(std::string const *s, std::size_t capacity = 1 << 20) :
+      buffer(capacity),
+      begin(0),
+      end(0),
+      file(nullptr),
+      stream(nullptr),
+      str(s),
+      str_pos(0)
+      {}
+
+    BufferedReader(BufferedReader const &) = delete;
+    BufferedReader& operator=(BufferedReader const &) = delete;
+
+    // eof - Whether the whole input has been consumed
+    bool eof() {
+        return begin == end && !fill();
+    }
+
+    // read_line - The next line, without its '\n' (and '\r' before it)
+    // Returns false at the end of the input. The last line may lack its '\n'.
+    bool read_line(std::string *line) {
+        line->clear();
+        bool any = false;
+        while (begin < end || fill()) {
+            any = true;
+            const char *start = buffer.data() + begin;
+            const char *nl = static_cast<const char*>(std::memchr(start, '\n', end - begin));
+            if (nl) {
+                line->append(start, nl - start);
+                begin += nl - start + 1;
+                if (!line->empty() && '\r' == line->back()) {
+                    line->pop_back();
+                }
+                return true;
+            }
+            line->append(start, end - begin);
+            begin = end;
+        }
+        if (!line->empty() && '\r' == line->back()) {
+            line->pop_back();
+        }
+        return any;
+    }
+
+    void read(char *data, std::size_t n) {
+        while (n > 0) {
+            if (begin == end && !fill()) {
+                throw std::runtime_error("BufferedReader: unexpected end of input");
+            }
+            std::size_t chunk = std::min(n, end - begin);
+            std::memcpy(data, buffer.data() + begin, chunk);
+            begin += chunk;
+            data += chunk;
+            n -= chunk;
+        }
+    }
+
+    // read_rest - Append the rest of the input to @out
+    void read_rest(std::string *out) {
+        while (begin < end || fill()) {
+            out->append(buffer.data() + begin, end - begin);
+            begin = end;
+        }
+    }
+
+    // LEB128 encoding (see BufferedWriter::write_varint)
+    std::uint64_t read_varint() {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (begin == end && !fill()) {
+                throw std::runtime_error("BufferedReader: unexpected end of input");
+            }
+            unsigned char byte = static_cast<unsigned char>(buffer[begin++]);
+            v |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return v;
+            }
+        }
+        throw std::runtime_error("BufferedReader: malformed varint");
+    }
+
+    // Native representation of a trivially copyable value
+    template <typename T>
+    void read_raw(T *v) {
+        read(reinterpret_cast<char*>(v), sizeof(T));
+    }
+
+private:
+    // fill - Refill the (consumed) buffer; false at the end of the input
+    bool fill() {
+        begin = 0;
+        end = 0;
+        if (file) {
+            end = std::fread(buffer.data(), 1, buffer.size(), file);
+            if (0 == end && std::ferror(file)) {
+                throw std::runtime_error("BufferedReader: read error");
+            }
+        } else if (stream) {
+            stream->read(buffer.data(), buffer.size());
+            end = static_cast<std::size_t>(stream->gcount());
+        } else {
+            end = std::min(buffer.size(), str->size() - str_pos);
+            std::memcpy(buffer.data(), str->data() + str_pos, end);
+            str_pos += end;
+        }
+        return end > 0;
+    }
+
+    std::vector<char> buffer;
+    std::size_t begin;
+    std::size_t end;
+    std::FILE *file;
+    std::istream *stream;
+    std::string const *str;
+    std::size_t str_pos;
+};
+
+#endif // _BUFFERED_READER_HPP_INCLUDED_
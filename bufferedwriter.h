@@ -0,0 +1,150 @@
+#ifndef _BUFFERED_WRITER_HPP_INCLUDED_
+#define _BUFFERED_WRITER_HPP_INCLUDED_
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// BufferedWriter - Output sink with a large write buffer
+//
+// Text and binary dumps go through this class instead of one `<<` per
+// character: bytes are accumulated in a buffer (1 MiB by default) which is
+// handed to the sink in a single call once full. The sink is a C file, a
+// std::ostream or a std::string.
+//
+// Write errors on a file sink throw std::runtime_error.
+class BufferedWriter {
+public:
+    explicit BufferedWriter(std::FILE *f, std::size_t capacity = 1 << 20) :
+      buffer(capacity),
+      used(0),
+      file(f),
+      stream(nullptr),
+      str(nullptr)
+      {}
+
+    explicit BufferedWriter(std::ostream& os, std::size_t capacity = 1 << 20) :
+      buffer(capacity),
+      used(0),
+      file(nullptr),
+      stream(&os),
+      str(nullptr)
+      {}
+
+    explicit BufferedWriter(std::string *s, std::size_t capacity = 1 << 20) :
+      buffer(capacity),
+      used(0),
+      file(nullptr),
+      stream(nullptr),
+      str(s)
+      {}
+
+    BufferedWriter(BufferedWriter const &) = delete;
+    BufferedWriter& operator=(BufferedWriter const &) = delete;
+
+    ~BufferedWriter() {
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
+    void write(const char *data, std::size_t n) {
+        if (n > buffer.size() - used) {
+            flush();
+            if (n >= buffer.size()) {
+                sink(data, n);
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + used, data, n);
+        used += n;
+    }
+
+    template <std::size_t N>
+    void write(const char (&literal)[N]) {
+        write(literal, N - 1);
+    }
+
+    void write(std::string const & s) {
+        write(s.data(), s.size());
+    }
+
+    void put(char c) {
+        if (used == buffer.size()) {
+            flush();
+        }
+        buffer[used++] = c;
+    }
+
+    // Decimal representation of an integer
+    void write_decimal(std::int64_t v) {
+        char digits[24];
+        std::size_t n = 0;
+        std::uint64_t u = (v < 0) ? 0 - static_cast<std::uint64_t>(v) : static_cast<std::uint64_t>(v);
+        do {
+            digits[sizeof(digits) - 1 - n++] = static_cast<char>('0' + u % 10);
+            u /= 10;
+        } while (0 != u);
+        if (v < 0) {
+            digits[sizeof(digits) - 1 - n++] = '-';
+        }
+        write(digits + sizeof(digits) - n, n);
+    }
+
+    // LEB128 encoding: 7 bits per byte, high bit set on all but the last one
+    void write_varint(std::uint64_t v) {
+        char bytes[10];
+        std::size_t n = 0;
+        while (v >= 0x80) {
+            bytes[n++] = static_cast<char>((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        bytes[n++] = static_cast<char>(v);
+        write(bytes, n);
+    }
+
+    // Native representation of a trivially copyable value
+    template <typename T>
+    void write_raw(T const & v) {
+        write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    void flush() {
+        if (0 != used) {
+            std::size_t n = used;
+            used = 0;
+            sink(buffer.data(), n);
+        }
+        if (file) {
+            std::fflush(file);
+        } else if (stream) {
+            stream->flush();
+        }
+    }
+
+private:
+    void sink(const char *data, std::size_t n) {
+        if (file) {
+            if (std::fwrite(data, 1, n, file) != n) {
+                throw std::runtime_error("BufferedWriter: write error");
+            }
+        } else if (stream) {
+            stream->write(data, n);
+        } else {
+            str->append(data, n);
+        }
+    }
+
+    std::vector<char> buffer;
+    std::size_t used;
+    std::FILE *file;
+    std::ostream *stream;
+    std::string *str;
+};
+
+#endif // _BUFFERED_WRITER_HPP_INCLUDED_
@@ -0,0 +1,316 @@
+#ifndef _COMPRESSED_SUFFIX_TREE_HPP_INCLUDED_
+#define _COMPRESSED_SUFFIX_TREE_HPP_INCLUDED_
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include "suffixtree.h"
+#include "enhancedsuffixarray.h"
+#include "fmindex.h"
+#include "succinct.h"
+
+// CompressedSuffixTree - Suffix tree of a string collection in a few bytes
+// per character
+//
+// Three succinct components replace the pointer-based nodes of SuffixTree:
+//   - the topology, as balanced parentheses (at most 4n bits, the leaves are
+//     the n suffixes in lexicographic order),
+//   - an FMIndex, for the suffix array, its inverse, psi and the text,
+//   - the permuted LCP array PLCP, in unary: PLCP[p] + 2p is increasing, so a
+//     bitvector with ones at those positions takes 2n bits and
+//     LCP[row] = select(SA[row]) - 2 SA[row].
+//
+// A node is the position of its '(' and covers the suffix array rows of the
+// leaves below it. Navigation costs a few operations on the parentheses
+// (O(log n) each) plus, for depths and characters, suffix array lookups
+// (O(sampling rate) LF steps each):
+//   - parent, lca: parentheses only
+//   - string_depth: the LCP at the first row of the second child
+//   - suffix_link: lca of the leaves psi(lb) and psi(rb)
+//   - child: reads the character following the node's path in each child
+//
+// Each string ends with its own end token: a leaf of SuffixTree shared by
+// several strings becomes one leaf per string here, and the tree is the one
+// of EnhancedSuffixArray's lcp-intervals. The suffixes made of an end token
+// alone are children of the root.
+template <typename CharType = char, CharType end_token = '$'>
+class CompressedSuffixTree {
+public:
+    typedef SuffixTree<CharType, end_token> tree_type;
+    typedef EnhancedSuffixArray<CharType, end_token> esa_type;
+    typedef FMIndex<CharType, end_token> fm_type;
+    typedef typename tree_type::string string;
+    typedef typename tree_type::index_type index_type;
+    typedef typename tree_type::SuffixEntry SuffixEntry;
+    typedef typename fm_type::pos_type pos_type;
+    // Position of the node's opening parenthesis
+    typedef std::size_t node_type;
+
+    static const node_type no_node = BalancedParentheses::npos;
+
+private:
+    fm_type fm;
+    BalancedParentheses topology;
+    // Ones at the '(' of the leaves: the rank of a leaf is its row
+    BitVector leaf_marks;
+    // One at PLCP[p] + 2p for each text position p
+    BitVector plcp;
+    std::size_t strings;
+
+    void build(esa_type const & esa) {
+        std::vector<pos_type> const & sa = esa.get_suffix_array();
+        std::size_t n = sa.size();
+        {
+            std::vector<pos_type> plcp_values(n);
+            for (std::size_t row = 0; row < n; ++row) {
+                plcp_values[sa[row]] = esa.get_lcp(row);
+            }
+            std::size_t pos = 0;
+            for (std::size_t p = 0; p < n; ++p) {
+                for (std::size_t one = plcp_values[p] + 2 * p; pos < one; ++pos) {
+                    plcp.push_back(false);
+                }
+                plcp.push_back(true);
+                ++pos;
+            }
+            plcp.build();
+        }
+
+        // Every lcp-interval but the root opens before its first leaf and
+        // closes after its last one
+        std::vector<pos_type> opens(n, 0);
+        std::vector<pos_type> closes(n, 0);
+        std::vector<std::pair<pos_type, pos_type>> stack {std::make_pair(pos_type(0), pos_type(0))};
+        for (std::size_t i = 1; i <= n; ++i) {
+            pos_type l = (i < n) ? esa.get_lcp(i) : 0;
+            pos_type lb = i - 1;
+            while (l < stack.back().first) {
+                lb = stack.back().second;
+                ++opens[lb];
+                ++closes[i - 1];
+                stack.pop_back();
+            }
+            if (l > stack.back().first) {
+                stack.push_back(std::make_pair(l, lb));
+            }
+        }
+
+        auto emit = [this](bool open, bool leaf) {
+            topology.push_back(open);
+            leaf_marks.push_back(leaf);
+        };
+        emit(true, false);
+        for (std::size_t i = 0; i < n; ++i) {
+            for (pos_type k = 0; k < opens[i]; ++k) {
+                emit(true, false);
+            }
+            emit(true, true);
+            emit(false, false);
+            for (pos_type k = 0; k < closes[i]; ++k) {
+                emit(false, false);
+            }
+        }
+        emit(false, false);
+        topology.build();
+        leaf_marks.build();
+    }
+
+    static esa_type make_esa(tree_type const & tree, bool parallel) {
+        return esa_type(tree, parallel);
+    }
+
+    template <typename StringIterator>
+    static esa_type make_esa(StringIterator first, StringIterator last) {
+        esa_type esa;
+        for (; first != last; ++first) {
+            esa.add_string(first->begin(), first->end());
+        }
+        esa.build();
+        return esa;
+    }
+
+    // End tokens sort first
+    static bool symbol_less(CharType a, CharType b) {
+        return a != b && (a == end_token || (b != end_token && a < b));
+    }
+
+    index_type lcp(pos_type row) const {
+        pos_type p = fm.suffix_array(row);
+        return plcp.select1(p) - 2 * std::size_t(p);
+    }
+
+public:
+    // Builds the compressed tree of the strings of a tree, with the same
+    // string ids.
+    // @rate[in]: Suffix array sampling rate of the FM-index
+    // @parallel[in]: Export the tree's suffix array in parallel
+    explicit CompressedSuffixTree(tree_type const & tree, pos_type rate = 32, bool parallel = false) :
+      CompressedSuffixTree(make_esa(tree, parallel), rate)
+      {}
+
+    // Builds the compressed tree from an enhanced suffix array (which must be
+    // built).
+    explicit CompressedSuffixTree(esa_type const & esa, pos_type rate = 32) :
+      fm(esa, rate),
+      strings(esa.string_ids().size()) {
+        build(esa);
+    }
+
+    // Builds the compressed tree of a range of strings (containers of
+    // CharType, without end token), with ids 1, 2, ... A string that is a
+    // suffix of an earlier one is skipped, as by SuffixTree::add_string.
+    template <typename StringIterator>
+    CompressedSuffixTree(StringIterator first, StringIterator last, pos_type rate = 32) :
+      CompressedSuffixTree(make_esa(first, last), rate)
+      {}
+
+    node_type root() const {
+        return 0;
+    }
+
+    bool is_leaf(node_type v) const {
+        return leaf_marks[v];
+    }
+
+    // Number of leaves, i.e. of suffixes (end tokens included)
+    std::size_t size() const {
+        return fm.size();
+    }
+
+    // First suffix array row below a node
+    pos_type lb(node_type v) const {
+        return leaf_marks.rank1(v);
+    }
+
+    // Last suffix array row below a node
+    pos_type rb(node_type v) const {
+        return leaf_marks.rank1(topology.find_close(v)) - 1;
+    }
+
+    // Number of suffixes below a node
+    std::size_t leaf_count(node_type v) const {
+        return rb(v) - lb(v) + 1;
+    }
+
+    // The leaf of a suffix array row
+    node_type leaf(pos_type row) const {
+        return leaf_marks.select1(row);
+    }
+
+    // parent - The parent of a node, no_node for the root
+    node_type parent(node_type v) const {
+        return topology.enclose(v);
+    }
+
+    node_type first_child(node_type v) const {
+        return is_leaf(v) || topology.size() <= 2 ? no_node : v + 1;
+    }
+
+    node_type next_sibling(node_type v) const {
+        node_type w = topology.find_close(v) + 1;
+        return (w < topology.size() && topology.is_open(w)) ? w : no_node;
+    }
+
+    // string_depth - Length of the path label of a node. The path of a leaf
+    // includes its end token.
+    index_type string_depth(node_type v) const {
+        if (is_leaf(v)) {
+            pos_type p = fm.suffix_array(lb(v));
+            return fm.string_end(p) - p + 1;
+        }
+        if (root() == v) {
+            return 0;
+        }
+        node_type first = first_child(v);
+        // The LCP between the last leaf of the first child and the first
+        // leaf of the second one
+        return lcp(lb(next_sibling(first)));
+    }
+
+    // child - The child of a node whose edge starts with c, no_node if none.
+    // Several leaves of an internal node may start with the end token (one
+    // per string): the first one is returned.
+    node_type child(node_type v, CharType c) const {
+        node_type w = first_child(v);
+        if (no_node == w) {
+            return no_node;
+        }
+        index_type depth = string_depth(v);
+        for (; no_node != w; w = next_sibling(w)) {
+            CharType first = fm.char_at(fm.suffix_array(lb(w)) + depth);
+            if (first == c) {
+                return w;
+            }
+            if (symbol_less(c, first)) {
+                break;
+            }
+        }
+        return no_node;
+    }
+
+    // suffix_link - The node whose path label is the one of v without its
+    // first character (the root for the root and for end token leaves)
+    node_type suffix_link(node_type v) const {
+        if (root() == v) {
+            return v;
+        }
+        pos_type first = lb(v);
+        if (first < strings) {
+            // An end token alone: only rows below the number of strings
+            return root();
+        }
+        if (is_leaf(v)) {
+            return leaf(fm.psi(first));
+        }
+        return lca(leaf(fm.psi(first)), leaf(fm.psi(rb(v))));
+    }
+
+    node_type lca(node_type u, node_type v) const {
+        return topology.lca(u, v);
+    }
+
+    // locus - The highest node whose path label starts with a string,
+    // no_node if the string does not occur
+    template <typename InputIterator>
+    node_type locus(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p(str_begin, str_end);
+        pos_type sp, ep;
+        if (!fm.backward_search(p, &sp, &ep)) {
+            return no_node;
+        }
+        return lca(leaf(sp), leaf(ep - 1));
+    }
+
+    // The suffix of a leaf
+    SuffixEntry suffix(node_type v) const {
+        return fm.entry(fm.suffix_array(lb(v)));
+    }
+
+    // path_label - The first characters of the path label of a node
+    // @max_length[in]: Maximum number of characters
+    string path_label(node_type v, index_type max_length) const {
+        index_type depth = string_depth(v);
+        if (0 == depth) {
+            return string();
+        }
+        return fm.extract(fm.suffix_array(lb(v)), std::min(depth, max_length));
+    }
+
+    // The FM-index holding the suffix array and the text, for pattern
+    // queries (count, find_all, extract)
+    fm_type const & index() const {
+        return fm;
+    }
+
+    // Bytes used by the tree
+    std::size_t size_in_bytes() const {
+        return sizeof(*this) +
+            fm.size_in_bytes() - sizeof(fm) +
+            topology.size_in_bytes() - sizeof(topology) +
+            leaf_marks.size_in_bytes() - sizeof(leaf_marks) +
+            plcp.size_in_bytes() - sizeof(plcp);
+    }
+};
+
+#endif // _COMPRESSED_SUFFIX_TREE_HPP_INCLUDED_
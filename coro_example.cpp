@@ -0,0 +1,95 @@
+// Coroutine queries (suffixtree_coro.h): a long enumeration shares one thread
+// with short lookups, and a stream is abandoned after its first results
+#include "suffixtree_coro.h"
+
+#include <iostream>
+#include <random>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+using namespace suffixtree_coro;
+
+typedef SuffixTree<char> Tree;
+
+template <typename T>
+Task<int> report(std::string name, Task<T> task, std::size_t (*size)(T const &)) {
+    try {
+        T result = co_await task;
+        std::cout << name << ": " << size(result) << std::endl;
+    } catch (Cancelled const & e) {
+        std::cout << name << ": " << e.what() << std::endl;
+    }
+    co_return 0;
+}
+
+static std::size_t value(std::size_t const & n) {
+    return n;
+}
+
+static std::size_t length(std::vector<Tree::SuffixEntry> const & v) {
+    return v.size();
+}
+
+Task<int> first_occurrences(Tree const & tree, std::string pattern, RunQueue& queue) {
+    Stream<Tree::SuffixEntry> stream = async_occurrences(tree, pattern.begin(), pattern.end(), queue);
+    for (int i = 0; i < 3; ++i) {
+        if (Tree::SuffixEntry const *e = co_await stream.next()) {
+            std::cout << pattern << " in string " << e->ref_str << " at " << e->offset << std::endl;
+        }
+    }
+    // Destroying the stream stops the enumeration
+    co_return 0;
+}
+
+Task<int> stop_after(int rounds, std::stop_source stop, RunQueue& queue) {
+    for (int i = 0; i < rounds; ++i) {
+        co_await queue.schedule();
+    }
+    stop.request_stop();
+    co_return 0;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    std::vector<std::string> strings(8);
+    Tree tree;
+    for (auto & s : strings) {
+        for (int i = 0; i < 100000; ++i) {
+            s.push_back("acgt"[rng() % 4]);
+        }
+        tree.add_string(s.begin(), s.end());
+    }
+
+    RunQueue queue;
+    std::stop_source stop;
+    YieldOptions options;
+    options.every = 1024;
+    std::vector<Task<int>> tasks;
+    // Scheduled first, but the short queries finish long before it
+    std::string a = "a";
+    tasks.push_back(report<std::size_t>("count(a)", async_count(tree, a.begin(), a.end(), queue, options), value));
+    for (int i = 0; i < 3; ++i) {
+        std::string p = strings[i].substr(1000 * i, 12);
+        tasks.push_back(report<std::vector<Tree::SuffixEntry>>("find_all(" + p + ")",
+            async_find_all(tree, p.begin(), p.end(), queue, 10, options), length));
+    }
+    // Cancelled halfway through by the stop token
+    options.stop = stop.get_token();
+    std::string c = "c";
+    tasks.push_back(report<std::size_t>("count(c)", async_count(tree, c.begin(), c.end(), queue, options), value));
+    tasks.push_back(first_occurrences(tree, "acgtacgt", queue));
+    tasks.push_back(stop_after(50, stop, queue));
+    for (auto & t : tasks) {
+        queue.spawn(t);
+    }
+    queue.run();
+
+    // The same, synchronously
+    std::size_t n = 0;
+    std::string g = "gattaca";
+    for (auto const & e : occurrences(tree, g.begin(), g.end())) {
+        n += e.offset >= 0;
+    }
+    std::cout << "occurrences(gattaca): " << n << " == " << tree.count(g.begin(), g.end()) << std::endl;
+}
@@ -0,0 +1,667 @@
+#ifndef _ENHANCED_SUFFIX_ARRAY_HPP_INCLUDED_
+#define _ENHANCED_SUFFIX_ARRAY_HPP_INCLUDED_
+
+#include <vector>
+#include <deque>
+#include <set>
+#include <iterator>
+#include <utility>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#include "suffixtree.h"
+
+// EnhancedSuffixArray - Read-only index with the query API of SuffixTree
+//
+// This is the enhanced suffix array of Abouelhoda, Kurtz and Ohlebusch
+// ("Replacing suffix trees with enhanced suffix arrays", 2004): the suffix
+// array of the concatenated strings, its LCP array and the child table that
+// encodes the tree topology on top of them. Top-down queries walk the lcp
+// intervals as they would walk the nodes of the suffix tree, in O(m + occ)
+// for a fixed alphabet.
+//
+// Memory: the text, 4 bytes per character for the suffix array, 4 for the
+// child table and 1 for the LCP array (values >= 255 are kept apart). That is
+// about 10 bytes per character for `char`, against a few hundred for
+// SuffixTree.
+//
+// The index is built either from a SuffixTree (its suffix array export) or
+// from strings added with `add_string` followed by `build`. Every string is
+// stored with the end token appended, and equal suffixes of different strings
+// are ordered by string id, like in `SuffixTree::export_suffix_array`.
+template <typename CharType = char, CharType end_token = '$'>
+class EnhancedSuffixArray {
+public:
+    typedef SuffixTree<CharType, end_token> tree_type;
+    typedef typename tree_type::string string;
+    typedef typename tree_type::index_type index_type;
+    typedef typename tree_type::SuffixEntry SuffixEntry;
+    typedef typename tree_type::SubstringEntry SubstringEntry;
+    typedef typename tree_type::Repeat Repeat;
+    // Positions in the concatenated text
+    typedef std::uint32_t pos_type;
+
+private:
+    string text;
+    // Start of each string in `text`, plus the end of the text
+    std::vector<pos_type> starts;
+    // Id of each string
+    std::vector<int> ids;
+    std::vector<pos_type> sa;
+    // lcp[i] = LCP(sa[i-1], sa[i]), end tokens excluded. Values of 255 and
+    // more are stored as (i, lcp[i]) pairs sorted by i.
+    std::vector<std::uint8_t> lcp_small;
+    std::vector<std::pair<pos_type, pos_type>> lcp_large;
+    // Child table, the three relations sharing a single array:
+    //   - up[i] is stored in child[i-1]
+    //   - next[i] is stored in child[i]
+    //   - down[i] is stored in child[i] when next[i] is undefined
+    // 0 stands for undefined.
+    std::vector<pos_type> child;
+    // Orders strings (their index in `starts`) by their reversed content, end
+    // token excluded: the strings ending with a given one follow it
+    struct ReversedLess {
+        EnhancedSuffixArray const *owner;
+        explicit ReversedLess(EnhancedSuffixArray const *o) : owner(o) {}
+        bool operator()(std::size_t a, std::size_t b) const {
+            return std::lexicographical_compare(owner->reversed_begin(a), owner->reversed_end(a),
+                                                owner->reversed_begin(b), owner->reversed_end(b));
+        }
+    };
+
+    // Number of strings the suffix array covers (those of the last build)
+    std::size_t sorted_strings;
+    // The strings added since the last build, to reject the strings ending
+    // one of them (see add_string); the strings sorted before are checked on
+    // the suffix array. Refers to the text rather than copying it.
+    std::set<std::size_t, ReversedLess> pending;
+    int last_index;
+    bool built;
+
+    void check_built() const {
+        if (!built) {
+            throw std::logic_error("EnhancedSuffixArray: build() was not called");
+        }
+    }
+
+    void append_text(const CharType *s, std::size_t len, int id) {
+        if (text.size() + len >= std::numeric_limits<pos_type>::max()) {
+            throw std::length_error("EnhancedSuffixArray: text too large");
+        }
+        if (starts.empty()) {
+            starts.push_back(0);
+        }
+        text.insert(text.end(), s, s + len);
+        starts.push_back(text.size());
+        ids.push_back(id);
+        built = false;
+    }
+
+    // make_pattern - The pattern [str_begin, str_end), which must not hold the
+    // end token (as for SuffixTree queries)
+    template <typename InputIterator>
+    static string make_pattern(InputIterator const & str_begin, InputIterator const & str_end) {
+        string p(str_begin, str_end);
+        if (std::find(p.begin(), p.end(), end_token) != p.end()) {
+            throw std::invalid_argument("Input range contains the end token");
+        }
+        return p;
+    }
+
+    typedef typename string::const_reverse_iterator reverse_iterator;
+
+    // String @d reversed, end token excluded
+    reverse_iterator reversed_begin(std::size_t d) const {
+        return text.rbegin() + (text.size() - starts[d + 1] + 1);
+    }
+
+    reverse_iterator reversed_end(std::size_t d) const {
+        return text.rbegin() + (text.size() - starts[d]);
+    }
+
+    // Length of string @d, end token excluded
+    pos_type string_length(std::size_t d) const {
+        return starts[d + 1] - starts[d] - 1;
+    }
+
+    // ends_string - Whether the last string of the text, end token excluded,
+    // ends an earlier one. Records it in `pending` if not.
+    bool ends_string() {
+        std::size_t d = ids.size() - 1;
+        pos_type lb, rb;
+        // The end token sorts first (see is_suffix)
+        if (0 < sorted_strings && search(string(text.begin() + starts[d], text.end() - 1), &lb, &rb) &&
+                text[sa[lb] + string_length(d)] == end_token) {
+            return true;
+        }
+        if (pending.key_comp().owner != this) {
+            // Moved or copied from another index
+            std::set<std::size_t, ReversedLess> fresh((ReversedLess(this)));
+            for (std::size_t e = sorted_strings; e < d; ++e) {
+                fresh.insert(e);
+            }
+            pending.swap(fresh);
+        }
+        auto inserted = pending.insert(d);
+        if (!inserted.second) {
+            return true;
+        }
+        // The strings ending with this one follow it directly
+        auto next = std::next(inserted.first);
+        if (pending.end() != next && string_length(*next) >= string_length(d) &&
+                std::equal(reversed_begin(d), reversed_end(d), reversed_begin(*next))) {
+            pending.erase(inserted.first);
+            return true;
+        }
+        return false;
+    }
+
+    std::size_t string_index(pos_type p) const {
+        return std::upper_bound(starts.begin(), starts.end(), p) - starts.begin() - 1;
+    }
+
+    SuffixEntry entry(pos_type p) const {
+        std::size_t d = string_index(p);
+        return SuffixEntry(ids[d], p - starts[d]);
+    }
+
+    pos_type lcp(pos_type i) const {
+        if (lcp_small[i] < 255) {
+            return lcp_small[i];
+        }
+        auto it = std::lower_bound(lcp_large.begin(), lcp_large.end(), std::make_pair(i, pos_type(0)));
+        return it->second;
+    }
+
+    // First l-index of the lcp-interval [i..j] (i < j): the index splitting
+    // its first child from the second one.
+    pos_type first_l_index(pos_type i, pos_type j) const {
+        pos_type up = child[j];
+        if (i < up && up <= j) {
+            return up;
+        }
+        return child[i];
+    }
+
+    // child_interval - Child of the lcp-interval [i..j] labeled with c
+    // @l[in]: lcp value of [i..j]
+    // @c[in]: First character of the child edge
+    // @ci[out], @cj[out]: The child interval
+    bool child_interval(pos_type i, pos_type j, pos_type l, CharType c, pos_type *ci, pos_type *cj) const {
+        pos_type lo = i;
+        pos_type hi = first_l_index(i, j);
+        while (true) {
+            if (text[sa[lo] + l] == c) {
+                *ci = lo;
+                *cj = hi - 1;
+                return true;
+            }
+            lo = hi;
+            pos_type next = child[hi];
+            if (next <= hi || next > j || lcp(next) != l) {
+                break;
+            }
+            hi = next;
+        }
+        if (text[sa[lo] + l] == c) {
+            *ci = lo;
+            *cj = j;
+            return true;
+        }
+        return false;
+    }
+
+    // locate - Suffix array interval of the suffixes starting with p
+    bool locate(string const & p, pos_type *lb, pos_type *rb) const {
+        check_built();
+        return search(p, lb, rb);
+    }
+
+    // search - locate, on the suffix array of the last build
+    bool search(string const & p, pos_type *lb, pos_type *rb) const {
+        if (sa.empty()) {
+            return false;
+        }
+        pos_type i = 0;
+        pos_type j = sa.size() - 1;
+        index_type k = 0;
+        index_type m = p.size();
+        while (k < m) {
+            if (i == j) {
+                // A single suffix left: compare up to its end token, which
+                // the pattern does not hold
+                for (; k < m; ++k) {
+                    if (static_cast<std::size_t>(sa[i] + k) >= text.size() || text[sa[i] + k] != p[k]) {
+                        return false;
+                    }
+                }
+                break;
+            }
+            index_type l = lcp(first_l_index(i, j));
+            if (l > k) {
+                index_type e = std::min(l, m);
+                for (; k < e; ++k) {
+                    if (text[sa[i] + k] != p[k]) {
+                        return false;
+                    }
+                }
+                continue;
+            }
+            if (!child_interval(i, j, l, p[k], &i, &j)) {
+                return false;
+            }
+        }
+        *lb = i;
+        *rb = j;
+        return true;
+    }
+
+    // sort_suffixes - Prefix doubling with radix sorts, O(n log n)
+    // Every end token gets its own rank (the rank of its string), below the
+    // other characters, so that suffixes never compare past their end.
+    void sort_suffixes() {
+        std::size_t n = text.size();
+        std::vector<pos_type> rank(n);
+        std::vector<pos_type> tmp(n);
+        string alphabet;
+        for (CharType c : text) {
+            if (c != end_token) {
+                alphabet.push_back(c);
+            }
+        }
+        std::sort(alphabet.begin(), alphabet.end());
+        alphabet.erase(std::unique(alphabet.begin(), alphabet.end()), alphabet.end());
+        for (std::size_t d = 0; d < ids.size(); ++d) {
+            for (pos_type p = starts[d]; p < starts[d + 1]; ++p) {
+                if (text[p] == end_token) {
+                    rank[p] = d;
+                } else {
+                    rank[p] = ids.size() + (std::lower_bound(alphabet.begin(), alphabet.end(), text[p]) - alphabet.begin());
+                }
+            }
+        }
+        std::size_t n_ranks = ids.size() + alphabet.size();
+        std::vector<pos_type> counts;
+        sa.resize(n);
+        // Initial order: counting sort on the first character
+        counts.assign(n_ranks + 1, 0);
+        for (std::size_t p = 0; p < n; ++p) {
+            ++counts[rank[p] + 1];
+        }
+        for (std::size_t r = 1; r <= n_ranks; ++r) {
+            counts[r] += counts[r - 1];
+        }
+        for (std::size_t p = 0; p < n; ++p) {
+            sa[counts[rank[p]]++] = p;
+        }
+        std::vector<pos_type> by_second(n);
+        for (std::size_t k = 1; ; k <<= 1) {
+            // Order by the second half: suffixes without one come first
+            std::size_t w = 0;
+            for (std::size_t p = n - std::min(k, n); p < n; ++p) {
+                by_second[w++] = p;
+            }
+            for (std::size_t x = 0; x < n; ++x) {
+                if (sa[x] >= k) {
+                    by_second[w++] = sa[x] - k;
+                }
+            }
+            // Stable counting sort on the first half
+            counts.assign(n_ranks + 1, 0);
+            for (std::size_t p = 0; p < n; ++p) {
+                ++counts[rank[p] + 1];
+            }
+            for (std::size_t r = 1; r <= n_ranks; ++r) {
+                counts[r] += counts[r - 1];
+            }
+            for (std::size_t x = 0; x < n; ++x) {
+                pos_type p = by_second[x];
+                sa[counts[rank[p]]++] = p;
+            }
+            tmp[sa[0]] = 0;
+            for (std::size_t x = 1; x < n; ++x) {
+                pos_type a = sa[x - 1];
+                pos_type b = sa[x];
+                bool same = rank[a] == rank[b] &&
+                    ((a + k < n) ? (b + k < n && rank[a + k] == rank[b + k]) : (b + k >= n));
+                tmp[b] = tmp[a] + (same ? 0 : 1);
+            }
+            rank.swap(tmp);
+            n_ranks = rank[sa[n - 1]] + 1;
+            if (n_ranks == n) {
+                break;
+            }
+        }
+    }
+
+    // lcp_kasai - LCP array in linear time (Kasai et al.)
+    std::vector<pos_type> lcp_kasai() const {
+        std::size_t n = sa.size();
+        std::vector<pos_type> inverse(n);
+        std::vector<pos_type> result(n, 0);
+        for (std::size_t x = 0; x < n; ++x) {
+            inverse[sa[x]] = x;
+        }
+        pos_type h = 0;
+        for (pos_type p = 0; p < n; ++p) {
+            if (0 == inverse[p]) {
+                h = 0;
+                continue;
+            }
+            pos_type q = sa[inverse[p] - 1];
+            while (text[p + h] == text[q + h] && text[p + h] != end_token) {
+                ++h;
+            }
+            result[inverse[p]] = h;
+            if (h > 0) {
+                --h;
+            }
+        }
+        return result;
+    }
+
+    // finish - Compress the LCP array and build the child table
+    void finish(std::vector<pos_type> const & full_lcp) {
+        std::size_t n = sa.size();
+        lcp_small.assign(n, 0);
+        lcp_large.clear();
+        for (std::size_t i = 1; i < n; ++i) {
+            if (full_lcp[i] < 255) {
+                lcp_small[i] = full_lcp[i];
+            } else {
+                lcp_small[i] = 255;
+                lcp_large.push_back(std::make_pair(pos_type(i), full_lcp[i]));
+            }
+        }
+        // lcp[0] and lcp[n] act as -1 sentinels
+        auto L = [&](std::size_t i) -> std::int64_t {
+            return (0 == i || n == i) ? -1 : static_cast<std::int64_t>(full_lcp[i]);
+        };
+        child.assign(n, 0);
+        std::vector<pos_type> stack {0};
+        pos_type last = 0;
+        bool has_last = false;
+        for (std::size_t i = 1; i <= n; ++i) {
+            while (L(i) < L(stack.back())) {
+                last = stack.back();
+                has_last = true;
+                stack.pop_back();
+                if (L(i) <= L(stack.back()) && L(stack.back()) != L(last)) {
+                    // down[top] = last
+                    child[stack.back()] = last;
+                }
+            }
+            if (has_last) {
+                // up[i] = last
+                child[i - 1] = last;
+                has_last = false;
+            }
+            stack.push_back(i);
+        }
+        stack.assign(1, 0);
+        for (std::size_t i = 1; i < n; ++i) {
+            while (L(i) < L(stack.back())) {
+                stack.pop_back();
+            }
+            if (L(i) == L(stack.back())) {
+                // next[top] = i
+                child[stack.back()] = i;
+                stack.pop_back();
+            }
+            stack.push_back(i);
+        }
+        sorted_strings = ids.size();
+        pending.clear();
+        built = true;
+    }
+
+public:
+    EnhancedSuffixArray() : sorted_strings(0), pending(ReversedLess(this)), last_index(0), built(true) {
+    }
+
+    // Builds the index of the strings of a tree, with the same string ids.
+    // @parallel[in]: Export the tree's suffix array in parallel
+    explicit EnhancedSuffixArray(tree_type const & tree, bool parallel = false) :
+      sorted_strings(0), pending(ReversedLess(this)), last_index(0), built(false) {
+        if (tree.is_sparse() || tree.is_truncated()) {
+            throw std::invalid_argument("EnhancedSuffixArray: the tree is sparse or truncated");
+        }
+        for (int id : tree.string_ids()) {
+            string const & s = tree.get_string(id);
+            append_text(s.data(), s.size(), id);
+            last_index = id;
+        }
+        std::vector<SuffixEntry> suffixes = tree.export_suffix_array(parallel);
+        std::vector<index_type> tree_lcp = tree.export_lcp(parallel);
+        sa.resize(suffixes.size());
+        std::vector<pos_type> full_lcp(tree_lcp.begin(), tree_lcp.end());
+        for (std::size_t x = 0; x < suffixes.size(); ++x) {
+            std::size_t d = std::lower_bound(ids.begin(), ids.end(), suffixes[x].ref_str) - ids.begin();
+            sa[x] = starts[d] + suffixes[x].offset;
+        }
+        finish(full_lcp);
+    }
+
+    // add_string - Append a string to the collection
+    // The index must be (re)built with `build` before the next query.
+    // Returns the id of the string, or -1 when it is a suffix of a string of
+    // the collection (duplicates included), which SuffixTree::add_string
+    // rejects too: the ids stay those of a tree fed the same strings.
+    template <typename InputIterator>
+    int add_string(InputIterator const & str_begin, InputIterator const & str_end) {
+        string s = make_pattern(str_begin, str_end);
+        s.push_back(end_token);
+        bool was_built = built;
+        append_text(s.data(), s.size(), last_index + 1);
+        if (ends_string()) {
+            text.resize(starts[starts.size() - 2]);
+            starts.pop_back();
+            ids.pop_back();
+            built = was_built;
+            return -1;
+        }
+        return ++last_index;
+    }
+
+    // build - Sort the suffixes and build the LCP array and the child table
+    void build() {
+        if (text.empty()) {
+            sa.clear();
+            child.clear();
+            lcp_small.clear();
+            lcp_large.clear();
+            sorted_strings = 0;
+            built = true;
+            return;
+        }
+        sort_suffixes();
+        finish(lcp_kasai());
+    }
+
+    template <typename InputIterator>
+    bool is_substring(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p = make_pattern(str_begin, str_end);
+        pos_type lb, rb;
+        return p.empty() || locate(p, &lb, &rb);
+    }
+
+    template <typename InputIterator>
+    bool is_suffix(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p = make_pattern(str_begin, str_end);
+        pos_type lb, rb;
+        // The end token sorts first: if p ends a string, that is the
+        // first suffix of the interval
+        return locate(p, &lb, &rb) && text[sa[lb] + p.size()] == end_token;
+    }
+
+    template <typename InputIterator>
+    std::size_t count(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p = make_pattern(str_begin, str_end);
+        pos_type lb, rb;
+        return locate(p, &lb, &rb) ? rb - lb + 1 : 0;
+    }
+
+    // find_all - Occurrences of a string, in lexicographic order of the
+    // suffixes starting with them (same order as SuffixTree::find_all)
+    template <typename InputIterator>
+    std::vector<SuffixEntry> find_all(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p = make_pattern(str_begin, str_end);
+        std::vector<SuffixEntry> result;
+        pos_type lb, rb;
+        if (locate(p, &lb, &rb)) {
+            result.reserve(rb - lb + 1);
+            for (pos_type x = lb; x <= rb; ++x) {
+                result.push_back(entry(sa[x]));
+            }
+        }
+        return result;
+    }
+
+    // longest_common_substring - Longest substring shared by several strings
+    // @min_strings[in]: How many strings must contain it (0: all of them)
+    //
+    // Sliding window over the suffix array: for each window holding suffixes
+    // of enough strings, the minimum LCP inside it (kept in a monotonic
+    // queue) is a candidate. Same result as SuffixTree's.
+    SubstringEntry longest_common_substring(std::size_t min_strings = 0) const {
+        check_built();
+        if (0 == min_strings) {
+            min_strings = ids.size();
+        }
+        min_strings = std::max<std::size_t>(min_strings, 1);
+        SubstringEntry best;
+        if (sa.empty() || min_strings > ids.size()) {
+            return best;
+        }
+        std::vector<pos_type> seen(ids.size(), 0);
+        std::size_t distinct = 0;
+        std::deque<pos_type> window_min;
+        pos_type best_lb = 0;
+        index_type best_len = 0;
+        std::size_t a = 0;
+        for (std::size_t b = 0; b < sa.size(); ++b) {
+            if (0 == seen[string_index(sa[b])]++) {
+                ++distinct;
+            }
+            if (b > a) {
+                while (!window_min.empty() && lcp(window_min.back()) >= lcp(b)) {
+                    window_min.pop_back();
+                }
+                window_min.push_back(b);
+            }
+            for (; distinct >= min_strings; ++a) {
+                index_type value;
+                if (a == b) {
+                    std::size_t d = string_index(sa[a]);
+                    value = starts[d + 1] - sa[a] - 1;
+                } else {
+                    value = lcp(window_min.front());
+                }
+                if (value > best_len) {
+                    best_len = value;
+                    best_lb = a;
+                }
+                if (0 == --seen[string_index(sa[a])]) {
+                    --distinct;
+                }
+                while (!window_min.empty() && window_min.front() <= a + 1) {
+                    window_min.pop_front();
+                }
+            }
+        }
+        if (0 == best_len) {
+            return best;
+        }
+        while (best_lb > 0 && lcp(best_lb) >= best_len) {
+            --best_lb;
+        }
+        return SubstringEntry(entry(sa[best_lb]), best_len);
+    }
+
+    // repeats - Right-maximal repeats, i.e. the lcp-intervals
+    // Same output and order as SuffixTree::repeats.
+    std::vector<Repeat> repeats(index_type min_length = 1) const {
+        check_built();
+        min_length = std::max<index_type>(min_length, 1);
+        std::vector<Repeat> result;
+        std::vector<std::pair<pos_type, pos_type>> stack {std::make_pair(pos_type(0), pos_type(0))};
+        std::vector<pos_type> result_lb;
+        std::size_t n = sa.size();
+        for (std::size_t i = 1; i <= n; ++i) {
+            pos_type l = (i < n) ? lcp(i) : 0;
+            pos_type lb = i - 1;
+            while (l < stack.back().first) {
+                lb = stack.back().second;
+                if (stack.back().first >= min_length) {
+                    result.push_back(Repeat{entry(sa[lb]), stack.back().first, i - lb});
+                    result_lb.push_back(lb);
+                }
+                stack.pop_back();
+            }
+            if (l > stack.back().first) {
+                stack.push_back(std::make_pair(l, lb));
+            }
+        }
+        // Bottom-up enumeration gives post-order, sort by (first suffix, length)
+        std::vector<std::size_t> order(result.size());
+        for (std::size_t x = 0; x < order.size(); ++x) {
+            order[x] = x;
+        }
+        std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return result_lb[a] < result_lb[b] ||
+                (result_lb[a] == result_lb[b] && result[a].length < result[b].length);
+        });
+        std::vector<Repeat> sorted;
+        sorted.reserve(result.size());
+        for (std::size_t x : order) {
+            sorted.push_back(result[x]);
+        }
+        return sorted;
+    }
+
+    std::vector<int> string_ids() const {
+        return ids;
+    }
+
+    // The concatenated strings, end tokens included
+    string const & get_text() const {
+        return text;
+    }
+
+    // Start of each string in the text, plus the end of the text
+    std::vector<pos_type> const & get_starts() const {
+        return starts;
+    }
+
+    std::vector<pos_type> const & get_suffix_array() const {
+        check_built();
+        return sa;
+    }
+
+    // LCP of the suffixes of rows i - 1 and i, end tokens excluded (0 for i = 0)
+    pos_type get_lcp(pos_type i) const {
+        check_built();
+        return lcp(i);
+    }
+
+    // Number of suffixes, i.e. of characters (end tokens included)
+    std::size_t size() const {
+        return sa.size();
+    }
+
+    // Bytes used by the index
+    std::size_t size_in_bytes() const {
+        return sizeof(*this) +
+            text.capacity() * sizeof(CharType) +
+            starts.capacity() * sizeof(pos_type) +
+            ids.capacity() * sizeof(int) +
+            sa.capacity() * sizeof(pos_type) +
+            lcp_small.capacity() +
+            lcp_large.capacity() * sizeof(std::pair<pos_type, pos_type>) +
+            child.capacity() * sizeof(pos_type);
+    }
+};
+
+#endif // _ENHANCED_SUFFIX_ARRAY_HPP_INCLUDED_
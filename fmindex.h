@@ -0,0 +1,362 @@
+#ifndef _FM_INDEX_HPP_INCLUDED_
+#define _FM_INDEX_HPP_INCLUDED_
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstdint>
+
+#include "suffixtree.h"
+#include "enhancedsuffixarray.h"
+#include "succinct.h"
+
+// FMIndex - Compressed full-text index of a string collection
+//
+// The Burrows-Wheeler transform of the concatenated strings is kept in a
+// Huffman-shaped wavelet tree, about n(H0 + 1) bits. `count` runs the
+// backward search (two ranks per pattern character). `locate` walks each
+// occurrence back with the LF mapping until a sampled suffix array entry.
+//
+// A text position is sampled when it is a multiple of the sampling rate or
+// the start of a string. Rows whose BWT character is an end token are thus
+// always sampled, and the LF mapping never has to go through an end token
+// (the end tokens of the different strings are equal characters but sort by
+// string id). Locating an occurrence costs at most `sample_rate` LF steps,
+// and the samples take 32 bits per `sample_rate` characters.
+//
+// String ids come from a bitvector marking the string starts in the text
+// (n bits): the string of a position is a rank, its start a select.
+//
+// The text itself is not kept, but any part of it can be extracted: the
+// inverse suffix array is sampled at the same rate (the rows of the end
+// tokens need no sample: the end token of the d-th string is row d), and the
+// LF mapping walks back from the next sample, reading the first column.
+//
+// The index is built from a suffix array, either a raw one or the export of a
+// SuffixTree or of an EnhancedSuffixArray; the text is only needed during
+// construction.
+template <typename CharType = char, CharType end_token = '$'>
+class FMIndex {
+public:
+    typedef SuffixTree<CharType, end_token> tree_type;
+    typedef EnhancedSuffixArray<CharType, end_token> esa_type;
+    typedef typename tree_type::string string;
+    typedef typename tree_type::index_type index_type;
+    typedef typename tree_type::SuffixEntry SuffixEntry;
+    typedef std::uint32_t pos_type;
+
+private:
+    // Symbols other than the end token, sorted. The end token is symbol 0,
+    // alphabet[c] is symbol c + 1.
+    string alphabet;
+    // C[c]: number of BWT characters smaller than symbol c
+    std::vector<pos_type> C;
+    HuffmanWaveletTree bwt;
+    // Rows whose suffix array entry is sampled, and the entries in row order
+    BitVector sampled;
+    std::vector<pos_type> samples;
+    // isa_samples[k]: row of the suffix at text position k * sample_rate
+    std::vector<pos_type> isa_samples;
+    // Ones at the string starts in the text
+    BitVector string_starts;
+    std::vector<int> ids;
+    pos_type sample_rate;
+
+    static const std::uint32_t no_symbol = std::numeric_limits<std::uint32_t>::max();
+
+    // First column: the symbol starting the suffix of a row
+    std::uint32_t first_symbol(pos_type row) const {
+        return std::upper_bound(C.begin(), C.end(), row) - C.begin() - 1;
+    }
+
+    std::uint32_t symbol(CharType c) const {
+        if (c == end_token) {
+            return 0;
+        }
+        auto it = std::lower_bound(alphabet.begin(), alphabet.end(), c);
+        if (alphabet.end() == it || *it != c) {
+            return no_symbol;
+        }
+        return 1 + (it - alphabet.begin());
+    }
+
+    // LF mapping: row of the suffix starting one position before
+    pos_type lf(pos_type row) const {
+        std::size_t r;
+        std::uint32_t c = bwt.inverse_select(row, &r);
+        return C[c] + r;
+    }
+
+    // walk_to - Row of text position p, whose string ends at e: from the next
+    // sampled position, or from the end token, LF steps back to p without
+    // crossing a string boundary
+    pos_type walk_to(pos_type p, pos_type e) const {
+        std::size_t next = (std::size_t(p) + sample_rate - 1) / sample_rate * sample_rate;
+        pos_type row;
+        pos_type q;
+        if (next >= e) {
+            q = e;
+            // The end token of the d-th string is row d
+            row = string_starts.rank1(e + 1) - 1;
+        } else {
+            q = next;
+            row = isa_samples[q / sample_rate];
+        }
+        for (; q > p; --q) {
+            row = lf(row);
+        }
+        return row;
+    }
+
+    // build - Build the index from a text and its suffix array
+    // @text[in]: The concatenated strings, each ending with the end token
+    // @starts[in]: Start of each string, plus the end of the text
+    // @string_ids[in]: Id of each string
+    // @sa[in]: Generalized suffix array of @text
+    void build(string const & text, std::vector<pos_type> const & starts,
+               std::vector<int> const & string_ids, std::vector<pos_type> const & sa) {
+        std::size_t n = text.size();
+        if (0 == sample_rate) {
+            throw std::invalid_argument("FMIndex: the sampling rate must be positive");
+        }
+        ids = string_ids;
+        alphabet.clear();
+        for (CharType c : text) {
+            if (c != end_token) {
+                alphabet.push_back(c);
+            }
+        }
+        std::sort(alphabet.begin(), alphabet.end());
+        alphabet.erase(std::unique(alphabet.begin(), alphabet.end()), alphabet.end());
+        alphabet.shrink_to_fit();
+        std::uint32_t sigma = alphabet.size() + 1;
+
+        std::vector<bool> is_start(n + 1, false);
+        for (pos_type s : starts) {
+            is_start[s] = true;
+        }
+        for (std::size_t p = 0; p < n; ++p) {
+            string_starts.push_back(is_start[p]);
+        }
+        string_starts.build();
+
+        std::vector<std::uint32_t> last_column(n);
+        isa_samples.assign((n + sample_rate - 1) / sample_rate, 0);
+        C.assign(sigma + 1, 0);
+        for (std::size_t row = 0; row < n; ++row) {
+            pos_type p = sa[row];
+            std::uint32_t c = symbol(text[(0 == p) ? n - 1 : p - 1]);
+            last_column[row] = c;
+            ++C[c + 1];
+            if (0 == p % sample_rate) {
+                isa_samples[p / sample_rate] = row;
+            }
+            bool sample = (0 == p % sample_rate) || is_start[p];
+            sampled.push_back(sample);
+            if (sample) {
+                samples.push_back(p);
+            }
+        }
+        sampled.build();
+        samples.shrink_to_fit();
+        for (std::uint32_t c = 1; c <= sigma; ++c) {
+            C[c] += C[c - 1];
+        }
+        bwt = HuffmanWaveletTree(last_column, sigma);
+    }
+
+public:
+    // Builds the index of the strings of a tree, with the same string ids.
+    // @rate[in]: Suffix array sampling rate
+    // @parallel[in]: Export the tree's suffix array in parallel
+    explicit FMIndex(tree_type const & tree, pos_type rate = 32, bool parallel = false) : sample_rate(rate) {
+        if (tree.is_sparse() || tree.is_truncated()) {
+            throw std::invalid_argument("FMIndex: the tree is sparse or truncated");
+        }
+        string text;
+        std::vector<pos_type> starts {0};
+        std::vector<int> string_ids = tree.string_ids();
+        for (int id : string_ids) {
+            string const & s = tree.get_string(id);
+            if (text.size() + s.size() >= std::numeric_limits<pos_type>::max()) {
+                throw std::length_error("FMIndex: text too large");
+            }
+            text.insert(text.end(), s.begin(), s.end());
+            starts.push_back(text.size());
+        }
+        std::vector<SuffixEntry> suffixes = tree.export_suffix_array(parallel);
+        std::vector<pos_type> sa(suffixes.size());
+        for (std::size_t x = 0; x < suffixes.size(); ++x) {
+            std::size_t d = std::lower_bound(string_ids.begin(), string_ids.end(), suffixes[x].ref_str) - string_ids.begin();
+            sa[x] = starts[d] + suffixes[x].offset;
+        }
+        build(text, starts, string_ids, sa);
+    }
+
+    // Builds the index from an enhanced suffix array (which must be built).
+    explicit FMIndex(esa_type const & esa, pos_type rate = 32) : sample_rate(rate) {
+        build(esa.get_text(), esa.get_starts(), esa.string_ids(), esa.get_suffix_array());
+    }
+
+    // Builds the index from a suffix array.
+    // @text[in]: The concatenated strings, each ending with the end token
+    // @starts[in]: Start of each string, plus the end of the text
+    // @string_ids[in]: Id of each string, increasing
+    // @sa[in]: Generalized suffix array of @text, equal suffixes ordered by
+    //          string id
+    FMIndex(string const & text, std::vector<pos_type> const & starts, std::vector<int> const & string_ids,
+            std::vector<pos_type> const & sa, pos_type rate = 32) : sample_rate(rate) {
+        build(text, starts, string_ids, sa);
+    }
+
+    // make_pattern - The pattern [str_begin, str_end), which must not hold the
+    // end token (as for SuffixTree queries)
+    template <typename InputIterator>
+    static string make_pattern(InputIterator const & str_begin, InputIterator const & str_end) {
+        string p(str_begin, str_end);
+        if (std::find(p.begin(), p.end(), end_token) != p.end()) {
+            throw std::invalid_argument("Input range contains the end token");
+        }
+        return p;
+    }
+
+    // backward_search - Rows [sp, ep) of the suffixes starting with p
+    bool backward_search(string const & p, pos_type *sp, pos_type *ep) const {
+        pos_type lo = 0;
+        pos_type hi = bwt.size();
+        for (auto it = p.rbegin(); it != p.rend() && lo < hi; ++it) {
+            std::uint32_t c = symbol(*it);
+            if (no_symbol == c || 0 == c) {
+                return false;
+            }
+            lo = C[c] + bwt.rank(c, lo);
+            hi = C[c] + bwt.rank(c, hi);
+        }
+        *sp = lo;
+        *ep = hi;
+        return lo < hi;
+    }
+
+    // suffix_array - Text position of the suffix of a row
+    pos_type suffix_array(pos_type row) const {
+        pos_type steps = 0;
+        while (!sampled[row]) {
+            row = lf(row);
+            ++steps;
+        }
+        return samples[sampled.rank1(row)] + steps;
+    }
+
+    // String id and offset of a text position
+    SuffixEntry entry(pos_type p) const {
+        std::size_t d = string_starts.rank1(p + 1) - 1;
+        return SuffixEntry(ids[d], p - string_starts.select1(d));
+    }
+
+    // inverse_suffix_array - Row of the suffix starting at a text position
+    pos_type inverse_suffix_array(pos_type p) const {
+        return walk_to(p, string_end(p));
+    }
+
+    // psi - Row of the suffix following the one of a row, i.e. the inverse
+    // of the LF mapping. Undefined on the rows of the end tokens (the first
+    // string_ids().size() rows).
+    pos_type psi(pos_type row) const {
+        std::uint32_t c = first_symbol(row);
+        return bwt.select(c, row - C[c]);
+    }
+
+    // First character of the suffix of a row
+    CharType first_char(pos_type row) const {
+        std::uint32_t c = first_symbol(row);
+        return (0 == c) ? end_token : alphabet[c - 1];
+    }
+
+    // Position of the end token closing the string of a text position
+    pos_type string_end(pos_type p) const {
+        std::size_t d = string_starts.rank1(p + 1);
+        return (d < ids.size()) ? string_starts.select1(d) - 1 : bwt.size() - 1;
+    }
+
+    CharType char_at(pos_type p) const {
+        return first_char(inverse_suffix_array(p));
+    }
+
+    // extract - The characters [p, p + len) of the text, stopping at the end
+    // token of the string of p
+    string extract(pos_type p, pos_type len) const {
+        if (0 == len) {
+            return string();
+        }
+        pos_type last = std::min<std::size_t>(std::size_t(p) + len - 1, string_end(p));
+        string result(last - p + 1, end_token);
+        pos_type row = walk_to(last, string_end(p));
+        for (pos_type x = last;; --x) {
+            result[x - p] = first_char(row);
+            if (x == p) {
+                break;
+            }
+            row = lf(row);
+        }
+        return result;
+    }
+
+    template <typename InputIterator>
+    bool is_substring(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p = make_pattern(str_begin, str_end);
+        pos_type sp, ep;
+        return p.empty() || backward_search(p, &sp, &ep);
+    }
+
+    template <typename InputIterator>
+    std::size_t count(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p = make_pattern(str_begin, str_end);
+        pos_type sp, ep;
+        return backward_search(p, &sp, &ep) ? ep - sp : 0;
+    }
+
+    // find_all - Occurrences of a string, in lexicographic order of the
+    // suffixes starting with them (same order as SuffixTree::find_all)
+    template <typename InputIterator>
+    std::vector<SuffixEntry> find_all(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p = make_pattern(str_begin, str_end);
+        std::vector<SuffixEntry> result;
+        pos_type sp, ep;
+        if (backward_search(p, &sp, &ep)) {
+            result.reserve(ep - sp);
+            for (pos_type row = sp; row < ep; ++row) {
+                result.push_back(entry(suffix_array(row)));
+            }
+        }
+        return result;
+    }
+
+    std::vector<int> string_ids() const {
+        return ids;
+    }
+
+    // Number of characters (end tokens included)
+    std::size_t size() const {
+        return bwt.size();
+    }
+
+    pos_type sampling_rate() const {
+        return sample_rate;
+    }
+
+    // Bytes used by the index
+    std::size_t size_in_bytes() const {
+        return sizeof(*this) +
+            alphabet.capacity() * sizeof(CharType) +
+            C.capacity() * sizeof(pos_type) +
+            bwt.size_in_bytes() - sizeof(bwt) +
+            sampled.size_in_bytes() - sizeof(sampled) +
+            samples.capacity() * sizeof(pos_type) +
+            isa_samples.capacity() * sizeof(pos_type) +
+            string_starts.size_in_bytes() - sizeof(string_starts) +
+            ids.capacity() * sizeof(int);
+    }
+};
+
+#endif // _FM_INDEX_HPP_INCLUDED_
@@ -0,0 +1,443 @@
+#ifndef _LAZY_SUFFIX_TREE_HPP_INCLUDED_
+#define _LAZY_SUFFIX_TREE_HPP_INCLUDED_
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <limits>
+#include <type_traits>
+
+#include "suffixtree.h"
+
+// LazySuffixTree - Suffix tree of a string collection built on demand
+//
+// A write-only top-down (wotd) tree: a node covers the range of the suffixes
+// starting with its path label in an array of text positions, and its
+// children are only created when a query first descends into it. Expanding
+// a node groups its suffixes by the character following the path (a stable
+// sort of the range), then extends each group while its suffixes agree. The
+// range of a child is a part of its parent's, so the tree needs no memory
+// beyond the positions until it is queried.
+//
+// Adding the strings is O(n); a query expands the nodes on its path, at a
+// cost linear in their number of suffixes the first time, and only follows
+// them afterwards. count never needs the nodes below the locus, find_all
+// expands the subtree of the locus (which lists its occurrences).
+//
+// Queries are const and may run concurrently: a node is expanded under a
+// lock (one of a few mutexes, picked by the node's address) and published
+// with an atomic flag, so threads racing on a node expand it once. Adding
+// strings discards the expanded nodes, the root is created again by the
+// next query; adding must not overlap the queries.
+//
+// As in SuffixTree, every string ends with the same end token, equal
+// suffixes of different strings share a leaf, a string ending an earlier one
+// is rejected, and the empty pattern occurs at every suffix.
+template <typename CharType = char, CharType end_token = '$'>
+class LazySuffixTree {
+public:
+    typedef SuffixTree<CharType, end_token> tree_type;
+    typedef typename tree_type::string string;
+    typedef typename tree_type::index_type index_type;
+    typedef typename tree_type::SuffixEntry SuffixEntry;
+
+private:
+    struct Node {
+        // The suffixes of the node: positions[lb, rb)
+        index_type lb;
+        index_type rb;
+        // Text position of the first character of the incoming edge, and
+        // string depth at its end
+        index_type edge_pos;
+        index_type depth;
+        bool leaf;
+        std::atomic<bool> expanded;
+        // Sorted by first character, end token first
+        std::vector<std::unique_ptr<Node>> children;
+        Node(index_type l, index_type r, index_type pos, index_type d, bool is_leaf) :
+          lb(l),
+          rb(r),
+          edge_pos(pos),
+          depth(d),
+          leaf(is_leaf),
+          expanded(false)
+          {}
+    };
+
+    static const std::size_t lock_count = 64;
+
+    // Orders strings (their index in `starts`) by their reversed content, end
+    // token excluded: the strings ending with a given one follow it
+    struct ReversedLess {
+        LazySuffixTree const *owner;
+        explicit ReversedLess(LazySuffixTree const *o) : owner(o) {}
+        bool operator()(std::size_t a, std::size_t b) const {
+            return std::lexicographical_compare(owner->reversed_begin(a), owner->reversed_end(a),
+                                                owner->reversed_begin(b), owner->reversed_end(b));
+        }
+    };
+
+    // The strings, each followed by the end token
+    string text;
+    // Offsets of the strings in the text, and the text size last
+    std::vector<index_type> starts;
+    // Text positions, permuted in place by the expansions
+    mutable std::vector<index_type> positions;
+    // Null after an add_string, until the next query
+    mutable std::unique_ptr<Node> root;
+    mutable std::atomic<bool> stale;
+    mutable std::mutex root_lock;
+    mutable std::array<std::mutex, lock_count> locks;
+    mutable std::atomic<std::size_t> expansions;
+    mutable std::atomic<std::size_t> nodes;
+    // The strings, to reject those ending one of them (see add_string)
+    std::set<std::size_t, ReversedLess> reversed;
+    int last_index;
+
+    // End tokens sort first
+    static bool symbol_less(CharType a, CharType b) {
+        return a != b && (a == end_token || (b != end_token && a < b));
+    }
+
+    // Index of the string holding a text position
+    std::size_t string_of(index_type pos) const {
+        return std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin() - 1;
+    }
+
+    // Position of the end token closing the string of a text position
+    index_type string_end(index_type pos) const {
+        return starts[string_of(pos) + 1] - 1;
+    }
+
+    typedef typename string::const_reverse_iterator reverse_iterator;
+
+    // String @d reversed, end token excluded
+    reverse_iterator reversed_begin(std::size_t d) const {
+        return text.rbegin() + (text.size() - starts[d + 1] + 1);
+    }
+
+    reverse_iterator reversed_end(std::size_t d) const {
+        return text.rbegin() + (text.size() - starts[d]);
+    }
+
+    // ends_string - Whether the last string of the text, end token excluded,
+    // ends an earlier one. Records it in `reversed` if not.
+    bool ends_string() {
+        std::size_t d = starts.size() - 2;
+        auto inserted = reversed.insert(d);
+        if (!inserted.second) {
+            return true;
+        }
+        // The strings ending with this one follow it directly
+        auto next = std::next(inserted.first);
+        if (reversed.end() != next &&
+                starts[*next + 1] - starts[*next] >= starts[d + 1] - starts[d] &&
+                std::equal(reversed_begin(d), reversed_end(d), reversed_begin(*next))) {
+            reversed.erase(inserted.first);
+            return true;
+        }
+        return false;
+    }
+
+    SuffixEntry entry(index_type pos) const {
+        std::size_t s = string_of(pos);
+        return SuffixEntry(s + 1, pos - starts[s]);
+    }
+
+    Node *make_node(index_type lb, index_type rb, index_type edge_pos, index_type depth, bool leaf) const {
+        ++nodes;
+        return new Node(lb, rb, edge_pos, depth, leaf);
+    }
+
+    // discard - Free the expanded nodes, without recursion
+    static void discard(std::unique_ptr<Node> n) {
+        std::vector<std::unique_ptr<Node>> stack;
+        stack.push_back(std::move(n));
+        while (!stack.empty()) {
+            std::unique_ptr<Node> current = std::move(stack.back());
+            stack.pop_back();
+            if (current) {
+                for (auto & c : current->children) {
+                    stack.push_back(std::move(c));
+                }
+            }
+        }
+    }
+
+    // top - The root, created over all the positions after an add_string
+    //
+    // The positions keep the order the expansions left them in: the
+    // suffixes of the new root are regrouped from there, and the equal
+    // suffixes of a leaf stay in text order since the sorts are stable and
+    // new positions come last.
+    Node *top() const {
+        if (stale.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(root_lock);
+            if (stale.load(std::memory_order_relaxed)) {
+                root.reset(make_node(0, text.size(), 0, 0, false));
+                stale.store(false, std::memory_order_release);
+            }
+        }
+        return root.get();
+    }
+
+    // group_by_symbol - Stable sort of suffixes by their character at depth d
+    // A counting sort for byte characters, a comparison sort otherwise.
+    template <typename Iterator>
+    void group_by_symbol(Iterator first, Iterator last, index_type d, std::true_type) const {
+        typedef typename std::make_unsigned<CharType>::type byte_type;
+        std::array<index_type, 256> next {};
+        for (Iterator it = first; it != last; ++it) {
+            ++next[byte_type(text[*it + d])];
+        }
+        // Bucket offsets in symbol order: the end token, then by value
+        index_type offset = next[byte_type(end_token)];
+        next[byte_type(end_token)] = 0;
+        for (int v = std::numeric_limits<CharType>::min(); v <= std::numeric_limits<CharType>::max(); ++v) {
+            byte_type b = byte_type(CharType(v));
+            if (CharType(v) != end_token) {
+                index_type count = next[b];
+                next[b] = offset;
+                offset += count;
+            }
+        }
+        std::vector<index_type> sorted(last - first);
+        for (Iterator it = first; it != last; ++it) {
+            sorted[next[byte_type(text[*it + d])]++] = *it;
+        }
+        std::copy(sorted.begin(), sorted.end(), first);
+    }
+
+    template <typename Iterator>
+    void group_by_symbol(Iterator first, Iterator last, index_type d, std::false_type) const {
+        std::stable_sort(first, last, [this, d](index_type a, index_type b) {
+            return symbol_less(text[a + d], text[b + d]);
+        });
+    }
+
+    // expand - Create the children of a node
+    //
+    // The suffixes are grouped by the character at the node's depth, keeping
+    // their text order within a group (so that a leaf lists its suffixes by
+    // string id). A group of one suffix, or of suffixes reaching the end
+    // token together, is a leaf; the others extend their edge while all
+    // their suffixes agree.
+    void expand(Node *n) const {
+        index_type d = n->depth;
+        auto first = positions.begin() + n->lb;
+        auto last = positions.begin() + n->rb;
+        group_by_symbol(first, last, d, std::integral_constant<bool, 1 == sizeof(CharType)>());
+        for (index_type lb = n->lb; lb < n->rb; ) {
+            CharType c = text[positions[lb] + d];
+            index_type rb = lb + 1;
+            while (rb < n->rb && text[positions[rb] + d] == c) {
+                ++rb;
+            }
+            index_type pos = positions[lb];
+            // Extend the edge while the suffixes agree: agreeing on the end
+            // token means they are equal
+            bool leaf = (rb - lb == 1 || end_token == c);
+            index_type depth = d + 1;
+            while (!leaf) {
+                CharType next = text[pos + depth];
+                bool agree = true;
+                for (index_type i = lb + 1; i < rb && agree; ++i) {
+                    agree = (text[positions[i] + depth] == next);
+                }
+                if (!agree) {
+                    break;
+                }
+                leaf = (end_token == next);
+                ++depth;
+            }
+            if (leaf) {
+                depth = string_end(pos) - pos + 1;
+            }
+            Node *child = make_node(lb, rb, pos + d, depth, leaf);
+            n->children.push_back(std::unique_ptr<Node>(child));
+            lb = rb;
+        }
+        ++expansions;
+    }
+
+    void ensure_expanded(Node *n) const {
+        if (n->leaf || n->expanded.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(locks[std::hash<Node*>()(n) % lock_count]);
+        if (!n->expanded.load(std::memory_order_relaxed)) {
+            expand(n);
+            n->expanded.store(true, std::memory_order_release);
+        }
+    }
+
+    Node *child(Node *n, CharType c) const {
+        auto it = std::lower_bound(n->children.begin(), n->children.end(), c,
+            [this](std::unique_ptr<Node> const & child, CharType ch) {
+                return symbol_less(text[child->edge_pos], ch);
+            });
+        return (n->children.end() != it && text[(*it)->edge_pos] == c) ? it->get() : nullptr;
+    }
+
+    // locus - The highest node whose path label starts with a pattern,
+    // expanding the nodes on the way; null if the pattern does not occur
+    Node *locus(string const & p) const {
+        Node *n = top();
+        index_type matched = 0;
+        index_type m = p.size();
+        while (matched < m) {
+            ensure_expanded(n);
+            Node *c = n->leaf ? nullptr : child(n, p[matched]);
+            if (!c) {
+                return nullptr;
+            }
+            index_type length = std::min(c->depth - n->depth, m - matched);
+            if (!std::equal(p.begin() + matched, p.begin() + matched + length, text.begin() + c->edge_pos)) {
+                return nullptr;
+            }
+            matched += length;
+            n = c;
+        }
+        return n;
+    }
+
+    // Appends the suffixes below a node in lexicographic order
+    void collect(Node *n, std::vector<SuffixEntry> *result) const {
+        std::vector<Node*> stack {n};
+        while (!stack.empty()) {
+            Node *current = stack.back();
+            stack.pop_back();
+            ensure_expanded(current);
+            if (current->leaf) {
+                for (index_type i = current->lb; i < current->rb; ++i) {
+                    result->push_back(entry(positions[i]));
+                }
+                continue;
+            }
+            // Last child first on the stack, so the first is visited first
+            for (auto it = current->children.rbegin(); it != current->children.rend(); ++it) {
+                stack.push_back(it->get());
+            }
+        }
+    }
+
+    template <typename InputIterator>
+    static string make_pattern(InputIterator const & str_begin, InputIterator const & str_end) {
+        string s(str_begin, str_end);
+        if (std::find(s.begin(), s.end(), end_token) != s.end()) {
+            throw std::invalid_argument("Input range contains the end token");
+        }
+        return s;
+    }
+
+public:
+    LazySuffixTree() :
+      starts {0},
+      stale(true),
+      expansions(0),
+      nodes(0),
+      reversed(ReversedLess(this)),
+      last_index(0)
+      {}
+
+    LazySuffixTree(LazySuffixTree const &) = delete;
+    LazySuffixTree& operator=(LazySuffixTree const &) = delete;
+
+    ~LazySuffixTree() {
+        discard(std::move(root));
+    }
+
+    // add_string - Add a string to the haystack, in O(length log n)
+    // Returns the id of the string (1, 2, ...), or -1 when it is a suffix of
+    // a string of the haystack (duplicates included), as SuffixTree does.
+    // The nodes expanded by previous queries are discarded (in time linear
+    // in their number).
+    template <typename InputIterator>
+    int add_string(InputIterator const & str_begin, InputIterator const & str_end) {
+        string s = make_pattern(str_begin, str_end);
+        index_type first = text.size();
+        text.insert(text.end(), s.begin(), s.end());
+        text.push_back(end_token);
+        starts.push_back(text.size());
+        if (ends_string()) {
+            text.resize(first);
+            starts.pop_back();
+            return -1;
+        }
+        for (index_type i = first; i < static_cast<index_type>(text.size()); ++i) {
+            positions.push_back(i);
+        }
+        discard(std::move(root));
+        nodes = 0;
+        expansions = 0;
+        stale.store(true, std::memory_order_release);
+        return ++last_index;
+    }
+
+    template <typename InputIterator>
+    bool is_substring(InputIterator const & str_begin, InputIterator const & str_end) const {
+        return nullptr != locus(make_pattern(str_begin, str_end));
+    }
+
+    // count - Number of occurrences of a string in the haystack
+    // The empty string occurs at every suffix, end tokens included.
+    template <typename InputIterator>
+    std::size_t count(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string p = make_pattern(str_begin, str_end);
+        Node *n = locus(p);
+        return n ? n->rb - n->lb : 0;
+    }
+
+    // find_all - Occurrences of a string in the haystack
+    // The occurrences are returned in the lexicographic order of the suffixes
+    // starting with them.
+    template <typename InputIterator>
+    std::vector<SuffixEntry> find_all(InputIterator const & str_begin, InputIterator const & str_end) const {
+        std::vector<SuffixEntry> result;
+        string p = make_pattern(str_begin, str_end);
+        Node *n = locus(p);
+        if (n) {
+            collect(n, &result);
+        }
+        return result;
+    }
+
+    // expand_all - Materialize the whole tree
+    void expand_all() const {
+        std::vector<Node*> stack {top()};
+        while (!stack.empty()) {
+            Node *n = stack.back();
+            stack.pop_back();
+            ensure_expanded(n);
+            for (auto const & c : n->children) {
+                stack.push_back(c.get());
+            }
+        }
+    }
+
+    std::vector<int> string_ids() const {
+        std::vector<int> result(last_index);
+        for (int i = 0; i < last_index; ++i) {
+            result[i] = i + 1;
+        }
+        return result;
+    }
+
+    // Number of nodes created so far, leaves included
+    std::size_t node_count() const {
+        return nodes;
+    }
+
+    // Number of nodes whose children were created
+    std::size_t expanded_count() const {
+        return expansions;
+    }
+};
+
+#endif // _LAZY_SUFFIX_TREE_HPP_INCLUDED_
@@ -0,0 +1,320 @@
+#ifndef _MEMORY_RESOURCE_HPP_INCLUDED_
+#define _MEMORY_RESOURCE_HPP_INCLUDED_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define SUFFIXTREE_HAS_PMR 1
+#endif
+#endif
+
+// MemoryResource - Where a SuffixTree takes its memory from
+//
+// The interface of C++17 std::pmr::memory_resource, which this C++11 library
+// cannot require: allocate and deallocate forward to the private virtual
+// do_allocate and do_deallocate. PmrResource adapts a std::pmr resource when
+// compiled as C++17. Alignments up to alignof(std::max_align_t) are
+// supported by the resources below.
+class MemoryResource {
+public:
+    virtual ~MemoryResource() {}
+
+    void *allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+        return do_allocate(bytes, alignment);
+    }
+
+    void deallocate(void *p, std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+        do_deallocate(p, bytes, alignment);
+    }
+
+    // is_equal - Whether memory allocated by one can be deallocated by the
+    // other
+    bool is_equal(MemoryResource const & other) const noexcept {
+        return do_is_equal(other);
+    }
+
+private:
+    virtual void *do_allocate(std::size_t bytes, std::size_t alignment) = 0;
+    virtual void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) = 0;
+    virtual bool do_is_equal(MemoryResource const & other) const noexcept = 0;
+};
+
+// NewDeleteResource - ::operator new and ::operator delete
+class NewDeleteResource : public MemoryResource {
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (alignment > alignof(std::max_align_t)) {
+            throw std::bad_alloc();
+        }
+        return ::operator new(bytes);
+    }
+
+    void do_deallocate(void *p, std::size_t, std::size_t) override {
+        ::operator delete(p);
+    }
+
+    bool do_is_equal(MemoryResource const & other) const noexcept override {
+        return this == &other;
+    }
+};
+
+inline MemoryResource *new_delete_resource() {
+    static NewDeleteResource resource;
+    return &resource;
+}
+
+inline std::atomic<MemoryResource*>& default_resource_slot() {
+    static std::atomic<MemoryResource*> slot(new_delete_resource());
+    return slot;
+}
+
+// default_resource - The resource of the trees constructed without one, and
+// of the temporary buffers of the queries
+inline MemoryResource *default_resource() {
+    return default_resource_slot().load(std::memory_order_acquire);
+}
+
+// set_default_resource - Replace the default resource (nullptr: back to
+// new_delete_resource()), returning the previous one
+inline MemoryResource *set_default_resource(MemoryResource *r) {
+    return default_resource_slot().exchange(r ? r : new_delete_resource(), std::memory_order_acq_rel);
+}
+
+// MonotonicResource - Bump allocator for build-and-discard trees
+//
+// Memory is carved out of chunks obtained from the upstream resource, each
+// twice as large as the previous one; deallocate does nothing, and
+// everything is returned at once by release() or the destructor. A tree
+// using it is destroyed without visiting its nodes (see SuffixTree).
+// Not thread-safe.
+class MonotonicResource : public MemoryResource {
+public:
+    explicit MonotonicResource(std::size_t initial_size = 1 << 16,
+                               MemoryResource *upstream = new_delete_resource()) :
+      upstream(upstream),
+      chunks(nullptr),
+      current(nullptr),
+      remaining(0),
+      next_size(std::max<std::size_t>(initial_size, 2 * sizeof(Chunk))),
+      obtained(0)
+      {}
+
+    MonotonicResource(MonotonicResource const &) = delete;
+    MonotonicResource& operator=(MonotonicResource const &) = delete;
+
+    ~MonotonicResource() {
+        release();
+    }
+
+    // release - Return every chunk to the upstream resource
+    void release() {
+        while (chunks) {
+            Chunk *c = chunks;
+            chunks = c->next;
+            upstream->deallocate(c, c->size, alignof(std::max_align_t));
+        }
+        current = nullptr;
+        remaining = 0;
+        obtained = 0;
+    }
+
+    // Bytes obtained from the upstream resource
+    std::size_t upstream_bytes() const {
+        return obtained;
+    }
+
+private:
+    struct alignas(std::max_align_t) Chunk {
+        Chunk *next;
+        std::size_t size;
+    };
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (alignment > alignof(std::max_align_t)) {
+            throw std::bad_alloc();
+        }
+        std::size_t pad = (alignment - reinterpret_cast<std::uintptr_t>(current) % alignment) % alignment;
+        if (!current || pad + bytes > remaining) {
+            std::size_t size = std::max(next_size, bytes + sizeof(Chunk));
+            Chunk *c = static_cast<Chunk*>(upstream->allocate(size, alignof(std::max_align_t)));
+            c->next = chunks;
+            c->size = size;
+            chunks = c;
+            obtained += size;
+            current = reinterpret_cast<char*>(c + 1);
+            remaining = size - sizeof(Chunk);
+            pad = 0;
+            if (next_size < std::numeric_limits<std::size_t>::max() / 2) {
+                next_size *= 2;
+            }
+        }
+        void *p = current + pad;
+        current += pad + bytes;
+        remaining -= pad + bytes;
+        return p;
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(MemoryResource const & other) const noexcept override {
+        return this == &other;
+    }
+
+    MemoryResource *upstream;
+    Chunk *chunks;
+    char *current;
+    std::size_t remaining;
+    std::size_t next_size;
+    std::size_t obtained;
+};
+
+// CountingResource - Forward to an upstream resource, counting the bytes in
+// use, their peak and the allocations (thread-safe if the upstream is)
+class CountingResource : public MemoryResource {
+public:
+    explicit CountingResource(MemoryResource *upstream = new_delete_resource()) :
+      upstream(upstream),
+      in_use(0),
+      peak(0),
+      count(0)
+      {}
+
+    std::size_t bytes_in_use() const {
+        return in_use.load(std::memory_order_relaxed);
+    }
+
+    std::size_t peak_bytes() const {
+        return peak.load(std::memory_order_relaxed);
+    }
+
+    std::size_t allocations() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void *p = upstream->allocate(bytes, alignment);
+        std::size_t now = in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        std::size_t high = peak.load(std::memory_order_relaxed);
+        while (now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {
+        }
+        count.fetch_add(1, std::memory_order_relaxed);
+        return p;
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+        upstream->deallocate(p, bytes, alignment);
+        in_use.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    bool do_is_equal(MemoryResource const & other) const noexcept override {
+        return this == &other;
+    }
+
+    MemoryResource *upstream;
+    std::atomic<std::size_t> in_use;
+    std::atomic<std::size_t> peak;
+    std::atomic<std::size_t> count;
+};
+
+#ifdef SUFFIXTREE_HAS_PMR
+// PmrResource - A std::pmr::memory_resource seen as a MemoryResource (C++17)
+class PmrResource : public MemoryResource {
+public:
+    explicit PmrResource(std::pmr::memory_resource *r) : resource(r) {}
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        return resource->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+        resource->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(MemoryResource const & other) const noexcept override {
+        PmrResource const *o = dynamic_cast<PmrResource const *>(&other);
+        return this == &other || (o && resource->is_equal(*o->resource));
+    }
+
+    std::pmr::memory_resource *resource;
+};
+#endif
+
+// ResourceAllocator - Standard allocator drawing from a MemoryResource
+//
+// As std::pmr::polymorphic_allocator: default-constructed, it uses
+// default_resource(); the resource does not propagate to copies of a
+// container (they use default_resource()), and moves keep it.
+template <typename T>
+class ResourceAllocator {
+public:
+    typedef T value_type;
+
+    ResourceAllocator() noexcept : resource_(default_resource()) {}
+
+    ResourceAllocator(MemoryResource *r) noexcept : resource_(r) {}
+
+    template <typename U>
+    ResourceAllocator(ResourceAllocator<U> const & other) noexcept : resource_(other.resource()) {}
+
+    T *allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) {
+        resource_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceAllocator select_on_container_copy_construction() const {
+        return ResourceAllocator();
+    }
+
+    MemoryResource *resource() const noexcept {
+        return resource_;
+    }
+
+private:
+    MemoryResource *resource_;
+};
+
+template <typename T, typename U>
+bool operator==(ResourceAllocator<T> const & a, ResourceAllocator<U> const & b) noexcept {
+    return a.resource() == b.resource() || a.resource()->is_equal(*b.resource());
+}
+
+template <typename T, typename U>
+bool operator!=(ResourceAllocator<T> const & a, ResourceAllocator<U> const & b) noexcept {
+    return !(a == b);
+}
+
+// releases_in_bulk - Whether the memory given out by @alloc is only returned
+// all at once (a monotonic resource), so that a SuffixTree need not free its
+// nodes one by one
+template <typename Alloc>
+bool releases_in_bulk(Alloc const &) {
+    return false;
+}
+
+template <typename T>
+bool releases_in_bulk(ResourceAllocator<T> const & alloc) {
+    return nullptr != dynamic_cast<MonotonicResource*>(alloc.resource());
+}
+
+#ifdef SUFFIXTREE_HAS_PMR
+template <typename T>
+bool releases_in_bulk(std::pmr::polymorphic_allocator<T> const & alloc) {
+    return nullptr != dynamic_cast<std::pmr::monotonic_buffer_resource*>(alloc.resource());
+}
+#endif
+
+#endif // _MEMORY_RESOURCE_HPP_INCLUDED_
@@ -0,0 +1,336 @@
+#ifndef _SUFFIX_TREE_METRICS_HPP_INCLUDED_
+#define _SUFFIX_TREE_METRICS_HPP_INCLUDED_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <thread>
+
+// LatencyHistogram - Distribution of durations in nanoseconds
+//
+// HDR-style buckets: every power of two range [2^e, 2^(e+1)) is cut into
+// `sub_buckets` equal parts, so a recorded value is known within 1/16 of
+// itself over the whole range (1 ns to 2^40 ns, about 18 minutes; longer
+// durations go to the last bucket). Recording is a relaxed atomic increment
+// in one of `shards` copies picked by the calling thread: threads do not
+// lock, and rarely share a cache line. The shards are summed when reading.
+class LatencyHistogram {
+public:
+    static const int sub_bucket_bits = 4;
+    static const int sub_buckets = 1 << sub_bucket_bits;
+    static const int max_exponent = 40;
+    // Values below sub_buckets are exact, then sub_buckets per exponent
+    static const int bucket_count = (max_exponent - sub_bucket_bits + 2) * sub_buckets;
+    static const int shards = 8;
+
+private:
+    struct Shard {
+        std::array<std::atomic<std::uint64_t>, bucket_count> counts;
+        std::atomic<std::uint64_t> total;
+        std::atomic<std::uint64_t> sum;
+        Shard() : total(0), sum(0) {
+            for (auto & c : counts) {
+                c.store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    std::array<Shard, shards> shard;
+
+    static int bucket_of(std::uint64_t ns) {
+        if (ns < sub_buckets) {
+            return static_cast<int>(ns);
+        }
+        int e = 63 - count_leading_zeros(ns);
+        if (e > max_exponent) {
+            return bucket_count - 1;
+        }
+        // The sub_bucket_bits bits following the leading one
+        int sub = static_cast<int>((ns >> (e - sub_bucket_bits)) & (sub_buckets - 1));
+        return (e - sub_bucket_bits + 1) * sub_buckets + sub;
+    }
+
+    // Lowest value of a bucket
+    static std::uint64_t bucket_floor(int b) {
+        if (b < sub_buckets) {
+            return b;
+        }
+        int e = b / sub_buckets + sub_bucket_bits - 1;
+        return (std::uint64_t(1) << e) + (std::uint64_t(b % sub_buckets) << (e - sub_bucket_bits));
+    }
+
+    static int count_leading_zeros(std::uint64_t x) {
+#if defined(__GNUC__)
+        return __builtin_clzll(x);
+#else
+        int n = 0;
+        for (std::uint64_t bit = std::uint64_t(1) << 63; !(x & bit); bit >>= 1) {
+            ++n;
+        }
+        return n;
+#endif
+    }
+
+    Shard & local_shard() {
+        static thread_local std::size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % shards;
+        return shard[slot];
+    }
+
+public:
+    void record(std::uint64_t ns) {
+        Shard & s = local_shard();
+        s.counts[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+        s.total.fetch_add(1, std::memory_order_relaxed);
+        s.sum.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count() const {
+        std::uint64_t n = 0;
+        for (auto const & s : shard) {
+            n += s.total.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    // Sum of the recorded values, in nanoseconds
+    std::uint64_t sum() const {
+        std::uint64_t n = 0;
+        for (auto const & s : shard) {
+            n += s.sum.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    // percentile - Value below which a fraction @q of the records fall,
+    // rounded down to its bucket (0 if nothing was recorded)
+    std::uint64_t percentile(double q) const {
+        std::array<std::uint64_t, bucket_count> merged {};
+        std::uint64_t n = 0;
+        for (auto const & s : shard) {
+            for (int b = 0; b < bucket_count; ++b) {
+                std::uint64_t c = s.counts[b].load(std::memory_order_relaxed);
+                merged[b] += c;
+                n += c;
+            }
+        }
+        if (0 == n) {
+            return 0;
+        }
+        std::uint64_t rank = static_cast<std::uint64_t>(q * n);
+        if (rank >= n) {
+            rank = n - 1;
+        }
+        std::uint64_t seen = 0;
+        for (int b = 0; b < bucket_count; ++b) {
+            seen += merged[b];
+            if (seen > rank) {
+                return bucket_floor(b);
+            }
+        }
+        return bucket_floor(bucket_count - 1);
+    }
+
+    void reset() {
+        for (auto & s : shard) {
+            for (auto & c : s.counts) {
+                c.store(0, std::memory_order_relaxed);
+            }
+            s.total.store(0, std::memory_order_relaxed);
+            s.sum.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+// The timed operations of a tree
+enum class Operation {
+    add_string,
+    is_substring,
+    count,
+    find_all
+};
+
+// QueryMetrics - One latency histogram per operation
+//
+// Attached to trees with `set_metrics` (several trees may share one); the
+// tree then times each operation. Without metrics, an operation only tests
+// a null pointer.
+class QueryMetrics {
+public:
+    static const int operation_count = 4;
+
+    LatencyHistogram & histogram(Operation op) {
+        return histograms[static_cast<int>(op)];
+    }
+
+    LatencyHistogram const & histogram(Operation op) const {
+        return histograms[static_cast<int>(op)];
+    }
+
+    static const char *name(Operation op) {
+        static const char *names[operation_count] = {"add_string", "is_substring", "count", "find_all"};
+        return names[static_cast<int>(op)];
+    }
+
+    void reset() {
+        for (auto & h : histograms) {
+            h.reset();
+        }
+    }
+
+private:
+    std::array<LatencyHistogram, operation_count> histograms;
+};
+
+// OperationTimer - Records the lifetime of the scope into a histogram of
+// the metrics, if any
+class OperationTimer {
+    QueryMetrics *metrics;
+    Operation op;
+    std::chrono::steady_clock::time_point start;
+public:
+    OperationTimer(QueryMetrics *m, Operation o) : metrics(m), op(o) {
+        if (metrics) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~OperationTimer() {
+        if (metrics) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            metrics->histogram(op).record(ns.count());
+        }
+    }
+};
+
+// The phases of an add_string
+enum class BuildPhase {
+    // Copy of the input and registration in the haystack
+    text_ingestion,
+    // Walk down the tree along the prefix the string shares with it
+    descent,
+    // Ukkonen's phases, or the top-down insertions of a sparse or truncated
+    // tree
+    insertion,
+    // Labelling of the suffixes left implicit
+    post_processing
+};
+
+// BuildTracer - Callbacks around the phases of add_string
+//
+// Attached with `set_tracer`. The calls come from the thread running
+// add_string, each `begin` being followed by the matching `end`.
+class BuildTracer {
+public:
+    virtual ~BuildTracer() {}
+    virtual void begin(BuildPhase phase, int string_id) = 0;
+    virtual void end(BuildPhase phase, int string_id) = 0;
+};
+
+// PhaseScope - Calls the tracer, if any, on entry and exit of a scope
+class PhaseScope {
+    BuildTracer *tracer;
+    BuildPhase phase;
+    int id;
+public:
+    PhaseScope(BuildTracer *t, BuildPhase p, int string_id) : tracer(t), phase(p), id(string_id) {
+        if (tracer) {
+            tracer->begin(phase, id);
+        }
+    }
+    ~PhaseScope() {
+        if (tracer) {
+            tracer->end(phase, id);
+        }
+    }
+};
+
+// PhaseTimes - Tracer summing the time spent in each phase
+//
+// Phases may be timed from several threads at once: the starts are kept
+// per thread, the totals are atomic.
+class PhaseTimes : public BuildTracer {
+public:
+    static const int phase_count = 4;
+
+    void begin(BuildPhase phase, int) override {
+        starts()[static_cast<int>(phase)] = std::chrono::steady_clock::now();
+    }
+
+    void end(BuildPhase phase, int) override {
+        int p = static_cast<int>(phase);
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - starts()[p]);
+        nanoseconds[p].fetch_add(ns.count(), std::memory_order_relaxed);
+        calls[p].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Total time spent in a phase, in nanoseconds
+    std::uint64_t total(BuildPhase phase) const {
+        return nanoseconds[static_cast<int>(phase)].load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t count(BuildPhase phase) const {
+        return calls[static_cast<int>(phase)].load(std::memory_order_relaxed);
+    }
+
+    static const char *name(BuildPhase phase) {
+        static const char *names[phase_count] = {"text_ingestion", "descent", "insertion", "post_processing"};
+        return names[static_cast<int>(phase)];
+    }
+
+    PhaseTimes() {
+        for (int p = 0; p < phase_count; ++p) {
+            nanoseconds[p].store(0, std::memory_order_relaxed);
+            calls[p].store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, phase_count> nanoseconds;
+    std::array<std::atomic<std::uint64_t>, phase_count> calls;
+
+    static std::array<std::chrono::steady_clock::time_point, phase_count> & starts() {
+        static thread_local std::array<std::chrono::steady_clock::time_point, phase_count> s;
+        return s;
+    }
+};
+
+// write_prometheus - The operation latencies in the Prometheus text format,
+// as summaries (p50, p99, p999, sum and count, in seconds)
+inline void write_prometheus(std::ostream & out, QueryMetrics const & metrics) {
+    out << "# HELP suffixtree_operation_latency_seconds Latency of the suffix tree operations\n"
+        << "# TYPE suffixtree_operation_latency_seconds summary\n";
+    for (int o = 0; o < QueryMetrics::operation_count; ++o) {
+        Operation op = static_cast<Operation>(o);
+        LatencyHistogram const & h = metrics.histogram(op);
+        char const *name = QueryMetrics::name(op);
+        for (double q : {0.5, 0.99, 0.999}) {
+            out << "suffixtree_operation_latency_seconds{operation=\"" << name << "\",quantile=\"" << q << "\"} "
+                << h.percentile(q) * 1e-9 << "\n";
+        }
+        out << "suffixtree_operation_latency_seconds_sum{operation=\"" << name << "\"} " << h.sum() * 1e-9 << "\n"
+            << "suffixtree_operation_latency_seconds_count{operation=\"" << name << "\"} " << h.count() << "\n";
+    }
+}
+
+// write_prometheus - The build phase totals in the Prometheus text format,
+// as counters
+inline void write_prometheus(std::ostream & out, PhaseTimes const & phases) {
+    out << "# HELP suffixtree_build_phase_seconds_total Time spent in each phase of add_string\n"
+        << "# TYPE suffixtree_build_phase_seconds_total counter\n";
+    for (int p = 0; p < PhaseTimes::phase_count; ++p) {
+        BuildPhase phase = static_cast<BuildPhase>(p);
+        out << "suffixtree_build_phase_seconds_total{phase=\"" << PhaseTimes::name(phase) << "\"} "
+            << phases.total(phase) * 1e-9 << "\n";
+    }
+    out << "# HELP suffixtree_build_phase_calls_total Number of times each phase of add_string ran\n"
+        << "# TYPE suffixtree_build_phase_calls_total counter\n";
+    for (int p = 0; p < PhaseTimes::phase_count; ++p) {
+        BuildPhase phase = static_cast<BuildPhase>(p);
+        out << "suffixtree_build_phase_calls_total{phase=\"" << PhaseTimes::name(phase) << "\"} "
+            << phases.count(phase) << "\n";
+    }
+}
+
+#endif // _SUFFIX_TREE_METRICS_HPP_INCLUDED_
@@ -0,0 +1,607 @@
+#ifndef _SUCCINCT_HPP_INCLUDED_
+#define _SUCCINCT_HPP_INCLUDED_
+
+#include <vector>
+#include <queue>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cstdint>
+
+// Succinct building blocks for the compressed indexes.
+
+// BitVector - Bit sequence with rank and select support
+//
+// rank1(i) counts the ones in [0, i) in constant time: the cumulative count
+// is stored every 512 bits (12.5% overhead) and the rest is a few popcounts.
+// select1/select0 binary search those counts, then scan at most 8 words.
+//
+// Bits are appended with `push_back`, then `build` must be called before any
+// rank or select.
+class BitVector {
+public:
+    BitVector() : n(0), ones(0) {}
+
+    void push_back(bool bit) {
+        if (0 == n % 64) {
+            words.push_back(0);
+        }
+        if (bit) {
+            words.back() |= std::uint64_t(1) << (n % 64);
+        }
+        ++n;
+    }
+
+    void build() {
+        words.shrink_to_fit();
+        blocks.assign(words.size() / 8 + 2, 0);
+        std::uint64_t total = 0;
+        for (std::size_t w = 0; w < words.size(); ++w) {
+            if (0 == w % 8) {
+                blocks[w / 8] = total;
+            }
+            total += popcount(words[w]);
+        }
+        blocks[(words.size() + 7) / 8] = total;
+        blocks.back() = total;
+        ones = total;
+    }
+
+    bool operator[](std::size_t i) const {
+        return (words[i / 64] >> (i % 64)) & 1;
+    }
+
+    // Bits [8k, 8k + 8), the first one in the least significant position
+    std::uint8_t byte(std::size_t k) const {
+        return static_cast<std::uint8_t>(words[k / 8] >> (8 * (k % 8)));
+    }
+
+    std::size_t size() const {
+        return n;
+    }
+
+    std::size_t count_ones() const {
+        return ones;
+    }
+
+    std::size_t rank1(std::size_t i) const {
+        std::size_t w = i / 64;
+        std::uint64_t r = blocks[w / 8];
+        for (std::size_t x = w & ~std::size_t(7); x < w; ++x) {
+            r += popcount(words[x]);
+        }
+        if (0 != i % 64) {
+            r += popcount(words[w] & ((std::uint64_t(1) << (i % 64)) - 1));
+        }
+        return r;
+    }
+
+    std::size_t rank0(std::size_t i) const {
+        return i - rank1(i);
+    }
+
+    // Position of the k-th one (0-based k)
+    std::size_t select1(std::size_t k) const {
+        return select(k, true);
+    }
+
+    // Position of the k-th zero (0-based k)
+    std::size_t select0(std::size_t k) const {
+        return select(k, false);
+    }
+
+    std::size_t size_in_bytes() const {
+        return sizeof(*this) + words.capacity() * 8 + blocks.capacity() * 8;
+    }
+
+    static unsigned popcount(std::uint64_t x) {
+        return __builtin_popcountll(x);
+    }
+
+private:
+    std::size_t select(std::size_t k, bool one) const {
+        // Last block starting with at most k matching bits
+        std::size_t lo = 0;
+        std::size_t hi = (words.size() + 7) / 8;
+        while (hi - lo > 1) {
+            std::size_t mid = (lo + hi) / 2;
+            std::uint64_t before = one ? blocks[mid] : mid * 512 - blocks[mid];
+            if (before <= k) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        k -= one ? blocks[lo] : lo * 512 - blocks[lo];
+        for (std::size_t w = lo * 8; w < words.size(); ++w) {
+            std::uint64_t x = one ? words[w] : ~words[w];
+            std::size_t c = popcount(x);
+            if (k < c) {
+                for (; 0 != k; --k) {
+                    x &= x - 1;
+                }
+                return w * 64 + __builtin_ctzll(x);
+            }
+            k -= c;
+        }
+        return n;
+    }
+
+    std::vector<std::uint64_t> words;
+    std::vector<std::uint64_t> blocks;
+    std::size_t n;
+    std::size_t ones;
+};
+
+// HuffmanWaveletTree - Sequence of integer symbols with rank/select/access
+//
+// The tree has the shape of the Huffman code of the symbol frequencies, so
+// the bitvectors hold about n(H0 + 1) bits: frequent symbols have short
+// codes. Each operation walks a root-to-leaf path, in O(code length).
+class HuffmanWaveletTree {
+public:
+    HuffmanWaveletTree() : n(0), root(-1) {}
+
+    // @seq[in]: The sequence, symbols in [0, sigma)
+    HuffmanWaveletTree(std::vector<std::uint32_t> const & seq, std::uint32_t sigma) : n(seq.size()), root(-1) {
+        std::vector<std::uint64_t> freq(sigma, 0);
+        for (std::uint32_t c : seq) {
+            ++freq[c];
+        }
+        leaf_of.assign(sigma, -1);
+        typedef std::pair<std::uint64_t, std::int32_t> Item;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+        for (std::uint32_t c = 0; c < sigma; ++c) {
+            if (0 != freq[c]) {
+                leaf_of[c] = nodes.size();
+                nodes.push_back(Node(c));
+                heap.push(Item(freq[c], leaf_of[c]));
+            }
+        }
+        if (heap.empty()) {
+            return;
+        }
+        while (heap.size() > 1) {
+            Item a = heap.top();
+            heap.pop();
+            Item b = heap.top();
+            heap.pop();
+            std::int32_t id = nodes.size();
+            nodes.push_back(Node(0));
+            nodes[id].child[0] = a.second;
+            nodes[id].child[1] = b.second;
+            nodes[a.second].parent = id;
+            nodes[b.second].parent = id;
+            heap.push(Item(a.first + b.first, id));
+        }
+        root = heap.top().second;
+        // Codes, root bit first
+        code.assign(sigma, 0);
+        code_len.assign(sigma, 0);
+        for (std::uint32_t c = 0; c < sigma; ++c) {
+            if (leaf_of[c] < 0) {
+                continue;
+            }
+            std::uint64_t bits = 0;
+            unsigned len = 0;
+            for (std::int32_t x = leaf_of[c]; x != root; x = nodes[x].parent) {
+                std::int32_t p = nodes[x].parent;
+                bits = (bits << 1) | ((nodes[p].child[1] == x) ? 1 : 0);
+                ++len;
+            }
+            code[c] = bits;
+            code_len[c] = len;
+        }
+        for (std::uint32_t c : seq) {
+            std::int32_t x = root;
+            for (unsigned d = 0; d < code_len[c]; ++d) {
+                bool bit = (code[c] >> d) & 1;
+                nodes[x].bits.push_back(bit);
+                x = nodes[x].child[bit];
+            }
+        }
+        for (auto& node : nodes) {
+            node.bits.build();
+        }
+    }
+
+    std::size_t size() const {
+        return n;
+    }
+
+    std::uint32_t access(std::size_t i) const {
+        std::int32_t x = root;
+        while (nodes[x].child[0] >= 0) {
+            BitVector const & b = nodes[x].bits;
+            if (b[i]) {
+                i = b.rank1(i);
+                x = nodes[x].child[1];
+            } else {
+                i = b.rank0(i);
+                x = nodes[x].child[0];
+            }
+        }
+        return nodes[x].symbol;
+    }
+
+    // Occurrences of c in [0, i)
+    std::size_t rank(std::uint32_t c, std::size_t i) const {
+        if (c >= leaf_of.size() || leaf_of[c] < 0) {
+            return 0;
+        }
+        std::int32_t x = root;
+        for (unsigned d = 0; d < code_len[c]; ++d) {
+            bool bit = (code[c] >> d) & 1;
+            i = bit ? nodes[x].bits.rank1(i) : nodes[x].bits.rank0(i);
+            x = nodes[x].child[bit];
+        }
+        return i;
+    }
+
+    // access and rank at once: the symbol at i and its occurrences in [0, i)
+    std::uint32_t inverse_select(std::size_t i, std::size_t *r) const {
+        std::int32_t x = root;
+        while (nodes[x].child[0] >= 0) {
+            BitVector const & b = nodes[x].bits;
+            if (b[i]) {
+                i = b.rank1(i);
+                x = nodes[x].child[1];
+            } else {
+                i = b.rank0(i);
+                x = nodes[x].child[0];
+            }
+        }
+        *r = i;
+        return nodes[x].symbol;
+    }
+
+    // Position of the k-th (0-based) occurrence of c
+    std::size_t select(std::uint32_t c, std::size_t k) const {
+        std::int32_t x = leaf_of[c];
+        while (x != root) {
+            std::int32_t p = nodes[x].parent;
+            k = (nodes[p].child[1] == x) ? nodes[p].bits.select1(k) : nodes[p].bits.select0(k);
+            x = p;
+        }
+        return k;
+    }
+
+    std::size_t size_in_bytes() const {
+        std::size_t total = sizeof(*this) + code.capacity() * 8 + code_len.capacity() + leaf_of.capacity() * 4;
+        for (auto const & node : nodes) {
+            total += node.bits.size_in_bytes() + sizeof(Node) - sizeof(BitVector);
+        }
+        return total;
+    }
+
+private:
+    struct Node {
+        BitVector bits;
+        std::int32_t child[2];
+        std::int32_t parent;
+        std::uint32_t symbol;
+        explicit Node(std::uint32_t s) : parent(-1), symbol(s) {
+            child[0] = child[1] = -1;
+        }
+    };
+
+    std::size_t n;
+    std::int32_t root;
+    std::vector<Node> nodes;
+    std::vector<std::int32_t> leaf_of;
+    std::vector<std::uint64_t> code;
+    std::vector<std::uint8_t> code_len;
+};
+
+// BalancedParentheses - Ordinal tree as a sequence of parentheses
+//
+// A node is an opening parenthesis written when the depth-first traversal
+// enters it, closed when it leaves; the node is identified by the position
+// of its '('. Navigation reduces to searches on the excess E(i), the number
+// of '(' minus the number of ')' in [0, i]:
+//   - find_close(i): first j > i with E(j) = E(i) - 1
+//   - enclose(i), the parent: one after the last j < i with E(j) = E(i) - 2
+//   - lca(u, v): parent of the position following the minimum of E on [u, v]
+//
+// The minimum excess of every 512-bit block is kept in a segment tree, so a
+// search scans the two partial blocks (a byte at a time, with lookup tables)
+// and descends the tree for the rest: O(log n) per operation, in 2n bits plus
+// the rank directory and 64 bits per 512 bits of sequence.
+class BalancedParentheses {
+public:
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+
+    BalancedParentheses() : leaves(1) {}
+
+    void push_back(bool open) {
+        bits.push_back(open);
+    }
+
+    void build() {
+        bits.build();
+        std::size_t blocks = (bits.size() + block_size - 1) / block_size;
+        leaves = 1;
+        while (leaves < blocks) {
+            leaves *= 2;
+        }
+        tree.assign(2 * leaves, std::numeric_limits<std::int64_t>::max());
+        std::int64_t e = 0;
+        for (std::size_t b = 0; b < blocks; ++b) {
+            std::int64_t m = std::numeric_limits<std::int64_t>::max();
+            for (std::size_t i = b * block_size; i < std::min(bits.size(), (b + 1) * block_size); ++i) {
+                e += bits[i] ? 1 : -1;
+                m = std::min(m, e);
+            }
+            tree[leaves + b] = m;
+        }
+        for (std::size_t x = leaves - 1; x > 0; --x) {
+            tree[x] = std::min(tree[2 * x], tree[2 * x + 1]);
+        }
+        tree.shrink_to_fit();
+    }
+
+    std::size_t size() const {
+        return bits.size();
+    }
+
+    bool is_open(std::size_t i) const {
+        return bits[i];
+    }
+
+    // Excess after position i
+    std::int64_t excess(std::size_t i) const {
+        return 2 * static_cast<std::int64_t>(bits.rank1(i + 1)) - static_cast<std::int64_t>(i + 1);
+    }
+
+    // Number of '(' in [0, i)
+    std::size_t rank_open(std::size_t i) const {
+        return bits.rank1(i);
+    }
+
+    // Position of the k-th (0-based) '('
+    std::size_t select_open(std::size_t k) const {
+        return bits.select1(k);
+    }
+
+    // find_close - The ')' matching the '(' at i
+    std::size_t find_close(std::size_t i) const {
+        return forward_search(i, excess(i) - 1);
+    }
+
+    // enclose - The '(' of the node enclosing the one at i, npos for the root
+    std::size_t enclose(std::size_t i) const {
+        std::int64_t e = excess(i);
+        if (e <= 1) {
+            return npos;
+        }
+        std::size_t j = backward_search(i, e - 2);
+        // npos stands for the position before the sequence
+        return (npos == j) ? 0 : j + 1;
+    }
+
+    // lca - Lowest common ancestor of the nodes at u and v
+    std::size_t lca(std::size_t u, std::size_t v) const {
+        if (u > v) {
+            std::swap(u, v);
+        }
+        if (v < find_close(u)) {
+            return u;
+        }
+        return enclose(range_min(u, v) + 1);
+    }
+
+    // range_min - Leftmost position of the minimum excess in [i, j]
+    std::size_t range_min(std::size_t i, std::size_t j) const {
+        std::int64_t e = excess(i);
+        std::int64_t best = e;
+        std::size_t best_pos = i;
+        std::size_t bi = i / block_size;
+        std::size_t bj = j / block_size;
+        std::size_t end = (bi == bj) ? j : (bi + 1) * block_size - 1;
+        scan_min(i + 1, end, &e, &best, &best_pos);
+        if (bi == bj) {
+            return best_pos;
+        }
+        if (bi + 1 < bj) {
+            std::int64_t m = range_tree_min(1, 0, leaves, bi + 1, bj);
+            if (m < best) {
+                std::size_t b = first_block_at_most(1, 0, leaves, bi + 1, bj, m);
+                std::size_t start = b * block_size;
+                e = (0 == start) ? 0 : excess(start - 1);
+                std::int64_t inner = std::numeric_limits<std::int64_t>::max();
+                std::size_t inner_pos = start;
+                scan_min(start, start + block_size - 1, &e, &inner, &inner_pos);
+                best = inner;
+                best_pos = inner_pos;
+            }
+        }
+        std::size_t start = bj * block_size;
+        e = excess(start - 1);
+        scan_min(start, j, &e, &best, &best_pos);
+        return best_pos;
+    }
+
+    std::size_t size_in_bytes() const {
+        return sizeof(*this) + bits.size_in_bytes() - sizeof(bits) + tree.capacity() * sizeof(std::int64_t);
+    }
+
+private:
+    static const std::size_t block_size = 512;
+
+    // Per byte value, bits read from the least significant one: the excess
+    // of the whole byte and the minimum excess of its non-empty prefixes
+    struct ByteTables {
+        std::int8_t total[256];
+        std::int8_t min_prefix[256];
+        ByteTables() {
+            for (int v = 0; v < 256; ++v) {
+                int e = 0;
+                int m = 8;
+                for (int b = 0; b < 8; ++b) {
+                    e += ((v >> b) & 1) ? 1 : -1;
+                    m = std::min(m, e);
+                }
+                total[v] = e;
+                min_prefix[v] = m;
+            }
+        }
+    };
+
+    static ByteTables const & tables() {
+        static const ByteTables t;
+        return t;
+    }
+
+    // Updates (*best, *best_pos) with the positions in [from, to] whose
+    // excess is smaller; *e is the excess before `from` and after `to`
+    void scan_min(std::size_t from, std::size_t to, std::int64_t *e, std::int64_t *best, std::size_t *best_pos) const {
+        ByteTables const & t = tables();
+        std::size_t i = from;
+        while (i <= to && i < bits.size()) {
+            if (0 == i % 8 && i + 7 <= to && i + 7 < bits.size()) {
+                std::uint8_t v = bits.byte(i / 8);
+                if (*e + t.min_prefix[v] >= *best) {
+                    *e += t.total[v];
+                    i += 8;
+                    continue;
+                }
+            }
+            *e += bits[i] ? 1 : -1;
+            if (*e < *best) {
+                *best = *e;
+                *best_pos = i;
+            }
+            ++i;
+        }
+    }
+
+    // First j > i with E(j) <= target, given target < E(i)
+    std::size_t forward_search(std::size_t i, std::int64_t target) const {
+        ByteTables const & t = tables();
+        std::int64_t e = excess(i);
+        std::size_t j = i + 1;
+        std::size_t block_end = (i / block_size + 1) * block_size;
+        while (j < block_end && j < bits.size()) {
+            if (0 == j % 8 && j + 7 < block_end && j + 7 < bits.size()) {
+                std::uint8_t v = bits.byte(j / 8);
+                if (e + t.min_prefix[v] > target) {
+                    e += t.total[v];
+                    j += 8;
+                    continue;
+                }
+            }
+            e += bits[j] ? 1 : -1;
+            if (e <= target) {
+                return j;
+            }
+            ++j;
+        }
+        std::size_t b = first_block_at_most(1, 0, leaves, i / block_size + 1, leaves, target);
+        if (npos == b) {
+            return npos;
+        }
+        std::size_t start = b * block_size;
+        return forward_search_from(start, excess(start - 1), target);
+    }
+
+    std::size_t forward_search_from(std::size_t j, std::int64_t e, std::int64_t target) const {
+        for (;; ++j) {
+            e += bits[j] ? 1 : -1;
+            if (e <= target) {
+                return j;
+            }
+        }
+    }
+
+    // Last j < i with E(j) <= target (E(-1) = 0, returned as npos)
+    std::size_t backward_search(std::size_t i, std::int64_t target) const {
+        ByteTables const & t = tables();
+        std::size_t block_start = (i / block_size) * block_size;
+        // e is the excess after position j - 1
+        std::int64_t e = excess(i) - (bits[i] ? 1 : -1);
+        std::size_t j = i;
+        while (j > block_start) {
+            if (0 == j % 8 && j - 8 >= block_start) {
+                std::uint8_t v = bits.byte(j / 8 - 1);
+                std::int64_t before = e - t.total[v];
+                if (before + t.min_prefix[v] > target) {
+                    e = before;
+                    j -= 8;
+                    continue;
+                }
+            }
+            if (e <= target) {
+                return j - 1;
+            }
+            e -= bits[j - 1] ? 1 : -1;
+            --j;
+        }
+        // e is now the excess before the block
+        if (0 == j) {
+            return npos;
+        }
+        if (e <= target) {
+            return j - 1;
+        }
+        std::size_t b = last_block_at_most(1, 0, leaves, 0, i / block_size, target);
+        if (npos == b) {
+            return npos;
+        }
+        std::size_t last = std::min(bits.size(), (b + 1) * block_size) - 1;
+        e = excess(last);
+        for (j = last;; --j) {
+            if (e <= target) {
+                return j;
+            }
+            e -= bits[j] ? 1 : -1;
+        }
+    }
+
+    // Minimum over the blocks [lo, hi) in the subtree of x covering [l, r)
+    std::int64_t range_tree_min(std::size_t x, std::size_t l, std::size_t r, std::size_t lo, std::size_t hi) const {
+        if (hi <= l || r <= lo) {
+            return std::numeric_limits<std::int64_t>::max();
+        }
+        if (lo <= l && r <= hi) {
+            return tree[x];
+        }
+        std::size_t mid = (l + r) / 2;
+        return std::min(range_tree_min(2 * x, l, mid, lo, hi), range_tree_min(2 * x + 1, mid, r, lo, hi));
+    }
+
+    // First block in [lo, hi) whose minimum is at most target, npos if none
+    std::size_t first_block_at_most(std::size_t x, std::size_t l, std::size_t r,
+                                    std::size_t lo, std::size_t hi, std::int64_t target) const {
+        if (hi <= l || r <= lo || tree[x] > target) {
+            return npos;
+        }
+        if (r - l == 1) {
+            return l;
+        }
+        std::size_t mid = (l + r) / 2;
+        std::size_t b = first_block_at_most(2 * x, l, mid, lo, hi, target);
+        return (npos != b) ? b : first_block_at_most(2 * x + 1, mid, r, lo, hi, target);
+    }
+
+    // Last block in [lo, hi) whose minimum is at most target, npos if none
+    std::size_t last_block_at_most(std::size_t x, std::size_t l, std::size_t r,
+                                   std::size_t lo, std::size_t hi, std::int64_t target) const {
+        if (hi <= l || r <= lo || tree[x] > target) {
+            return npos;
+        }
+        if (r - l == 1) {
+            return l;
+        }
+        std::size_t mid = (l + r) / 2;
+        std::size_t b = last_block_at_most(2 * x + 1, mid, r, lo, hi, target);
+        return (npos != b) ? b : last_block_at_most(2 * x, l, mid, lo, hi, target);
+    }
+
+    BitVector bits;
+    // Segment tree over the block minima, leaves at [leaves, 2 * leaves)
+    std::vector<std::int64_t> tree;
+    std::size_t leaves;
+};
+
+#endif // _SUCCINCT_HPP_INCLUDED_
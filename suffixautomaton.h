@@ -0,0 +1,293 @@
+#ifndef _SUFFIX_AUTOMATON_HPP_INCLUDED_
+#define _SUFFIX_AUTOMATON_HPP_INCLUDED_
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <cstdint>
+
+#include "suffixtree.h"
+
+// SuffixAutomaton - Generalized suffix automaton (DAWG) of a string collection
+//
+// The smallest automaton recognizing the substrings of the strings: a state
+// is a class of substrings ending at the same set of positions, so there are
+// at most 2n states and 3n transitions, and far fewer than suffix tree nodes
+// on repetitive collections (a repeated block adds no state). Strings are
+// added online with `add_string`, in amortized linear time (the classic
+// construction, restarted from the initial state for every string, cloning
+// a state when an existing transition is reached with a shorter length).
+//
+// Queries:
+//   - is_substring: follow the transitions, O(m log sigma)
+//   - count: occurrences ending in the reached state. The counts are summed
+//     along the suffix links on the first `count` after an `add_string`.
+//   - longest_common_substring: the strings are read again, marking the
+//     states (and their suffix link ancestors) each one reaches.
+//
+// The strings are kept, without end token, for the common substring queries.
+// The end token is forbidden in the input, as for the other indexes.
+template <typename CharType = char, CharType end_token = '$'>
+class SuffixAutomaton {
+public:
+    typedef SuffixTree<CharType, end_token> tree_type;
+    typedef typename tree_type::string string;
+    typedef typename tree_type::index_type index_type;
+    typedef typename tree_type::SuffixEntry SuffixEntry;
+    typedef typename tree_type::SubstringEntry SubstringEntry;
+    typedef std::uint32_t state_type;
+
+private:
+    static const state_type no_state = std::numeric_limits<state_type>::max();
+
+    struct State {
+        // Length of the longest string of the state
+        std::uint32_t len;
+        state_type link;
+        // End of the first occurrence: string index and offset
+        std::uint32_t first_string;
+        std::uint32_t first_end;
+        // Prefixes of the strings ending in this state
+        std::uint32_t occurrences;
+        // Sorted by character
+        std::vector<std::pair<CharType, state_type>> next;
+        State(std::uint32_t l, state_type lk, std::uint32_t str, std::uint32_t end) :
+          len(l),
+          link(lk),
+          first_string(str),
+          first_end(end),
+          occurrences(0)
+          {}
+    };
+
+    std::vector<State> states;
+    std::vector<string> strings;
+    std::size_t transitions;
+    int last_index;
+
+    // Occurrence counts, summed along the suffix links on demand
+    mutable std::mutex counts_mutex;
+    mutable std::vector<std::size_t> counts;
+    mutable bool counts_valid;
+
+    state_type transition(state_type s, CharType c) const {
+        auto const & next = states[s].next;
+        auto it = std::lower_bound(next.begin(), next.end(), std::make_pair(c, state_type(0)),
+            [](std::pair<CharType, state_type> const & a, std::pair<CharType, state_type> const & b) {
+                return a.first < b.first;
+            });
+        return (next.end() != it && it->first == c) ? it->second : no_state;
+    }
+
+    void set_transition(state_type s, CharType c, state_type target) {
+        auto & next = states[s].next;
+        auto it = std::lower_bound(next.begin(), next.end(), std::make_pair(c, state_type(0)),
+            [](std::pair<CharType, state_type> const & a, std::pair<CharType, state_type> const & b) {
+                return a.first < b.first;
+            });
+        if (next.end() != it && it->first == c) {
+            it->second = target;
+        } else {
+            next.insert(it, std::make_pair(c, target));
+            ++transitions;
+        }
+    }
+
+    // Copy of q with a shorter length, taking over the transitions to q from
+    // p and its suffix link ancestors
+    state_type split(state_type p, CharType c, state_type q) {
+        state_type clone = states.size();
+        State copy(states[p].len + 1, states[q].link, states[q].first_string, states[q].first_end);
+        copy.next = states[q].next;
+        transitions += copy.next.size();
+        states.push_back(std::move(copy));
+        states[q].link = clone;
+        for (; no_state != p && transition(p, c) == q; p = states[p].link) {
+            set_transition(p, c, clone);
+        }
+        return clone;
+    }
+
+    // extend - Append c to the string whose longest prefix read so far
+    // ends in `last`; returns the state of the new prefix
+    state_type extend(state_type last, CharType c, std::uint32_t str, std::uint32_t end) {
+        state_type q = transition(last, c);
+        if (no_state != q) {
+            // The prefix already occurs in a previous string
+            return (states[last].len + 1 == states[q].len) ? q : split(last, c, q);
+        }
+        state_type cur = states.size();
+        states.push_back(State(states[last].len + 1, 0, str, end));
+        state_type p = last;
+        for (; no_state != p && no_state == transition(p, c); p = states[p].link) {
+            set_transition(p, c, cur);
+        }
+        if (no_state != p) {
+            q = transition(p, c);
+            states[cur].link = (states[p].len + 1 == states[q].len) ? q : split(p, c, q);
+        }
+        return cur;
+    }
+
+    // walk - State reached by reading a string from the initial state
+    state_type walk(string const & s) const {
+        state_type x = 0;
+        for (auto it = s.begin(); it != s.end() && no_state != x; ++it) {
+            x = transition(x, *it);
+        }
+        return x;
+    }
+
+    void update_counts() const {
+        // States by decreasing length (counting sort), then sum each state
+        // into its suffix link
+        std::size_t max_len = 0;
+        for (auto const & s : states) {
+            max_len = std::max<std::size_t>(max_len, s.len);
+        }
+        std::vector<std::size_t> bucket(max_len + 2, 0);
+        for (auto const & s : states) {
+            ++bucket[s.len + 1];
+        }
+        for (std::size_t l = 1; l < bucket.size(); ++l) {
+            bucket[l] += bucket[l - 1];
+        }
+        std::vector<state_type> order(states.size());
+        for (state_type x = 0; x < states.size(); ++x) {
+            order[bucket[states[x].len]++] = x;
+        }
+        counts.assign(states.size(), 0);
+        for (state_type x = 0; x < states.size(); ++x) {
+            counts[x] = states[x].occurrences;
+        }
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            if (0 != *it) {
+                counts[states[*it].link] += counts[*it];
+            }
+        }
+        counts_valid = true;
+    }
+
+public:
+    SuffixAutomaton() : transitions(0), last_index(0), counts_valid(false) {
+        states.push_back(State(0, no_state, 0, 0));
+    }
+
+    // add_string - Add the substrings of a string to the automaton
+    // Returns the id of the string (1, 2, ...).
+    template <typename InputIterator>
+    int add_string(InputIterator const & str_begin, InputIterator const & str_end) {
+        string s(str_begin, str_end);
+        if (std::find(s.begin(), s.end(), end_token) != s.end()) {
+            throw std::invalid_argument("Input range contains the end token");
+        }
+        std::uint32_t str = strings.size();
+        state_type last = 0;
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            last = extend(last, s[i], str, i);
+            ++states[last].occurrences;
+        }
+        strings.push_back(std::move(s));
+        counts_valid = false;
+        return ++last_index;
+    }
+
+    template <typename InputIterator>
+    bool is_substring(InputIterator const & str_begin, InputIterator const & str_end) const {
+        return no_state != walk(string(str_begin, str_end));
+    }
+
+    // count - Number of occurrences of a string in the collection
+    template <typename InputIterator>
+    std::size_t count(InputIterator const & str_begin, InputIterator const & str_end) const {
+        string s(str_begin, str_end);
+        if (s.empty()) {
+            return 0;
+        }
+        state_type x = walk(s);
+        if (no_state == x) {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(counts_mutex);
+        if (!counts_valid) {
+            update_counts();
+        }
+        return counts[x];
+    }
+
+    // longest_common_substring - Longest substring shared by several strings
+    // @min_strings[in]: How many strings must contain it (0: all of them)
+    //
+    // Among the longest ones, the one occurring first is returned, located by
+    // its first occurrence. The length is 0 if there is none.
+    SubstringEntry longest_common_substring(std::size_t min_strings = 0) const {
+        if (0 == min_strings) {
+            min_strings = strings.size();
+        }
+        min_strings = std::max<std::size_t>(min_strings, 1);
+        std::vector<std::uint32_t> last_seen(states.size(), state_type(no_state));
+        std::vector<std::uint32_t> seen_by(states.size(), 0);
+        for (std::uint32_t str = 0; str < strings.size(); ++str) {
+            state_type x = 0;
+            for (CharType c : strings[str]) {
+                x = transition(x, c);
+                for (state_type y = x; 0 != y && last_seen[y] != str; y = states[y].link) {
+                    last_seen[y] = str;
+                    ++seen_by[y];
+                }
+            }
+        }
+        SubstringEntry best;
+        state_type best_state = 0;
+        for (state_type x = 1; x < states.size(); ++x) {
+            if (seen_by[x] < min_strings) {
+                continue;
+            }
+            State const & s = states[x];
+            State const & b = states[best_state];
+            if (s.len > b.len || (s.len == b.len && 0 != best_state &&
+                    std::make_pair(s.first_string, s.first_end) < std::make_pair(b.first_string, b.first_end))) {
+                best_state = x;
+            }
+        }
+        if (0 != best_state) {
+            State const & s = states[best_state];
+            best = SubstringEntry(SuffixEntry(s.first_string + 1, s.first_end + 1 - s.len), s.len);
+        }
+        return best;
+    }
+
+    std::vector<int> string_ids() const {
+        std::vector<int> result(strings.size());
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            result[i] = i + 1;
+        }
+        return result;
+    }
+
+    std::size_t state_count() const {
+        return states.size();
+    }
+
+    std::size_t transition_count() const {
+        return transitions;
+    }
+
+    // Bytes used by the automaton, the stored strings included
+    std::size_t size_in_bytes() const {
+        std::size_t total = sizeof(*this) + states.capacity() * sizeof(State) +
+            counts.capacity() * sizeof(std::size_t) + strings.capacity() * sizeof(string);
+        for (auto const & s : states) {
+            total += s.next.capacity() * sizeof(std::pair<CharType, state_type>);
+        }
+        for (auto const & s : strings) {
+            total += s.capacity() * sizeof(CharType);
+        }
+        return total;
+    }
+};
+
+#endif // _SUFFIX_AUTOMATON_HPP_INCLUDED_
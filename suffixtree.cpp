@@ -0,0 +1,7 @@
+// Explicit instantiations of the common trees (CMake target
+// suffixtree_compiled, see SUFFIXTREE_EXTERN_TEMPLATES in suffixtree.h)
+
+#include "suffixtree.h"
+
+template class SuffixTree<char>;
+template class SuffixTree<std::uint32_t, 0>;
@@ -2,6 +2,9 @@
 #define _SUFFIX_TREE_HPP_INCLUDED_
 
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <list>
 #include <utility>
@@ -10,17 +13,460 @@
 #include <limits>
 #include <vector>
 #include <algorithm>
+#include <tuple>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
 
-template <typename CharType = char, CharType end_token = '$'>
+#include "bufferedreader.h"
+#include "bufferedwriter.h"
+#include "memoryresource.h"
+#include "metrics.h"
+
+// ConstructionStats - Counters of the construction hot paths
+//
+// Only updated when SUFFIXTREE_INSTRUMENTATION is defined: otherwise
+// SUFFIXTREE_STAT expands to nothing and the insertions are left untouched.
+// Each thread has its own counters (`construction_stats()`), so building
+// trees concurrently needs no synchronization; a thread's counters cover
+// every tree it builds until they are reset.
+struct ConstructionStats {
+    // Internal nodes created, by splitting an edge (test_and_split, or a
+    // top-down insertion)
+    std::uint64_t splits;
+    // Leaves created
+    std::uint64_t leaves;
+    // Suffix links followed while walking the border path
+    std::uint64_t suffix_link_hops;
+    // Edges skipped by canonize
+    std::uint64_t canonize_steps;
+    // Ukkonen phases (update calls), and those stopping at the end point
+    // without creating a leaf
+    std::uint64_t phases;
+    std::uint64_t endpoint_hits;
+    // Longest suffix still implicit at the start of a phase: the string
+    // depth of the active point
+    std::uint64_t max_active_depth;
+
+    ConstructionStats() {
+        reset();
+    }
+
+    void reset() {
+        splits = leaves = suffix_link_hops = canonize_steps = phases = endpoint_hits = max_active_depth = 0;
+    }
+
+    // dump - One line of name=value pairs
+    void dump(std::ostream & out) const {
+        out << "splits=" << splits << " leaves=" << leaves << " suffix_link_hops=" << suffix_link_hops
+            << " canonize_steps=" << canonize_steps << " phases=" << phases
+            << " endpoint_hits=" << endpoint_hits << " max_active_depth=" << max_active_depth << std::endl;
+    }
+};
+
+// The counters of the calling thread
+inline ConstructionStats & construction_stats() {
+    static thread_local ConstructionStats stats;
+    return stats;
+}
+
+#ifdef SUFFIXTREE_INSTRUMENTATION
+// ConstructionStatsBatch - Resets the calling thread's counters, and dumps
+// them when it goes out of scope: wrap a batch of add_string calls in it
+class ConstructionStatsBatch {
+    std::ostream & out;
+public:
+    explicit ConstructionStatsBatch(std::ostream & o = std::cerr) : out(o) {
+        construction_stats().reset();
+    }
+    ~ConstructionStatsBatch() {
+        construction_stats().dump(out);
+    }
+};
+
+#define SUFFIXTREE_STAT(statement) do { ConstructionStats & stats_ = construction_stats(); statement; } while (0)
+#else
+// Without the counters, an empty batch that neither resets nor prints
+class ConstructionStatsBatch {
+public:
+    ConstructionStatsBatch() {}
+    explicit ConstructionStatsBatch(std::ostream &) {}
+};
+
+#define SUFFIXTREE_STAT(statement) do {} while (0)
+#endif
+
+// The Allocator provides every allocation of the tree: nodes, transitions,
+// suffix lists and text through a copy given to the constructor, temporary
+// buffers of the queries through default-constructed ones. Plain pointers
+// are assumed. ResourceAllocator (memoryresource.h), or
+// std::pmr::polymorphic_allocator in C++17, draws from a memory resource.
+template <typename CharType = char, CharType end_token = '$', typename Allocator = std::allocator<CharType>>
 class SuffixTree {
     // Forward declarations of inner classes
     struct Node;
+    struct Leaf;
+public:
+    typedef Allocator allocator_type;
+    template <typename T>
+    using rebind_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
 
-    typedef typename std::vector<CharType> string;
+    typedef typename std::vector<CharType, rebind_alloc<CharType>> string;
     typedef typename std::iterator_traits<typename string::iterator>::difference_type index_type;
     typedef CharType character;
+
+    // A suffix of the haystack: the suffix of string `ref_str` starting at
+    // `offset`. Suffix arrays are exported as vectors of those.
+    struct SuffixEntry {
+        int ref_str;
+        index_type offset;
+        SuffixEntry() : ref_str(0), offset(0) {}
+        SuffixEntry(int ref, index_type off) : ref_str(ref), offset(off) {}
+    };
+
+    // What a visitor gets to know about a node during a traversal.
+    // `node`, `parent` and `suffix_link` are opaque handles: they identify the
+    // nodes but cannot be dereferenced outside of the tree.
+    struct NodeInfo {
+        const Node *node;
+        const Node *parent;
+        const Node *suffix_link;
+        // Label of the incoming edge: `edge_length` characters of string
+        // `ref_str` starting at `edge_l` (nothing for the root)
+        int ref_str;
+        index_type edge_l;
+        index_type edge_length;
+        index_type string_depth;
+        index_type node_depth;
+        // Position among the visited siblings
+        std::size_t rank;
+        std::size_t children;
+        // Suffixes ending on a leaf, null for internal nodes
+        const std::vector<SuffixEntry, rebind_alloc<SuffixEntry>> *suffixes;
+        // A leaf of a depth-truncated tree cut at the maximum depth: its path
+        // does not end with the end token
+        bool truncated;
+        bool is_leaf() const {
+            return (nullptr != suffixes);
+        }
+    };
+
+    // TreeVisitor - Base of the visitors given to `traverse`
+    // `pre` is called when a node is reached, and returning false prunes its
+    // subtree. `post` is called once the subtree has been walked. Visitors are
+    // static: hide the callbacks you need, there is no virtual dispatch.
+    struct TreeVisitor {
+        bool pre(NodeInfo const &) {
+            return true;
+        }
+        void post(NodeInfo const &) {
+        }
+    };
+
+    enum class TraversalOrder {
+        depth_first,
+        breadth_first
+    };
+
+    struct TraversalOptions {
+        TraversalOrder order;
+        // Visit the children in lexicographic order (slower: they are
+        // sorted at each node)
+        bool ordered;
+        TraversalOptions(TraversalOrder o = TraversalOrder::depth_first, bool sorted = false) :
+          order(o),
+          ordered(sorted)
+          {}
+    };
+
+    enum class ExportFormat {
+        // Graphviz digraph
+        dot,
+        // {"nodes": [...]}, one object per node with its parent id
+        json,
+        // Compact binary edge list (see `export_tree`)
+        edge_list
+    };
+
+    struct ExportOptions {
+        // Nodes deeper than that (in edges, below the exported root) are left
+        // out
+        index_type max_depth;
+        // Export the subtree rooted at the locus of this string (the highest
+        // node whose path starts with it); the whole tree if empty
+        string subtree;
+        // Longer DOT/JSON edge labels are truncated and end with "..."
+        index_type max_label_length;
+        ExportOptions() :
+          max_depth(std::numeric_limits<index_type>::max()),
+          subtree(),
+          max_label_length(64)
+          {}
+    };
+
+    // A substring of the haystack: `length` characters of string `ref_str`
+    // starting at `offset`
+    struct SubstringEntry {
+        int ref_str;
+        index_type offset;
+        index_type length;
+        SubstringEntry() : ref_str(0), offset(0), length(0) {}
+        SubstringEntry(SuffixEntry const & where, index_type len) :
+          ref_str(where.ref_str),
+          offset(where.offset),
+          length(len)
+          {}
+    };
+
+    // A right-maximal repeat: a substring occurring `count` times, not always
+    // followed by the same character. `first` is its lexicographically
+    // smallest occurrence (as a suffix).
+    struct Repeat {
+        SuffixEntry first;
+        index_type length;
+        std::size_t count;
+    };
+
+    // Bytes held by a tree, by component (see memory_usage)
+    struct MemoryUsage {
+        // The tree object itself (root and sink included)
+        std::size_t tree;
+        // Internal nodes and leaves, their suffix link field excepted; the
+        // leaves' suffix lists
+        std::size_t nodes;
+        std::size_t leaves;
+        std::size_t suffix_lists;
+        // Entries and bucket arrays of the transition hash tables
+        std::size_t transitions;
+        // The suffix link fields, and how many links are set
+        std::size_t suffix_links;
+        std::size_t suffix_link_count;
+        // The strings (end tokens included) and the map holding them
+        std::size_t text;
+        std::size_t haystack;
+        std::size_t borderpath_map;
+        // K-gram index of a truncated tree
+        std::size_t kgram_index;
+        // Heap blocks currently allocated for the above
+        std::size_t allocations;
+        // Characters of the strings, end tokens excluded
+        std::size_t input_characters;
+
+        std::size_t total() const {
+            return tree + nodes + leaves + suffix_lists + transitions + suffix_links + text + haystack +
+                borderpath_map + kgram_index;
+        }
+
+        double bytes_per_char() const {
+            return double(total()) / std::max<std::size_t>(input_characters, 1);
+        }
+    };
+
+    // Representations of the transitions of a node (`Node::g`)
+    enum class TransitionContainer {
+        // std::unordered_map keyed by the first character (the current one)
+        hash_map,
+        // Children sorted by first character in a vector, binary searched
+        sorted_vector,
+        // One slot per symbol of the alphabet, indexed directly
+        direct_array
+    };
+
+    // Shape of a tree (see tree_stats)
+    // The depth, edge length and suffix link chain histograms are
+    // logarithmic: bucket 0 counts the zeros, bucket b > 0 the values in
+    // [2^(b-1), 2^b) (see `bucket`).
+    struct TreeStats {
+        // Internal nodes (root included), leaves, and suffixes on the leaves
+        std::size_t internal_nodes;
+        std::size_t leaves;
+        std::size_t suffixes;
+        // branching[k]: number of internal nodes with k children
+        std::vector<std::size_t> branching;
+        // Depths of all the nodes, in characters and in edges
+        std::vector<std::size_t> string_depth;
+        std::vector<std::size_t> node_depth;
+        index_type max_string_depth;
+        index_type max_node_depth;
+        // Lengths of the edge labels
+        std::vector<std::size_t> edge_length;
+        std::size_t total_edge_length;
+        // Internal nodes (root excepted) with and without a suffix link. A
+        // link drops the first character of the path, so the chain from a
+        // node to the root is as long as its string depth.
+        std::size_t suffix_links;
+        std::size_t missing_suffix_links;
+        std::vector<std::size_t> suffix_link_chain;
+        // Symbols leaving the root, end token included
+        std::size_t alphabet;
+        // Estimated bytes of the transitions (containers included) in each
+        // representation, indexed by TransitionContainer
+        std::size_t transition_bytes[3];
+        // Estimated total bytes of the tree once its input is twice as long
+        std::size_t next_doubling_bytes;
+
+        TreeStats() :
+          internal_nodes(0),
+          leaves(0),
+          suffixes(0),
+          max_string_depth(0),
+          max_node_depth(0),
+          total_edge_length(0),
+          suffix_links(0),
+          missing_suffix_links(0),
+          alphabet(0),
+          transition_bytes(),
+          next_doubling_bytes(0)
+          {}
+
+        static std::size_t bucket(index_type value) {
+            std::size_t b = 0;
+            for (; value > 0; value >>= 1) {
+                ++b;
+            }
+            return b;
+        }
+
+        std::size_t edges() const {
+            return internal_nodes + leaves - 1;
+        }
+
+        double mean_branching() const {
+            return double(edges()) / std::max<std::size_t>(internal_nodes, 1);
+        }
+
+        // branching_percentile - Smallest k such that a fraction @q of the
+        // internal nodes have at most k children
+        std::size_t branching_percentile(double q) const {
+            std::size_t seen = 0;
+            for (std::size_t k = 0; k < branching.size(); ++k) {
+                seen += branching[k];
+                if (seen >= q * internal_nodes) {
+                    return k;
+                }
+            }
+            return branching.empty() ? 0 : branching.size() - 1;
+        }
+
+        // recommended_transitions - The direct array when it costs no more
+        // memory than the hash maps (fastest lookups), else sorted vectors
+        // when 99% of the nodes have at most 16 children (a binary search
+        // within a cache line or two), else the hash maps
+        TransitionContainer recommended_transitions() const {
+            std::size_t const *bytes = transition_bytes;
+            if (bytes[int(TransitionContainer::direct_array)] <= bytes[int(TransitionContainer::hash_map)]) {
+                return TransitionContainer::direct_array;
+            }
+            if (branching_percentile(0.99) <= 16) {
+                return TransitionContainer::sorted_vector;
+            }
+            return TransitionContainer::hash_map;
+        }
+
+        void merge(TreeStats const & other) {
+            internal_nodes += other.internal_nodes;
+            leaves += other.leaves;
+            suffixes += other.suffixes;
+            merge_histogram(&branching, other.branching);
+            merge_histogram(&string_depth, other.string_depth);
+            merge_histogram(&node_depth, other.node_depth);
+            merge_histogram(&edge_length, other.edge_length);
+            merge_histogram(&suffix_link_chain, other.suffix_link_chain);
+            max_string_depth = std::max(max_string_depth, other.max_string_depth);
+            max_node_depth = std::max(max_node_depth, other.max_node_depth);
+            total_edge_length += other.total_edge_length;
+            suffix_links += other.suffix_links;
+            missing_suffix_links += other.missing_suffix_links;
+        }
+
+        // dump - Print the statistics, one line per measure, logarithmic
+        // histograms as "bucket lower bound:count" pairs
+        void dump(std::ostream & out) const {
+            static const char *containers[] = {"hash_map", "sorted_vector", "direct_array"};
+            out << "internal_nodes=" << internal_nodes << " leaves=" << leaves << " suffixes=" << suffixes
+                << " alphabet=" << alphabet << "\n";
+            out << "branching mean=" << mean_branching() << " p50=" << branching_percentile(0.5)
+                << " p99=" << branching_percentile(0.99) << " max=" << (branching.empty() ? 0 : branching.size() - 1)
+                << "\n";
+            dump_histogram(out, "string_depth", string_depth, max_string_depth);
+            dump_histogram(out, "node_depth", node_depth, max_node_depth);
+            dump_histogram(out, "edge_length", edge_length, 0);
+            out << "suffix_links=" << suffix_links << " missing=" << missing_suffix_links << "\n";
+            dump_histogram(out, "suffix_link_chain", suffix_link_chain, 0);
+            out << "transition_bytes";
+            for (int c = 0; c < 3; ++c) {
+                out << " " << containers[c] << "=" << transition_bytes[c];
+            }
+            out << " recommended=" << containers[int(recommended_transitions())] << "\n";
+            out << "next_doubling_bytes=" << next_doubling_bytes << std::endl;
+        }
+
+        static void count(std::vector<std::size_t> *histogram, std::size_t slot) {
+            if (histogram->size() <= slot) {
+                histogram->resize(slot + 1, 0);
+            }
+            ++(*histogram)[slot];
+        }
+
+    private:
+        static void dump_histogram(std::ostream & out, char const *name, std::vector<std::size_t> const & h,
+                                   index_type max) {
+            out << name;
+            if (max > 0) {
+                out << " max=" << max;
+            }
+            for (std::size_t b = 0; b < h.size(); ++b) {
+                if (h[b] > 0) {
+                    out << " " << (0 == b ? 0 : index_type(1) << (b - 1)) << ":" << h[b];
+                }
+            }
+            out << "\n";
+        }
+
+        static void merge_histogram(std::vector<std::size_t> *into, std::vector<std::size_t> const & from) {
+            if (into->size() < from.size()) {
+                into->resize(from.size(), 0);
+            }
+            for (std::size_t i = 0; i < from.size(); ++i) {
+                (*into)[i] += from[i];
+            }
+        }
+    };
+
+    class LexicographicIterator;
+
+private:
     typedef std::tuple<Node*,index_type, index_type> ReferencePoint;
 
+    // Containers using the Allocator: copies of the tree's for the nodes and
+    // the text, default-constructed ones for temporary buffers
+    template <typename T>
+    using alloc_vector = std::vector<T, rebind_alloc<T>>;
+    template <typename Key, typename Value>
+    using alloc_map = std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>,
+                                         rebind_alloc<std::pair<const Key, Value>>>;
+
+    // An empty map using @a (an empty unordered_map holds no buckets until
+    // its first insertion)
+    template <typename Map>
+    static Map make_map(Allocator const & a) {
+        return Map(0, typename Map::hasher(), typename Map::key_equal(), typename Map::allocator_type(a));
+    }
+
+    // How the suffixes are inserted. A tree holds either every suffix of its
+    // strings (Ukkonen's algorithm), only selected ones (top-down insertion,
+    // no suffix links), or their prefixes up to a maximum depth (truncated
+    // tree, set at construction): the modes cannot be mixed.
+    enum class BuildMode {
+        empty,
+        ukkonen,
+        sparse,
+        truncated
+    };
+
 
     // NESTED CLASSES DEFINITIONS
 
@@ -64,8 +510,10 @@ class SuffixTree {
         }
     };
 
+    typedef alloc_map<CharType, Transition> TransitionMap;
+
     struct Node {
-        std::unordered_map<CharType, Transition> g;
+        TransitionMap g;
         Node *suffix_link;
         virtual Transition find_alpha_transition(CharType alpha) {
             auto it = g.find(alpha);
@@ -75,7 +523,11 @@ class SuffixTree {
             return it->second;
         }
         
-        Node() : suffix_link(nullptr) {}
+        virtual Leaf *as_leaf() {
+            return nullptr;
+        }
+        
+        explicit Node(Allocator const & a) : g(make_map<TransitionMap>(a)), suffix_link(nullptr) {}
         virtual ~Node() {}
         
         void dump_info() {
@@ -90,6 +542,7 @@ class SuffixTree {
     // Instead of creating such transitions, we just make them up through
     // an override of `find_alpha_transition`
     struct SinkNode : public Node {
+        explicit SinkNode(Allocator const & a) : Node(a) {}
         virtual Transition find_alpha_transition(CharType alpha) override {
             return Transition(MappedSubstring(0, 0, 0), this->suffix_link);
         }
@@ -99,8 +552,26 @@ class SuffixTree {
     // Leaves must contain an explicit reference to the suffix they represent
     // Some strings might have common suffixes, hence the map.
     // The suffix link **remains** UNIQUE nonetheless.
+    //
+    // Suffixes are listed by increasing string id, which is also their
+    // lexicographic order (the end token of string i sorts before the one of
+    // string j > i).
     struct Leaf : public Node {
-        // TODO
+        alloc_vector<SuffixEntry> suffixes;
+        explicit Leaf(Allocator const & a) : Node(a), suffixes(a) {}
+        virtual Leaf *as_leaf() override {
+            return this;
+        }
+    };
+
+    // The root and the sink, allocated together
+    struct Roots {
+        SinkNode sink;
+        Node root;
+        explicit Roots(Allocator const & a) : sink(a), root(a) {
+            root.suffix_link = &sink;
+            sink.suffix_link = &root;
+        }
     };
 
     // Base - A tree nested base class
@@ -108,29 +579,85 @@ class SuffixTree {
     // And to handle destruction properly.
     //
     // The processing (insertion, deletion of strings) is done by SuffixTree,
-    // Base handles the cleanup.
+    // Base handles the cleanup. When the allocator frees nothing until its
+    // memory is released at once (see releases_in_bulk), the nodes are left
+    // alone.
+    //
+    // Nothing points into Base: the nodes live on the heap, roots included,
+    // so that moving a tree moves two pointers. A tree without nodes (new,
+    // or moved from) uses the shared empty roots until its first insertion.
     struct Base {
-        SinkNode sink;
-        Node root;
-        Base() {
-            root.suffix_link = &sink;
-            sink.suffix_link = &root;
+        Allocator alloc;
+        Roots *roots;
+        explicit Base(Allocator const & a) : alloc(a), roots(empty_roots()) {}
+        Base(Base&& other) noexcept : alloc(other.alloc), roots(other.roots) {
+            other.roots = empty_roots();
         }
+        Base(Base const &) = delete;
+        Base& operator=(Base const &) = delete;
         ~Base() {
-            clean();
+            release();
+        }
+        // release - Free the nodes, leaving the tree without nodes
+        void release() {
+            if (owns_roots()) {
+                if (!releases_in_bulk(alloc)) {
+                    clean();
+                }
+                roots = empty_roots();
+            }
+        }
+        // Shared by the trees without nodes, never modified
+        static Roots *empty_roots() {
+            static Roots empty((Allocator()));
+            return &empty;
+        }
+        bool owns_roots() const {
+            return empty_roots() != roots;
+        }
+        Node *root() const {
+            return &roots->root;
+        }
+        // make_roots - Give the tree roots of its own, before its first
+        // insertion
+        void make_roots() {
+            if (!owns_roots()) {
+                roots = new (allocate<Roots>()) Roots(alloc);
+            }
+        }
+        template <typename T>
+        T *allocate() {
+            rebind_alloc<T> a(alloc);
+            return std::allocator_traits<rebind_alloc<T>>::allocate(a, 1);
+        }
+        template <typename T>
+        void deallocate(T *p) {
+            rebind_alloc<T> a(alloc);
+            std::allocator_traits<rebind_alloc<T>>::deallocate(a, p, 1);
         }
         void clean() {
-            std::list<Node*> del_list {&root};
+            std::list<Node*> del_list {root()};
             while (!del_list.empty()) {
                 Node *current = del_list.front();
                 del_list.pop_front();
                 for (auto it : current->g) {
                     del_list.push_back(it.second.tgt);
                 }
-                if (&root != current) {
-                    delete current;
+                if (root() != current) {
+                    destroy(current);
                 }
             }
+            roots->~Roots();
+            deallocate(roots);
+        }
+        void destroy(Node *n) {
+            if (Leaf *leaf = n->as_leaf()) {
+                leaf->~Leaf();
+                deallocate(leaf);
+            } else {
+                n->~Node();
+                deallocate(n);
+            }
         }
     };
 
@@ -138,13 +665,171 @@ class SuffixTree {
 
     Base tree;
 
-    std::unordered_map<int, string> haystack;
-    std::unordered_map<int, Node*> borderpath_map;
+    alloc_map<int, string> haystack;
+    alloc_map<int, Node*> borderpath_map;
     int last_index;
+    BuildMode mode;
+
+    // Latency histograms and build phase callbacks, not owned (null: off)
+    QueryMetrics *metrics;
+    BuildTracer *tracer;
+
+    // Truncated trees: the maximum depth K, and the leaf of each K-gram
+    // indexed by a polynomial hash (collisions are resolved by comparing the
+    // text). powers[i] is hash_base^i.
+    typedef std::unordered_multimap<std::uint64_t, Leaf*, std::hash<std::uint64_t>, std::equal_to<std::uint64_t>,
+                                    rebind_alloc<std::pair<const std::uint64_t, Leaf*>>> KgramMap;
+    index_type depth_limit;
+    KgramMap kgram_leaves;
+    alloc_vector<std::uint64_t> powers;
+    static const std::uint64_t hash_base = 0x100000001b3ULL;
+
+    // Whether moving the containers may throw, which depends on the
+    // allocator (for assignments: unless it propagates or is always equal,
+    // unequal allocators make the containers copy)
+    static constexpr bool nothrow_move_construct =
+        std::is_nothrow_move_constructible<alloc_map<int, string>>::value &&
+        std::is_nothrow_move_constructible<alloc_map<int, Node*>>::value &&
+        std::is_nothrow_move_constructible<KgramMap>::value &&
+        std::is_nothrow_move_constructible<alloc_vector<std::uint64_t>>::value;
+    static constexpr bool nothrow_move_assign =
+        std::is_nothrow_move_assignable<alloc_map<int, string>>::value &&
+        std::is_nothrow_move_assignable<alloc_map<int, Node*>>::value &&
+        std::is_nothrow_move_assignable<KgramMap>::value &&
+        std::is_nothrow_move_assignable<alloc_vector<std::uint64_t>>::value;
+    typedef typename std::allocator_traits<Allocator>::propagate_on_container_move_assignment propagate_on_move;
+
+    // truncate - Make the (empty) tree a depth-truncated one
+    void truncate(index_type max_depth) {
+        if (max_depth < 1) {
+            throw std::invalid_argument("SuffixTree: the maximum depth must be positive");
+        }
+        mode = BuildMode::truncated;
+        depth_limit = max_depth;
+        powers.assign(max_depth + 1, 1);
+        for (index_type i = 1; i <= max_depth; ++i) {
+            powers[i] = powers[i - 1] * hash_base;
+        }
+    }
+
+    void set_mode(BuildMode m) {
+        if (BuildMode::empty != mode && m != mode) {
+            throw std::logic_error("SuffixTree: insertion modes cannot be mixed");
+        }
+        mode = m;
+    }
+
+    // Sizes kept up to date by the insertions, for memory_usage: counts of
+    // objects and the capacities of their containers
+    struct Footprint {
+        std::size_t nodes;
+        std::size_t leaves;
+        std::size_t transitions;
+        std::size_t buckets;
+        std::size_t suffix_links;
+        std::size_t suffix_capacity;
+        std::size_t text_capacity;
+        std::size_t characters;
+        std::size_t allocations;
+        Footprint() :
+          nodes(0),
+          leaves(0),
+          transitions(0),
+          buckets(0),
+          suffix_links(0),
+          suffix_capacity(0),
+          text_capacity(0),
+          characters(0),
+          allocations(0)
+          {}
+    };
+
+    Footprint footprint;
+
+    // The tree is only grown through the following functions, which keep
+    // `footprint` in sync.
+
+    Node *make_node() {
+        SUFFIXTREE_STAT(++stats_.splits);
+        ++footprint.nodes;
+        ++footprint.allocations;
+        return new (tree.template allocate<Node>()) Node(tree.alloc);
+    }
+
+    Leaf *make_leaf(SuffixEntry const & first) {
+        SUFFIXTREE_STAT(++stats_.leaves);
+        ++footprint.leaves;
+        ++footprint.allocations;
+        Leaf *leaf = new (tree.template allocate<Leaf>()) Leaf(tree.alloc);
+        add_suffix(leaf, first);
+        return leaf;
+    }
+
+    void add_suffix(Leaf *leaf, SuffixEntry const & e) {
+        std::size_t before = leaf->suffixes.capacity();
+        leaf->suffixes.push_back(e);
+        if (leaf->suffixes.capacity() != before) {
+            footprint.suffix_capacity += leaf->suffixes.capacity() - before;
+            ++footprint.allocations;
+        }
+    }
+
+    void add_transition(Node *n, CharType c, Transition const & t) {
+        std::size_t before = n->g.bucket_count();
+        n->g.insert(std::make_pair(c, t));
+        ++footprint.transitions;
+        ++footprint.allocations;
+        if (n->g.bucket_count() != before) {
+            footprint.buckets += n->g.bucket_count() - before;
+            ++footprint.allocations;
+        }
+    }
+
+    template <typename Element>
+    static std::size_t hash_node_size() {
+        return sizeof(void*) + sizeof(Element);
+    }
+
+    void set_suffix_link(Node *n, Node *target) {
+        if (nullptr == n->suffix_link) {
+            ++footprint.suffix_links;
+        }
+        n->suffix_link = target;
+    }
+
+    string const & store_string(int id, string s) {
+        footprint.text_capacity += s.capacity();
+        footprint.characters += s.size() - 1;
+        // The map node and the string buffer
+        footprint.allocations += 2;
+        return haystack.emplace(id, std::move(s)).first->second;
+    }
+
+    void drop_string(int id) {
+        auto it = haystack.find(id);
+        footprint.text_capacity -= it->second.capacity();
+        footprint.characters -= it->second.size() - 1;
+        footprint.allocations -= 2;
+        haystack.erase(it);
+    }
+
+    // ingest - Copy a string (end token appended) into the haystack under
+    // the next id
+    template <typename InputIterator>
+    string const & ingest(InputIterator const & str_begin, InputIterator const & str_end) {
+        PhaseScope phase(tracer, BuildPhase::text_ingestion, last_index + 1);
+        if (!tree.owns_roots()) {
+            tree.make_roots();
+            ++footprint.allocations;
+        }
+        auto s = make_string(str_begin, str_end, tree.alloc);
+        ++last_index;
+        return store_string(last_index, std::move(s));
+    }
     
     std::string to_string(string const & s, index_type b, index_type e) {
         std::string result;
-        if (0 <= b && e < s.size()) {
+        if (0 <= b && e < static_cast<index_type>(s.size())) {
             for (auto i = b; i <= e; ++i) {
                 result.push_back(s[i]);
             }
@@ -161,6 +846,7 @@ class SuffixTree {
         if (haystack.end() != it) {
             return to_string(it->second, substr.l, substr.r);
         }
+        return std::string();
     }
 
     // Given a Node n, a substring kp and a character t,
@@ -177,11 +863,10 @@ class SuffixTree {
                 *r = n;
                 return true;
             } 
-            *r = new Node();
+            *r = make_node();
             Transition new_t = tk_trans;
             new_t.sub.l += delta+1;
-            (*r)->g.insert(std::pair<CharType, Transition>(
-                str_prime->second[new_t.sub.l], new_t));
+            add_transition(*r, str_prime->second[new_t.sub.l], new_t);
             tk_trans.sub.r = tk_trans.sub.l + delta;
             tk_trans.tgt = *r;
             n->g[tk] = tk_trans;
@@ -200,9 +885,12 @@ class SuffixTree {
     // and adds the required Transitions brought by the insertion of
     // the string's i-th character.
     //
+    // @suffix_start[in/out] is the start of the longest suffix of the string
+    // that has no leaf yet; every leaf created here labels one more suffix.
+    //
     // It returns the end point.
-    ReferencePoint update(Node *n, MappedSubstring ki) {
-        Node *oldr = &tree.root;
+    ReferencePoint update(Node *n, MappedSubstring ki, index_type *suffix_start) {
+        Node *oldr = tree.root();
         Node *r = nullptr;
         bool is_endpoint = false;
         MappedSubstring ki1 = ki;
@@ -211,21 +899,22 @@ class SuffixTree {
         ReferencePoint sk(n, ki.ref_str, ki.l);
         ki1.r = ki.r-1;
         is_endpoint = test_and_split(n, ki1, w[ki.r], w, &r);
+        SUFFIXTREE_STAT(++stats_.phases; stats_.endpoint_hits += is_endpoint);
         while (!is_endpoint) {
-            Leaf *r_prime = new Leaf();
-            r->g.insert(std::make_pair(
-              w[ki.r], Transition(MappedSubstring(
-              ki.ref_str, ki.r, std::numeric_limits<index_type>::max()), r_prime)));
-            if (&tree.root != oldr) {
-                oldr->suffix_link = r;
+            Leaf *r_prime = make_leaf(SuffixEntry(ki.ref_str, (*suffix_start)++));
+            add_transition(r, w[ki.r], Transition(MappedSubstring(
+              ki.ref_str, ki.r, std::numeric_limits<index_type>::max()), r_prime));
+            if (tree.root() != oldr) {
+                set_suffix_link(oldr, r);
             }
             oldr = r;
+            SUFFIXTREE_STAT(++stats_.suffix_link_hops);
             sk = canonize(std::get<0>(sk)->suffix_link, ki1);
             ki1.l = ki.l = std::get<2>(sk);
             is_endpoint = test_and_split(std::get<0>(sk), ki1, w[ki.r], w, &r);
         }
-        if (&tree.root != oldr) {
-            oldr->suffix_link = std::get<0>(sk);
+        if (tree.root() != oldr) {
+            set_suffix_link(oldr, std::get<0>(sk));
         }
         return sk;
     }
@@ -240,6 +929,7 @@ class SuffixTree {
         index_type delta;
         Transition tk_trans = n->find_alpha_transition(kp_ref_str->second[kp.l]);
         while ((delta = tk_trans.sub.r - tk_trans.sub.l) <= kp.r - kp.l) {
+            SUFFIXTREE_STAT(++stats_.canonize_steps);
             kp.l += 1 + delta;
             n = tk_trans.tgt;
             if (kp.l <= kp.r)
@@ -258,7 +948,7 @@ class SuffixTree {
     // diverging point between @s and the tree.
     // The result '(s,k)' of this function may then be used to resume the Ukkonen's
     // algorithm.
-    index_type get_starting_node(const string& s, ReferencePoint *r) {
+    index_type get_starting_node(const string& s, ReferencePoint *r) const {
         auto k = std::get<2>(*r);
         auto s_len = s.size();
         bool s_runout = false;
@@ -302,112 +992,1802 @@ class SuffixTree {
     // deploy_suffixes performs the Ukkonen's algorithm to inser @s into the
     // tree.
     int deploy_suffixes(const string& s, int sindex) {
-        ReferencePoint active_point(&tree.root, sindex, 0);
-        auto i = get_starting_node(s, &active_point);
+        ReferencePoint active_point(tree.root(), sindex, 0);
+        index_type i;
+        {
+            PhaseScope phase(tracer, BuildPhase::descent, sindex);
+            i = get_starting_node(s, &active_point);
+        }
         if (std::numeric_limits<index_type>::max() == i) {
             return -1;
         }
-        for (; i < s.size(); ++i) {
-            MappedSubstring ki(sindex,std::get<2>(active_point), i);
-            active_point = update(std::get<0>(active_point), ki);
-            ki.l = std::get<2>(active_point);
-            active_point = canonize(std::get<0>(active_point), ki);
+        index_type suffix_start = 0;
+        {
+            PhaseScope phase(tracer, BuildPhase::insertion, sindex);
+            for (; i < static_cast<index_type>(s.size()); ++i) {
+                SUFFIXTREE_STAT(stats_.max_active_depth = std::max<std::uint64_t>(stats_.max_active_depth, i - suffix_start));
+                MappedSubstring ki(sindex,std::get<2>(active_point), i);
+                active_point = update(std::get<0>(active_point), ki, &suffix_start);
+                ki.l = std::get<2>(active_point);
+                active_point = canonize(std::get<0>(active_point), ki);
+            }
         }
+        PhaseScope phase(tracer, BuildPhase::post_processing, sindex);
+        label_implicit_suffixes(s, sindex, active_point, suffix_start);
         return sindex;
     }
 
-    void dump_node(Node *n, bool same_line, index_type padding, MappedSubstring orig) {
-        index_type delta = 0;
-        if (!same_line) {
-            for (index_type i = 0; i < padding; ++i) {
-                std::cout << "  ";
+    // label_implicit_suffixes - Register the suffixes left without a leaf
+    // @s[in]: The string just inserted in the tree
+    // @sindex[in]: The index id of @s
+    // @active_point[in]: The active point after the last phase
+    // @suffix_start[in]: The longest suffix of @s that got no leaf
+    //
+    // Since every string ends with the same end token, the suffixes of @s that
+    // were already in the tree when the last phase ended all end exactly on an
+    // existing leaf. They are walked through the suffix links, starting from
+    // the active point, and appended to those leaves.
+    void label_implicit_suffixes(const string& s, int sindex,
+                                 ReferencePoint active_point, index_type suffix_start) {
+        index_type s_len = s.size();
+        MappedSubstring rest(sindex, std::get<2>(active_point), s_len - 1);
+        while (suffix_start < s_len) {
+            Node *n = std::get<0>(active_point);
+            rest.l = std::get<2>(active_point);
+            Leaf *leaf = n->find_alpha_transition(s[rest.l]).tgt->as_leaf();
+            add_suffix(leaf, SuffixEntry(sindex, suffix_start++));
+            SUFFIXTREE_STAT(++stats_.suffix_link_hops);
+            active_point = canonize(n->suffix_link, rest);
+        }
+    }
+
+    // insert_suffix - Top-down insertion of a single suffix
+    // @s[in]: A string of the haystack, end token included
+    // @sindex[in]: The index id of @s
+    // @p[in]: Offset of the suffix
+    // @end[in]: Where the inserted key stops: s.size(), or p + K in a
+    //           truncated tree (leaving a leaf cut at depth K)
+    //
+    // Walks down from the root while the key matches, then splits the edge
+    // or adds a leaf where it diverges. A key equal to one already in the
+    // tree joins its leaf. The keys never are prefixes of one another (they
+    // end with the end token, or all have length K), so they end on leaves.
+    // The cost is the depth at which the key branches off, and nothing is
+    // created for the other positions of @s.
+    //
+    // Returns the leaf of the key.
+    Leaf *insert_suffix(const string& s, int sindex, index_type p, index_type end) {
+        Node *n = tree.root();
+        index_type k = p;
+        index_type leaf_r = (end == static_cast<index_type>(s.size())) ?
+            std::numeric_limits<index_type>::max() : end - 1;
+        while (true) {
+            auto it = n->g.find(s[k]);
+            if (n->g.end() == it) {
+                Leaf *leaf = make_leaf(SuffixEntry(sindex, p));
+                add_transition(n, s[k], Transition(MappedSubstring(sindex, k, leaf_r), leaf));
+                return leaf;
+            }
+            Transition t = it->second;
+            const string& ref = haystack.find(t.sub.ref_str)->second;
+            index_type length = edge_length(t);
+            index_type j = 1;
+            while (j < length && k + j < end && s[k + j] == ref[t.sub.l + j]) {
+                ++j;
+            }
+            if (j == length) {
+                Leaf *leaf = t.tgt->as_leaf();
+                if (leaf) {
+                    add_suffix(leaf, SuffixEntry(sindex, p));
+                    return leaf;
+                }
+                n = t.tgt;
+                k += length;
+                continue;
             }
+            Node *middle = make_node();
+            Transition lower = t;
+            lower.sub.l += j;
+            add_transition(middle, ref[lower.sub.l], lower);
+            Leaf *leaf = make_leaf(SuffixEntry(sindex, p));
+            add_transition(middle, s[k + j], Transition(MappedSubstring(sindex, k + j, leaf_r), leaf));
+            it->second.sub.r = t.sub.l + j - 1;
+            it->second.tgt = middle;
+            return leaf;
+        }
+    }
+
+    // insert_truncated - Insert the K-prefixes of the suffixes of a string
+    // @s[in]: A string of the haystack, end token included
+    // @sindex[in]: The index id of @s
+    //
+    // The hash of every key comes from the prefix hashes of @s in O(1). A key
+    // already in the tree (found in `kgram_leaves`) only adds an occurrence
+    // to its leaf; the others are inserted top-down. The tree thus grows with
+    // the number of distinct K-grams, not with the length of the text.
+    void insert_truncated(const string& s, int sindex) {
+        index_type n = s.size();
+        alloc_vector<std::uint64_t> prefix(n + 1, 0);
+        std::hash<CharType> char_hash;
+        for (index_type i = 0; i < n; ++i) {
+            prefix[i + 1] = prefix[i] * hash_base + char_hash(s[i]) + 1;
         }
-        if (!orig.empty()) {
-            const auto& s = haystack.find(orig.ref_str);
-            for (index_type i = orig.l; i <= orig.r && i < s->second.size(); ++i) {
-                std::cout << s->second[i] << " ";
+        for (index_type p = 0; p < n; ++p) {
+            index_type end = std::min(n, p + depth_limit);
+            std::uint64_t key = prefix[end] - prefix[p] * powers[end - p];
+            auto range = kgram_leaves.equal_range(key);
+            Leaf *found = nullptr;
+            for (auto it = range.first; it != range.second && !found; ++it) {
+                SuffixEntry const & e = it->second->suffixes.front();
+                const string& ref = haystack.find(e.ref_str)->second;
+                index_type ref_end = std::min(static_cast<index_type>(ref.size()), e.offset + depth_limit);
+                if (ref_end - e.offset == end - p && std::equal(s.begin() + p, s.begin() + end, ref.begin() + e.offset)) {
+                    found = it->second;
+                }
             }
-            std::cout << "- ";
-            delta = orig.r - orig.l + 2;
-            if (orig.r == std::numeric_limits<index_type>::max()) {
-                delta = s->second.size() - orig.l;
+            if (found) {
+                add_suffix(found, SuffixEntry(sindex, p));
+            } else {
+                kgram_leaves.emplace(key, insert_suffix(s, sindex, p, end));
             }
         }
-        same_line = true;
-        for (auto t_it : n->g) {
-            dump_node(t_it.second.tgt, same_line, padding + delta, t_it.second.sub);
-            same_line = false;
+    }
+
+    // truncated_occurrences - Occurrences of a pattern longer than the
+    // maximum depth K of a truncated tree
+    // @limit[in]: Stop after that many occurrences
+    //
+    // The locus of the first K characters is a cut leaf, whose suffixes are
+    // checked against the text.
+    std::vector<SuffixEntry> truncated_occurrences(const string& p, std::size_t limit) const {
+        std::vector<SuffixEntry> result;
+        VisitFrame locus;
+        if (!find_locus(string(p.begin(), p.begin() + depth_limit), &locus) || !locus.node->as_leaf()) {
+            return result;
         }
-        if (same_line) {
-            std::cout << "##" << std::endl;
+        for (auto const & e : locus.node->as_leaf()->suffixes) {
+            const string& s = haystack.find(e.ref_str)->second;
+            if (static_cast<index_type>(s.size()) - e.offset >= static_cast<index_type>(p.size()) &&
+                std::equal(p.begin() + depth_limit, p.end(), s.begin() + e.offset + depth_limit)) {
+                result.push_back(e);
+                if (result.size() >= limit) {
+                    break;
+                }
+            }
         }
+        return result;
     }
-    
+
+    bool beyond_depth_limit(const string& p) const {
+        return BuildMode::truncated == mode && static_cast<index_type>(p.size()) > depth_limit;
+    }
+
     template <typename InputIterator>
-    bool contain_end_token(InputIterator const & str_begin, InputIterator const & str_end) {
+    static bool contain_end_token(InputIterator const & str_begin, InputIterator const & str_end) {
         return (std::find(str_begin, str_end, end_token) != str_end);
     }
     
-    template <typename InputIterator, bool append_end_token = true>
-    string make_string(InputIterator const & str_begin, InputIterator const & str_end) {
+    template <bool append_end_token = true, typename InputIterator>
+    static string make_string(InputIterator const & str_begin, InputIterator const & str_end,
+                              Allocator const & a = Allocator()) {
         if (contain_end_token(str_begin, str_end)) {
             throw std::invalid_argument("Input range contains the end token");
         }
-        return make_string(str_begin, str_end, std::integral_constant<bool, append_end_token>());
+        return make_string(str_begin, str_end, a, std::integral_constant<bool, append_end_token>());
     }
     
     template <typename InputIterator>
-    string make_string(InputIterator const & str_begin, InputIterator const & str_end, std::true_type) {
-        string s(str_begin, str_end);
+    static string make_string(InputIterator const & str_begin, InputIterator const & str_end,
+                              Allocator const & a, std::true_type) {
+        string s(str_begin, str_end, a);
         s.push_back(end_token);
         return s;
     }
     
     template <typename InputIterator>
-    string make_string(InputIterator const & str_begin, InputIterator const & str_end, std::false_type) {
-        index_type str_len = std::distance(str_begin, str_end);
-        string s(str_begin, str_end);
+    static string make_string(InputIterator const & str_begin, InputIterator const & str_end,
+                              Allocator const & a, std::false_type) {
+        string s(str_begin, str_end, a);
         return s;
     }
-public:
-    SuffixTree() : last_index(0) {
+
+    // symbol_less - Lexicographic order of the alphabet
+    // The end token sorts before any other character.
+    static bool symbol_less(CharType a, CharType b) {
+        if (a == b || b == end_token) {
+            return false;
+        }
+        return (a == end_token || a < b);
     }
-    
-    template <typename InputIterator>
-    int add_string(InputIterator const & str_begin, InputIterator const & str_end) {
-        ++last_index;
-        auto s = make_string(str_begin, str_end);
-        haystack.emplace(last_index, std::move(s));
-        const auto& s_from_map = haystack.find(last_index);
-        if (0 > deploy_suffixes(s_from_map->second, last_index)) {
-            haystack.erase(last_index--);
-            return -1;
+
+    // edge_length - Number of characters labeling a transition
+    // Leaf transitions are open-ended: their right ptr is the max index value
+    // and they actually stop at the end of their reference string.
+    index_type edge_length(Transition const & t) const {
+        if (t.sub.r == std::numeric_limits<index_type>::max()) {
+            return haystack.find(t.sub.ref_str)->second.size() - t.sub.l;
         }
-        return last_index;
+        return t.sub.r - t.sub.l + 1;
     }
-    
-    template <typename InputIterator>
-    bool is_suffix(InputIterator const & str_begin, InputIterator const & str_end) {
-        auto s = make_string(str_begin, str_end);
-        ReferencePoint root_point(&tree.root, -1, 0);
-        return (get_starting_node(s, &root_point) == std::numeric_limits<index_type>::max());
+
+    // is_cut - Whether a leaf transition stops at the maximum depth of a
+    // truncated tree (every other leaf transition is open-ended)
+    static bool is_cut(Transition const & t) {
+        return t.sub.r != std::numeric_limits<index_type>::max();
     }
-    
-    template <typename InputIterator>
-    bool is_substring(InputIterator const & str_begin, InputIterator const & str_end) {
-        auto s = make_string<false>(str_begin, str_end);
-        ReferencePoint root_point(&tree.root, -1, 0);
-        return (get_starting_node(s, &root_point) == std::numeric_limits<index_type>::max());
+
+    index_type haystack_length() const {
+        index_type total = 0;
+        for (auto const & it : haystack) {
+            total += it.second.size();
+        }
+        return total;
     }
 
-    ~SuffixTree() {
+    // A node waiting on the traversal stack (or queue).
+    struct VisitFrame {
+        Node *node;
+        Node *parent;
+        Transition edge;
+        index_type depth;
+        index_type node_depth;
+        std::size_t rank;
+        bool expanded;
+    };
+
+    // Traversal stacks and child sorting buffers
+    typedef alloc_vector<VisitFrame> FrameStack;
+    typedef alloc_vector<std::pair<CharType, Transition>> ChildBuffer;
+
+    NodeInfo node_info(VisitFrame const & f) const {
+        NodeInfo info;
+        Leaf *leaf = f.node->as_leaf();
+        info.node = f.node;
+        info.parent = f.parent;
+        info.suffix_link = f.node->suffix_link;
+        info.ref_str = f.edge.sub.ref_str;
+        info.edge_l = f.edge.sub.l;
+        info.edge_length = (nullptr == f.parent) ? 0 : edge_length(f.edge);
+        info.string_depth = f.depth;
+        info.node_depth = f.node_depth;
+        info.rank = f.rank;
+        info.children = f.node->g.size();
+        info.suffixes = leaf ? &leaf->suffixes : nullptr;
+        info.truncated = leaf && is_cut(f.edge);
+        return info;
     }
 
-    void dump_tree() {
-        dump_node(&tree.root, true, 0, MappedSubstring(0,0,-1));
+    // push_children - Append the children of a frame to a stack or a queue
+    // @out[in/out]: Where to append the children
+    // @f[in]: The parent frame
+    // @ordered[in]: Sort the children lexicographically
+    // @reversed[in]: Append them in reverse order (to pop them in order)
+    // @scratch[in/out]: Sorting buffer, reused from one call to the next
+    void push_children(FrameStack *out, VisitFrame const & f, bool ordered, bool reversed,
+                       ChildBuffer *scratch) const {
+        std::size_t base = out->size();
+        std::size_t count = f.node->g.size();
+        if (ordered) {
+            scratch->assign(f.node->g.begin(), f.node->g.end());
+            std::sort(scratch->begin(), scratch->end(),
+                [](std::pair<CharType, Transition> const & a, std::pair<CharType, Transition> const & b) {
+                    return symbol_less(a.first, b.first);
+                });
+        }
+        out->resize(base + count);
+        std::size_t rank = 0;
+        auto place = [&](Transition const & t) {
+            std::size_t slot = reversed ? base + count - 1 - rank : base + rank;
+            (*out)[slot] = VisitFrame{t.tgt, f.node, t, f.depth + edge_length(t),
+                                      f.node_depth + 1, rank, false};
+            ++rank;
+        };
+        if (ordered) {
+            for (auto const & it : *scratch) {
+                place(it.second);
+            }
+        } else {
+            for (auto const & it : f.node->g) {
+                place(it.second);
+            }
+        }
     }
-};
+
+    // traverse_from - The traversal engine
+    // The stack (or the BFS queue) lives on the heap, so the depth of the tree
+    // is only bounded by the available memory.
+    template <typename Visitor>
+    void traverse_from(Visitor& v, VisitFrame const & start, TraversalOptions const & opts) const {
+        FrameStack pending {start};
+        ChildBuffer scratch;
+        if (TraversalOrder::breadth_first == opts.order) {
+            FrameStack next_level;
+            while (!pending.empty()) {
+                for (auto const & f : pending) {
+                    NodeInfo info = node_info(f);
+                    if (v.pre(info) && !info.is_leaf()) {
+                        push_children(&next_level, f, opts.ordered, false, &scratch);
+                    }
+                    v.post(info);
+                }
+                pending.swap(next_level);
+                next_level.clear();
+            }
+            return;
+        }
+        while (!pending.empty()) {
+            if (pending.back().expanded) {
+                NodeInfo info = node_info(pending.back());
+                pending.pop_back();
+                v.post(info);
+                continue;
+            }
+            pending.back().expanded = true;
+            VisitFrame f = pending.back();
+            NodeInfo info = node_info(f);
+            if (v.pre(info) && !info.is_leaf()) {
+                push_children(&pending, f, opts.ordered, true, &scratch);
+            }
+        }
+    }
+
+    // walk_subtrees - Traverse subtrees[i] with visitors[i], on a pool of at
+    // most `hardware_concurrency` threads
+    template <typename Visitor>
+    void walk_subtrees(std::vector<Visitor> *visitors, FrameStack const & subtrees,
+                       TraversalOptions const & opts) const {
+        std::size_t n_tasks = subtrees.size();
+        std::atomic<std::size_t> next_task(0);
+        auto worker = [&]() {
+            for (std::size_t i; (i = next_task++) < n_tasks;) {
+                traverse_from((*visitors)[i], subtrees[i], opts);
+            }
+        };
+        std::size_t n_threads = std::min<std::size_t>(n_tasks,
+            std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < n_threads; ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& th : threads) {
+            th.join();
+        }
+    }
+
+    // Builds the suffix array and the LCP array from an ordered traversal.
+    // The LCP of two consecutive suffixes is the string depth of the deepest
+    // node above both, i.e. the smallest parent depth met since the previous
+    // leaf.
+    struct SuffixArrayVisitor : public TreeVisitor {
+        bool want_sa;
+        bool want_lcp;
+        std::vector<SuffixEntry> sa;
+        std::vector<index_type> lcp;
+        index_type branch_depth;
+        bool first;
+        SuffixArrayVisitor(bool with_sa, bool with_lcp) :
+          want_sa(with_sa),
+          want_lcp(with_lcp),
+          branch_depth(0),
+          first(true)
+          {}
+        bool pre(NodeInfo const & n) {
+            branch_depth = std::min(branch_depth, n.string_depth - n.edge_length);
+            if (!n.is_leaf()) {
+                return true;
+            }
+            for (std::size_t i = 0; i < n.suffixes->size(); ++i) {
+                if (want_sa) {
+                    sa.push_back((*n.suffixes)[i]);
+                }
+                if (want_lcp) {
+                    // Suffixes sharing a leaf agree up to the end token, or
+                    // up to the depth limit on a truncated leaf
+                    index_type shared = n.truncated ? n.string_depth : n.string_depth - 1;
+                    lcp.push_back(first ? 0 : (0 == i) ? branch_depth : shared);
+                }
+                first = false;
+            }
+            branch_depth = std::numeric_limits<index_type>::max();
+            return true;
+        }
+    };
+
+    // export_suffixes - Fill the suffix array and/or the LCP array
+    // @sa[out], @lcp[out]: The arrays to fill (may be null)
+    // @parallel[in]: Split the work over the root subtrees
+    //
+    // A root subtree never shares its first character with its neighbours,
+    // hence the LCP of its first suffix is 0 and the per-subtree results can
+    // simply be concatenated.
+    void export_suffixes(std::vector<SuffixEntry> *sa, std::vector<index_type> *lcp, bool parallel) const {
+        TraversalOptions opts(TraversalOrder::depth_first, true);
+        if (!parallel) {
+            SuffixArrayVisitor v(nullptr != sa, nullptr != lcp);
+            index_type total = haystack_length();
+            v.sa.reserve(sa ? total : 0);
+            v.lcp.reserve(lcp ? total : 0);
+            traverse(v, opts);
+            if (sa) {
+                sa->swap(v.sa);
+            }
+            if (lcp) {
+                lcp->swap(v.lcp);
+            }
+            return;
+        }
+        auto parts = traverse_parallel([&]() {
+            return SuffixArrayVisitor(nullptr != sa, nullptr != lcp);
+        }, opts);
+        for (auto const & v : parts) {
+            if (sa) {
+                sa->insert(sa->end(), v.sa.begin(), v.sa.end());
+            }
+            if (lcp) {
+                lcp->insert(lcp->end(), v.lcp.begin(), v.lcp.end());
+            }
+        }
+    }
+
+    // Appends a character to a text buffer, for the text dumps.
+    static void append_symbol(std::string *out, CharType c, std::true_type) {
+        out->push_back(static_cast<char>(c));
+    }
+
+    static void append_symbol(std::string *out, CharType c, std::false_type) {
+        std::ostringstream os;
+        os << c;
+        out->append(os.str());
+    }
+
+    static void append_symbol(std::string *out, CharType c) {
+        append_symbol(out, c, std::integral_constant<bool, sizeof(CharType) == 1 &&
+                                                       std::is_integral<CharType>::value>());
+    }
+
+    // Prints the tree in the historical `dump_tree` layout: one leaf per line,
+    // the first child of a node continuing its parent's line. The output is
+    // built in a buffer flushed by large chunks.
+    struct DumpVisitor : public TreeVisitor {
+        const SuffixTree *owner;
+        BufferedWriter *out;
+        std::string buffer;
+        explicit DumpVisitor(const SuffixTree *t, BufferedWriter *w) :
+          owner(t),
+          out(w)
+          {}
+        bool pre(NodeInfo const & n) {
+            if (nullptr == n.parent) {
+                if (0 == n.children) {
+                    out->write("##\n");
+                }
+                return true;
+            }
+            if (0 != n.rank) {
+                index_type column = (n.string_depth - n.edge_length) + (n.node_depth - 1);
+                buffer.append(2 * column, ' ');
+            }
+            const auto& s = owner->haystack.find(n.ref_str)->second;
+            for (index_type i = 0; i < n.edge_length; ++i) {
+                append_symbol(&buffer, s[n.edge_l + i]);
+                buffer.push_back(' ');
+            }
+            buffer.append("- ");
+            if (n.is_leaf()) {
+                buffer.append("##\n");
+            }
+            out->write(buffer);
+            buffer.clear();
+            return true;
+        }
+    };
+
+    // Counts the suffixes below a node.
+    struct CountVisitor : public TreeVisitor {
+        std::size_t count;
+        CountVisitor() : count(0) {}
+        bool pre(NodeInfo const & n) {
+            if (n.is_leaf()) {
+                count += n.suffixes->size();
+            }
+            return true;
+        }
+    };
+
+    // Collects the indexed offsets of each string, by string id
+    struct PositionVisitor : public TreeVisitor {
+        std::vector<std::vector<index_type>> positions;
+        bool pre(NodeInfo const & n) {
+            if (n.is_leaf()) {
+                for (auto const & suffix : *n.suffixes) {
+                    if (positions.size() <= static_cast<std::size_t>(suffix.ref_str)) {
+                        positions.resize(suffix.ref_str + 1);
+                    }
+                    positions[suffix.ref_str].push_back(suffix.offset);
+                }
+            }
+            return true;
+        }
+    };
+
+    // Accumulates the shape of the nodes it is shown into a TreeStats
+    struct ShapeVisitor : public TreeVisitor {
+        TreeStats stats;
+        bool pre(NodeInfo const & n) {
+            TreeStats::count(&stats.string_depth, TreeStats::bucket(n.string_depth));
+            TreeStats::count(&stats.node_depth, TreeStats::bucket(n.node_depth));
+            stats.max_string_depth = std::max(stats.max_string_depth, n.string_depth);
+            stats.max_node_depth = std::max(stats.max_node_depth, n.node_depth);
+            if (nullptr != n.parent) {
+                TreeStats::count(&stats.edge_length, TreeStats::bucket(n.edge_length));
+                stats.total_edge_length += n.edge_length;
+            }
+            if (n.is_leaf()) {
+                ++stats.leaves;
+                stats.suffixes += n.suffixes->size();
+                return true;
+            }
+            ++stats.internal_nodes;
+            TreeStats::count(&stats.branching, n.children);
+            if (nullptr != n.parent) {
+                if (nullptr != n.suffix_link) {
+                    ++stats.suffix_links;
+                    TreeStats::count(&stats.suffix_link_chain, TreeStats::bucket(n.string_depth));
+                } else {
+                    ++stats.missing_suffix_links;
+                }
+            }
+            return true;
+        }
+    };
+
+    // Finds the longest substring shared by at least `min_strings` strings.
+    // The number of strings below a node is counted as in Hui's color set
+    // size algorithm ("Color set size problem with applications to string
+    // matching", 1992): every suffix counts one for its leaf, and for each
+    // suffix of a string met before in the traversal, the lowest common
+    // ancestor of the two leaves counts one less. That ancestor is on the
+    // current path: the deepest node entered before the earlier leaf, found
+    // by binary search on the entry times of the path. O(n log depth) time,
+    // O(depth + number of strings) memory. A leaf holding suffixes of
+    // several strings is a candidate too: its label minus the end token is
+    // common to all of them.
+    struct CommonSubstringVisitor : public TreeVisitor {
+        std::size_t min_strings;
+        std::uint64_t clock;
+        // Entry time, string count and first suffix of each node of the path
+        std::vector<std::uint64_t> entered;
+        std::vector<std::int64_t> distinct;
+        std::vector<SuffixEntry> first;
+        // Entry time of the leaf of the last suffix of each string (id - 1),
+        // 0 for none
+        std::vector<std::uint64_t> last_seen;
+        SubstringEntry best;
+        CommonSubstringVisitor(std::size_t n_strings, std::size_t min_str) :
+          min_strings(min_str),
+          clock(0),
+          last_seen(n_strings, 0)
+          {}
+        bool pre(NodeInfo const & n) {
+            std::size_t level = n.node_depth;
+            if (first.size() <= level) {
+                entered.resize(level + 1);
+                distinct.resize(level + 1);
+                first.resize(level + 1);
+            }
+            entered[level] = ++clock;
+            distinct[level] = 0;
+            first[level] = SuffixEntry();
+            return true;
+        }
+        void post(NodeInfo const & n) {
+            std::size_t level = n.node_depth;
+            index_type length = n.string_depth;
+            if (n.is_leaf()) {
+                for (auto const & suffix : *n.suffixes) {
+                    std::uint64_t & seen = last_seen[suffix.ref_str - 1];
+                    ++distinct[level];
+                    if (0 != seen) {
+                        std::size_t lca = std::upper_bound(entered.begin(), entered.begin() + level + 1, seen) -
+                                          entered.begin() - 1;
+                        --distinct[lca];
+                    }
+                    seen = entered[level];
+                }
+                first[level] = n.suffixes->front();
+                if (!n.truncated) {
+                    length -= 1;
+                }
+            }
+            if (distinct[level] >= static_cast<std::int64_t>(min_strings) && length > best.length) {
+                best = SubstringEntry(first[level], length);
+            }
+            if (0 != level) {
+                distinct[level - 1] += distinct[level];
+                if (0 == first[level - 1].ref_str) {
+                    first[level - 1] = first[level];
+                }
+            }
+        }
+    };
+
+    // Lists the right-maximal repeats in pre-order: the internal nodes, and
+    // the leaves shared by several suffixes when their label is more than the
+    // end token (otherwise the parent already stands for the same string).
+    // Counts and first occurrences are filled in post-order.
+    struct RepeatVisitor : public TreeVisitor {
+        index_type min_length;
+        std::vector<Repeat> repeats;
+        std::vector<std::size_t> slot;
+        std::vector<std::size_t> count;
+        std::vector<SuffixEntry> first;
+        explicit RepeatVisitor(index_type min_len) : min_length(std::max<index_type>(min_len, 1)) {}
+        bool pre(NodeInfo const & n) {
+            std::size_t level = n.node_depth;
+            if (slot.size() <= level) {
+                slot.resize(level + 1);
+                count.resize(level + 1);
+                first.resize(level + 1);
+            }
+            slot[level] = repeats.size();
+            count[level] = 0;
+            first[level] = SuffixEntry();
+            if (n.is_leaf()) {
+                index_type length = n.truncated ? n.string_depth : n.string_depth - 1;
+                if (n.suffixes->size() > 1 && (n.truncated || n.edge_length > 1) && length >= min_length) {
+                    repeats.push_back(Repeat{n.suffixes->front(), length, n.suffixes->size()});
+                }
+            } else if (nullptr != n.parent && n.string_depth >= min_length) {
+                repeats.push_back(Repeat{SuffixEntry(), n.string_depth, 0});
+            }
+            return true;
+        }
+        void post(NodeInfo const & n) {
+            std::size_t level = n.node_depth;
+            if (n.is_leaf()) {
+                count[level] = n.suffixes->size();
+                first[level] = n.suffixes->front();
+            } else if (slot[level] < repeats.size() && 0 == repeats[slot[level]].count) {
+                repeats[slot[level]].count = count[level];
+                repeats[slot[level]].first = first[level];
+            }
+            if (0 != level) {
+                count[level - 1] += count[level];
+                if (0 == first[level - 1].ref_str) {
+                    first[level - 1] = first[level];
+                }
+            }
+        }
+    };
+
+    // find_locus - Find the locus of a string
+    // @p[in]: The string to look for
+    // @f[out]: The frame of the highest node whose path starts with @p. When
+    //          @p ends in the middle of an edge, this is the node below.
+    //
+    // Returns false if @p is not a substring of the haystack.
+    bool find_locus(const string& p, VisitFrame *f) const {
+        VisitFrame cur {tree.root(), nullptr, Transition(), 0, 0, 0, false};
+        index_type k = 0;
+        index_type p_len = p.size();
+        while (k < p_len) {
+            auto it = cur.node->g.find(p[k]);
+            if (cur.node->g.end() == it) {
+                return false;
+            }
+            Transition const & t = it->second;
+            index_type len = edge_length(t);
+            const string& ref = haystack.find(t.sub.ref_str)->second;
+            for (index_type i = 1; i < len && k + i < p_len; ++i) {
+                if (p[k + i] != ref[t.sub.l + i]) {
+                    return false;
+                }
+            }
+            cur = VisitFrame{t.tgt, cur.node, t, cur.depth + len, cur.node_depth + 1, 0, false};
+            k += len;
+        }
+        *f = cur;
+        return true;
+    }
+
+    // edge_label - Printable label of the edge leading to a node
+    // Characters of multi-byte alphabets are printed as numbers separated by
+    // spaces. Labels longer than @max_len are truncated with "...".
+    void edge_label(NodeInfo const & n, index_type max_len, std::string *out) const {
+        static const bool byte_symbols = sizeof(CharType) == 1 && std::is_integral<CharType>::value;
+        out->clear();
+        if (nullptr == n.parent) {
+            return;
+        }
+        const string& s = haystack.find(n.ref_str)->second;
+        index_type len = std::min(n.edge_length, max_len);
+        for (index_type i = 0; i < len; ++i) {
+            if (!byte_symbols && 0 != i) {
+                out->push_back(' ');
+            }
+            append_symbol(out, s[n.edge_l + i]);
+        }
+        if (len < n.edge_length) {
+            out->append("...");
+        }
+    }
+
+    // Writes a string between double quotes, escaped for DOT or JSON.
+    static void write_quoted(BufferedWriter *out, std::string const & text, bool json) {
+        static const char hex[] = "0123456789abcdef";
+        out->put('"');
+        for (char c : text) {
+            unsigned char u = static_cast<unsigned char>(c);
+            if ('"' == c || '\\' == c) {
+                out->put('\\');
+                out->put(c);
+            } else if (u < 0x20 && json) {
+                char esc[6] = {'\\', 'u', '0', '0', hex[u >> 4], hex[u & 0xf]};
+                out->write(esc, sizeof(esc));
+            } else if (u < 0x20) {
+                out->put(' ');
+            } else {
+                out->put(c);
+            }
+        }
+        out->put('"');
+    }
+
+    // Streams the nodes of a (sub)tree in one of the export formats. Node ids
+    // are given in pre-order, the exported root being node 0; the ids of the
+    // current path are kept on a stack to find the parents.
+    struct ExportVisitor : public TreeVisitor {
+        const SuffixTree *owner;
+        BufferedWriter *out;
+        ExportFormat format;
+        ExportOptions const & opts;
+        index_type base_depth;
+        std::vector<std::uint64_t> path;
+        std::uint64_t next_id;
+        std::string label;
+        ExportVisitor(const SuffixTree *t, BufferedWriter *w, ExportFormat f,
+                      ExportOptions const & o, index_type depth) :
+          owner(t),
+          out(w),
+          format(f),
+          opts(o),
+          base_depth(depth),
+          next_id(0)
+          {}
+        bool pre(NodeInfo const & n) {
+            std::uint64_t id = next_id++;
+            switch (format) {
+            case ExportFormat::dot:
+                write_dot(n, id);
+                break;
+            case ExportFormat::json:
+                write_json(n, id);
+                break;
+            case ExportFormat::edge_list:
+                write_edge_list(n, id);
+                break;
+            }
+            path.push_back(id);
+            return (n.node_depth - base_depth < opts.max_depth);
+        }
+        void post(NodeInfo const &) {
+            path.pop_back();
+        }
+        void write_dot(NodeInfo const & n, std::uint64_t id) {
+            out->write("  n");
+            out->write_decimal(id);
+            if (path.empty()) {
+                out->write(" [shape=doublecircle];\n");
+                return;
+            }
+            if (n.is_leaf()) {
+                out->write(" [shape=box, label=\"");
+                bool first = true;
+                for (auto const & suffix : *n.suffixes) {
+                    if (!first) {
+                        out->put(' ');
+                    }
+                    out->write_decimal(suffix.ref_str);
+                    out->put(':');
+                    out->write_decimal(suffix.offset);
+                    first = false;
+                }
+                out->write("\"];\n  n");
+            } else {
+                out->write(";\n  n");
+            }
+            out->write_decimal(path.back());
+            out->write(" -> n");
+            out->write_decimal(id);
+            out->write(" [label=");
+            owner->edge_label(n, opts.max_label_length, &label);
+            write_quoted(out, label, false);
+            out->write("];\n");
+        }
+        void write_json(NodeInfo const & n, std::uint64_t id) {
+            if (path.empty()) {
+                out->write("\n{\"id\":");
+            } else {
+                out->write(",\n{\"id\":");
+            }
+            out->write_decimal(id);
+            if (path.empty()) {
+                out->write(",\"parent\":null");
+            } else {
+                out->write(",\"parent\":");
+                out->write_decimal(path.back());
+                out->write(",\"label\":");
+                owner->edge_label(n, opts.max_label_length, &label);
+                write_quoted(out, label, true);
+            }
+            out->write(",\"depth\":");
+            out->write_decimal(n.string_depth);
+            if (n.is_leaf()) {
+                out->write(",\"suffixes\":[");
+                bool first = true;
+                for (auto const & suffix : *n.suffixes) {
+                    if (!first) {
+                        out->put(',');
+                    }
+                    out->put('[');
+                    out->write_decimal(suffix.ref_str);
+                    out->put(',');
+                    out->write_decimal(suffix.offset);
+                    out->put(']');
+                    first = false;
+                }
+                out->put(']');
+            }
+            out->put('}');
+        }
+        void write_edge_list(NodeInfo const & n, std::uint64_t id) {
+            bool root = path.empty();
+            out->write_varint(root ? 0 : id - path.back());
+            out->write_varint(root ? 0 : n.ref_str);
+            out->write_varint(root ? 0 : n.edge_l);
+            out->write_varint(root ? 0 : n.edge_length);
+            if (!n.is_leaf()) {
+                out->write_varint(0);
+                return;
+            }
+            out->write_varint(n.suffixes->size());
+            for (auto const & suffix : *n.suffixes) {
+                out->write_varint(suffix.ref_str);
+                out->write_varint(suffix.offset);
+            }
+        }
+    };
+public:
+    // LexicographicIterator - Walk the suffixes of a subtree in lexicographic
+    // order
+    //
+    // This is an iterative DFS over an explicit stack. The children of a node
+    // are sorted in a scratch buffer reused from one node to the next, so the
+    // only allocations are the amortized growth of those two vectors.
+    //
+    // Along with each suffix, `next` reports the length of its longest common
+    // prefix with the previous one (0 for the first suffix). End tokens never
+    // count in that length, as if each string had its own.
+    class LexicographicIterator {
+        friend class SuffixTree;
+
+        struct Frame {
+            Node *node;
+            index_type depth;
+            index_type lcp;
+            bool cut;
+        };
+
+        const SuffixTree *owner;
+        alloc_vector<Frame> stack;
+        ChildBuffer children;
+        Leaf *leaf;
+        std::size_t leaf_pos;
+        index_type leaf_depth;
+        index_type leaf_lcp;
+        bool leaf_cut;
+
+        LexicographicIterator(const SuffixTree *t, Node *start, index_type depth, bool cut = false) :
+          owner(t),
+          leaf(nullptr),
+          leaf_pos(0),
+          leaf_depth(0),
+          leaf_lcp(0),
+          leaf_cut(false) {
+            stack.push_back(Frame{start, depth, 0, cut});
+        }
+    public:
+        // next - Fetch the next suffix
+        // @suffix[out]: The next suffix in lexicographic order
+        // @lcp[out]: Its LCP with the previous suffix (optional)
+        // @budget[in,out]: Nodes that may still be visited (optional)
+        //
+        // Returns false once the subtree is exhausted, or when the budget
+        // runs out first: a later call resumes the walk (see `exhausted`).
+        bool next(SuffixEntry *suffix, index_type *lcp = nullptr, std::size_t *budget = nullptr) {
+            while (nullptr == leaf || leaf_pos >= leaf->suffixes.size()) {
+                if (stack.empty() || (budget && 0 == *budget)) {
+                    return false;
+                }
+                if (budget) {
+                    --*budget;
+                }
+                Frame f = stack.back();
+                stack.pop_back();
+                leaf = f.node->as_leaf();
+                if (nullptr != leaf) {
+                    leaf_pos = 0;
+                    leaf_depth = f.depth;
+                    leaf_lcp = f.lcp;
+                    leaf_cut = f.cut;
+                    continue;
+                }
+                // Pushed in decreasing order so that the smallest child is
+                // popped first. Only that one inherits the LCP of its parent,
+                // its siblings branch off at the parent's depth.
+                children.assign(f.node->g.begin(), f.node->g.end());
+                std::sort(children.begin(), children.end(),
+                    [](std::pair<CharType, Transition> const & a, std::pair<CharType, Transition> const & b) {
+                        return symbol_less(b.first, a.first);
+                    });
+                for (std::size_t i = 0; i < children.size(); ++i) {
+                    Transition const & t = children[i].second;
+                    bool first = (i + 1 == children.size());
+                    stack.push_back(Frame{t.tgt, f.depth + owner->edge_length(t),
+                                          first ? f.lcp : f.depth, is_cut(t)});
+                }
+            }
+            *suffix = leaf->suffixes[leaf_pos];
+            if (lcp) {
+                // Suffixes sharing a leaf are equal up to the end token, or
+                // up to the maximum depth for a cut leaf
+                *lcp = (0 == leaf_pos) ? leaf_lcp : (leaf_cut ? leaf_depth : leaf_depth - 1);
+            }
+            ++leaf_pos;
+            return true;
+        }
+
+        // exhausted - Whether every suffix has been fetched
+        bool exhausted() const {
+            return stack.empty() && (nullptr == leaf || leaf_pos >= leaf->suffixes.size());
+        }
+    };
+
+    // OccurrenceCursor - Resumable enumeration of the occurrences of a
+    // string, in the order of find_all
+    //
+    // Nothing is collected up front: each `next` walks the subtree of the
+    // string's locus just far enough for one more occurrence (or checks the
+    // suffixes of the cut leaf for strings longer than the maximum depth of a
+    // truncated tree). With a budget, a call stops after that many nodes or
+    // checked suffixes, so a caller can interleave a long enumeration with
+    // other work, or drop the cursor once it has seen enough. The tree must
+    // not be modified while a cursor is in use.
+    class OccurrenceCursor {
+        friend class SuffixTree;
+
+        const SuffixTree *owner;
+        LexicographicIterator it;
+        // Truncated trees: the pattern, and the cut leaf whose suffixes are
+        // checked against it
+        string pattern;
+        Leaf *candidates;
+        std::size_t candidate;
+
+        OccurrenceCursor(const SuffixTree *t, Node *locus, index_type depth) :
+          owner(t),
+          it(t, locus ? locus : t->tree.root(), depth),
+          candidates(nullptr),
+          candidate(0) {
+            if (!locus) {
+                it.stack.clear();
+            }
+        }
+    public:
+        // next - Fetch the next occurrence
+        // @suffix[out]: The occurrence
+        // @budget[in,out]: Nodes (or suffixes) that may still be visited
+        //                  (optional)
+        //
+        // Returns false once all the occurrences have been fetched, or when
+        // the budget runs out first (see `exhausted`).
+        bool next(SuffixEntry *suffix, std::size_t *budget = nullptr) {
+            if (!candidates) {
+                return it.next(suffix, nullptr, budget);
+            }
+            index_type depth = owner->depth_limit;
+            while (candidate < candidates->suffixes.size()) {
+                if (budget && 0 == *budget) {
+                    return false;
+                }
+                if (budget) {
+                    --*budget;
+                }
+                SuffixEntry const & e = candidates->suffixes[candidate++];
+                const string& s = owner->haystack.find(e.ref_str)->second;
+                if (static_cast<index_type>(s.size()) - e.offset >= static_cast<index_type>(pattern.size()) &&
+                    std::equal(pattern.begin() + depth, pattern.end(), s.begin() + e.offset + depth)) {
+                    *suffix = e;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // exhausted - Whether every occurrence has been fetched
+        bool exhausted() const {
+            return candidates ? candidate >= candidates->suffixes.size() : it.exhausted();
+        }
+    };
+
+    SuffixTree() : SuffixTree(Allocator()) {}
+
+    // A tree whose nodes, transitions, suffix lists and text are allocated
+    // with copies of @alloc (with a ResourceAllocator: from its resource,
+    // which must outlive the tree). The temporary buffers of the queries use
+    // default-constructed allocators (default_resource()), so that queries
+    // can run concurrently whatever the tree's resource.
+    explicit SuffixTree(Allocator const & alloc) :
+      tree(alloc),
+      haystack(make_map<alloc_map<int, string>>(alloc)),
+      borderpath_map(make_map<alloc_map<int, Node*>>(alloc)),
+      last_index(0),
+      mode(BuildMode::empty),
+      metrics(nullptr),
+      tracer(nullptr),
+      depth_limit(std::numeric_limits<index_type>::max()),
+      kgram_leaves(0, std::hash<std::uint64_t>(), std::equal_to<std::uint64_t>(), alloc),
+      powers(alloc) {
+    }
+
+    // Depth-truncated tree: only the first @max_depth characters of the
+    // suffixes are distinguished
+    //
+    // Every suffix is stored, in the leaf of its first K = @max_depth
+    // characters (or of the whole suffix when shorter): leaves hold the
+    // occurrence lists of the K-grams. The number of nodes is linear in the
+    // number of distinct K-grams instead of the text length, and an
+    // `add_string` costs O(n) hashing plus a top-down insertion per new
+    // K-gram.
+    //
+    // Queries of at most K characters are answered by the tree alone, longer
+    // ones check the occurrences of their first K characters against the
+    // text. Suffixes sharing a K-gram are listed by string id and offset, not
+    // in lexicographic order (find_all, suffix array export), and the LCP
+    // export reports K between them.
+    explicit SuffixTree(index_type max_depth, Allocator const & alloc = Allocator()) :
+      SuffixTree(alloc) {
+        truncate(max_depth);
+    }
+
+    // Moving a tree takes O(1) whatever its size: the nodes stay where they
+    // are, along with the allocator. The moved-from tree is left empty (and
+    // no longer truncated); cursors and iterators over it are invalidated.
+    SuffixTree(SuffixTree&& other) noexcept(nothrow_move_construct) :
+      tree(std::move(other.tree)),
+      haystack(std::move(other.haystack)),
+      borderpath_map(std::move(other.borderpath_map)),
+      last_index(other.last_index),
+      mode(other.mode),
+      metrics(other.metrics),
+      tracer(other.tracer),
+      depth_limit(other.depth_limit),
+      kgram_leaves(std::move(other.kgram_leaves)),
+      powers(std::move(other.powers)),
+      footprint(other.footprint) {
+        other.forget();
+    }
+
+    // Move assignment follows the allocator, as the standard containers do:
+    // when it propagates on move assignment, or both allocators are equal,
+    // the tree frees its nodes and takes those of @other in O(1); otherwise
+    // nodes cannot change allocator, and the tree is rebuilt with its own
+    // from the strings of @other, in the time of the construction (left
+    // unchanged if that throws). @other is left empty.
+    SuffixTree& operator=(SuffixTree&& other) noexcept(nothrow_move_assign) {
+        if (this == &other) {
+            return *this;
+        }
+        if (!propagate_on_move::value && !(tree.alloc == other.tree.alloc)) {
+            SuffixTree copy(tree.alloc);
+            copy.rebuild(other);
+            other.tree.release();
+            other.forget();
+            take(copy);
+        } else {
+            take(other);
+        }
+        return *this;
+    }
+
+private:
+    // take - Free the nodes of the tree and take those of @other, whose
+    // allocator propagates or equals the tree's
+    void take(SuffixTree& other) noexcept(nothrow_move_assign) {
+        tree.release();
+        assign_allocator(other, propagate_on_move());
+        tree.roots = other.tree.roots;
+        other.tree.roots = Base::empty_roots();
+        haystack = std::move(other.haystack);
+        borderpath_map = std::move(other.borderpath_map);
+        last_index = other.last_index;
+        mode = other.mode;
+        metrics = other.metrics;
+        tracer = other.tracer;
+        depth_limit = other.depth_limit;
+        kgram_leaves = std::move(other.kgram_leaves);
+        powers = std::move(other.powers);
+        footprint = other.footprint;
+        other.forget();
+    }
+
+    void assign_allocator(SuffixTree& other, std::true_type) noexcept {
+        tree.alloc = other.tree.alloc;
+    }
+
+    void assign_allocator(SuffixTree&, std::false_type) noexcept {}
+
+    // forget - Reset the members of a tree whose nodes were taken
+    void forget() noexcept {
+        haystack.clear();
+        borderpath_map.clear();
+        last_index = 0;
+        mode = BuildMode::empty;
+        depth_limit = std::numeric_limits<index_type>::max();
+        kgram_leaves.clear();
+        powers.clear();
+        footprint = Footprint();
+    }
+
+    // rebuild - Insert the strings of @other into the (empty) tree, in the
+    // mode, with the positions and under the ids they have there
+    void rebuild(SuffixTree const & other) {
+        metrics = other.metrics;
+        tracer = other.tracer;
+        if (BuildMode::truncated == other.mode) {
+            truncate(other.depth_limit);
+        }
+        std::vector<std::vector<index_type>> positions;
+        if (BuildMode::sparse == other.mode) {
+            PositionVisitor v;
+            other.traverse(v);
+            positions.swap(v.positions);
+            positions.resize(std::max<std::size_t>(positions.size(), other.last_index + 1));
+        }
+        for (int id : other.string_ids()) {
+            string const & s = other.haystack.find(id)->second;
+            if (BuildMode::sparse == other.mode) {
+                add_string_sparse(s.begin(), s.end() - 1, positions[id]);
+            } else {
+                add_string(s.begin(), s.end() - 1);
+            }
+        }
+    }
+
+public:
+    // Trees are not copied: a copy is as long as a rebuild, see save/load
+    SuffixTree(SuffixTree const &) = delete;
+    SuffixTree& operator=(SuffixTree const &) = delete;
+
+    template <typename InputIterator>
+    int add_string(InputIterator const & str_begin, InputIterator const & str_end) {
+        OperationTimer timer(metrics, Operation::add_string);
+        if (BuildMode::truncated == mode) {
+            const string& w = ingest(str_begin, str_end);
+            PhaseScope phase(tracer, BuildPhase::insertion, last_index);
+            insert_truncated(w, last_index);
+            return last_index;
+        }
+        set_mode(BuildMode::ukkonen);
+        const string& w = ingest(str_begin, str_end);
+        if (0 > deploy_suffixes(w, last_index)) {
+            drop_string(last_index--);
+            return -1;
+        }
+        return last_index;
+    }
+    
+    // add_string_sparse - Insert only some suffixes of a string
+    // @positions[in]: Offsets of the suffixes to index, in [0, length] (the
+    //                 length stands for the suffix made of the end token)
+    //
+    // Construction time and memory depend on the number of positions, not on
+    // the length of the string: each suffix is inserted top-down, in the time
+    // it takes to find where it branches off. A tree built this way is sparse:
+    // queries (is_substring, count, find_all, ...) only see occurrences
+    // starting at indexed positions, and suffix array exports only list
+    // those. Mixing with `add_string` throws std::logic_error.
+    //
+    // Returns the id of the string.
+    template <typename InputIterator>
+    int add_string_sparse(InputIterator const & str_begin, InputIterator const & str_end,
+                          std::vector<index_type> const & positions) {
+        OperationTimer timer(metrics, Operation::add_string);
+        set_mode(BuildMode::sparse);
+        const string& w = ingest(str_begin, str_end);
+        for (index_type p : positions) {
+            if (p < 0 || p >= static_cast<index_type>(w.size())) {
+                drop_string(last_index--);
+                throw std::out_of_range("Sparse position out of the string");
+            }
+        }
+        alloc_vector<index_type> sorted(positions.begin(), positions.end());
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        PhaseScope phase(tracer, BuildPhase::insertion, last_index);
+        for (index_type p : sorted) {
+            insert_suffix(w, last_index, p, w.size());
+        }
+        return last_index;
+    }
+
+    // add_string_sparse_if - Insert the suffixes of a string selected by a
+    // predicate
+    // @keep[in]: Called as keep(s, offset), with s the string (end token
+    //            included) and offset in [0, s.size()); the suffix is indexed
+    //            if it returns true
+    //
+    // The predicate is evaluated on every position, but only the kept
+    // suffixes cost tree construction.
+    template <typename InputIterator, typename Predicate>
+    int add_string_sparse_if(InputIterator const & str_begin, InputIterator const & str_end, Predicate keep) {
+        OperationTimer timer(metrics, Operation::add_string);
+        set_mode(BuildMode::sparse);
+        const string& w = ingest(str_begin, str_end);
+        PhaseScope phase(tracer, BuildPhase::insertion, last_index);
+        for (index_type p = 0; p < static_cast<index_type>(w.size()); ++p) {
+            if (keep(static_cast<string const &>(w), p)) {
+                insert_suffix(w, last_index, p, w.size());
+            }
+        }
+        return last_index;
+    }
+
+    // is_sparse - Whether the strings were added with add_string_sparse
+    bool is_sparse() const {
+        return BuildMode::sparse == mode;
+    }
+
+    // is_truncated - Whether the tree was built with a maximum depth
+    bool is_truncated() const {
+        return BuildMode::truncated == mode;
+    }
+
+    // max_depth - Maximum depth of a truncated tree, the max index value
+    // otherwise
+    index_type max_depth() const {
+        return depth_limit;
+    }
+
+    // suffix_less - Whether the suffix of @a at @a_offset comes before that
+    // of @b at @b_offset in find_all: lexicographic order of their first
+    // max_depth() symbols, end tokens included (the end token sorts first)
+    //
+    // Suffixes that compare equal are listed by string id, then offset.
+    bool suffix_less(string const & a, index_type a_offset, string const & b, index_type b_offset) const {
+        index_type n = std::min(static_cast<index_type>(a.size()) - a_offset, depth_limit);
+        index_type m = std::min(static_cast<index_type>(b.size()) - b_offset, depth_limit);
+        return std::lexicographical_compare(a.begin() + a_offset, a.begin() + a_offset + n,
+                                            b.begin() + b_offset, b.begin() + b_offset + m, &symbol_less);
+    }
+
+    // last_string_id - Id of the last string added (0 if none): the next
+    // one gets the following id
+    int last_string_id() const {
+        return last_index;
+    }
+
+    template <typename InputIterator>
+    bool is_suffix(InputIterator const & str_begin, InputIterator const & str_end) const {
+        auto s = make_string(str_begin, str_end);
+        if (beyond_depth_limit(s)) {
+            return !truncated_occurrences(s, 1).empty();
+        }
+        ReferencePoint root_point(tree.root(), -1, 0);
+        return (get_starting_node(s, &root_point) == std::numeric_limits<index_type>::max());
+    }
+    
+    template <typename InputIterator>
+    bool is_substring(InputIterator const & str_begin, InputIterator const & str_end) const {
+        OperationTimer timer(metrics, Operation::is_substring);
+        auto s = make_string<false>(str_begin, str_end);
+        if (beyond_depth_limit(s)) {
+            return !truncated_occurrences(s, 1).empty();
+        }
+        VisitFrame locus;
+        return find_locus(s, &locus);
+    }
+
+    // count - Number of occurrences of a string in the haystack
+    template <typename InputIterator>
+    std::size_t count(InputIterator const & str_begin, InputIterator const & str_end) const {
+        OperationTimer timer(metrics, Operation::count);
+        auto s = make_string<false>(str_begin, str_end);
+        if (beyond_depth_limit(s)) {
+            return truncated_occurrences(s, std::numeric_limits<std::size_t>::max()).size();
+        }
+        VisitFrame locus;
+        if (!find_locus(s, &locus)) {
+            return 0;
+        }
+        CountVisitor v;
+        traverse_from(v, locus, TraversalOptions());
+        return v.count;
+    }
+
+    // find_all - Occurrences of a string in the haystack
+    // The occurrences are returned in the lexicographic order of the suffixes
+    // starting with them.
+    template <typename InputIterator>
+    std::vector<SuffixEntry> find_all(InputIterator const & str_begin, InputIterator const & str_end) const {
+        OperationTimer timer(metrics, Operation::find_all);
+        auto s = make_string<false>(str_begin, str_end);
+        if (beyond_depth_limit(s)) {
+            return truncated_occurrences(s, std::numeric_limits<std::size_t>::max());
+        }
+        std::vector<SuffixEntry> result;
+        VisitFrame locus;
+        if (find_locus(s, &locus)) {
+            LexicographicIterator it(this, locus.node, locus.depth);
+            SuffixEntry suffix;
+            while (it.next(&suffix)) {
+                result.push_back(suffix);
+            }
+        }
+        return result;
+    }
+
+    // iterate_occurrences - Lazy find_all (see OccurrenceCursor)
+    template <typename InputIterator>
+    OccurrenceCursor iterate_occurrences(InputIterator const & str_begin, InputIterator const & str_end) const {
+        auto s = make_string<false>(str_begin, str_end);
+        VisitFrame locus;
+        if (beyond_depth_limit(s)) {
+            OccurrenceCursor cursor(this, nullptr, 0);
+            if (find_locus(string(s.begin(), s.begin() + depth_limit), &locus) && locus.node->as_leaf()) {
+                cursor.candidates = locus.node->as_leaf();
+                cursor.pattern.swap(s);
+            }
+            return cursor;
+        }
+        return find_locus(s, &locus) ? OccurrenceCursor(this, locus.node, locus.depth) :
+            OccurrenceCursor(this, nullptr, 0);
+    }
+
+    // longest_common_substring - Longest substring shared by several strings
+    // @min_strings[in]: How many strings must contain it (0: all of them)
+    //
+    // Among the longest ones, the lexicographically smallest is returned,
+    // located by its smallest occurrence. The length is 0 if there is none.
+    SubstringEntry longest_common_substring(std::size_t min_strings = 0) const {
+        if (0 == min_strings) {
+            min_strings = haystack.size();
+        }
+        CommonSubstringVisitor v(last_index, std::max<std::size_t>(min_strings, 1));
+        traverse(v, TraversalOptions(TraversalOrder::depth_first, true));
+        return v.best;
+    }
+
+    // repeats - Right-maximal repeats of the haystack
+    // @min_length[in]: Shortest repeat to report
+    //
+    // A repeat is reported once for each distinct string, in lexicographic
+    // order (a prefix before its extensions).
+    std::vector<Repeat> repeats(index_type min_length = 1) const {
+        RepeatVisitor v(min_length);
+        traverse(v, TraversalOptions(TraversalOrder::depth_first, true));
+        return v.repeats;
+    }
+
+    // string_ids - Ids of the strings in the haystack, in increasing order
+    std::vector<int> string_ids() const {
+        std::vector<int> ids;
+        ids.reserve(haystack.size());
+        for (auto const & it : haystack) {
+            ids.push_back(it.first);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    // get_string - A string of the haystack, end token included
+    string const & get_string(int id) const {
+        auto it = haystack.find(id);
+        if (haystack.end() == it) {
+            throw std::out_of_range("No string with this id");
+        }
+        return it->second;
+    }
+
+    ~SuffixTree() {
+    }
+
+    // set_metrics - Time add_string, is_substring, count and find_all into
+    // the histograms of @m (nullptr to stop)
+    //   @param[in] m Metrics, owned by the caller and outliving the tree
+    void set_metrics(QueryMetrics *m) {
+        metrics = m;
+    }
+
+    allocator_type get_allocator() const {
+        return tree.alloc;
+    }
+
+    QueryMetrics *get_metrics() const {
+        return metrics;
+    }
+
+    // set_tracer - Call @t around the phases of each add_string (nullptr to
+    // stop)
+    //   @param[in] t Tracer, owned by the caller and outliving the tree
+    void set_tracer(BuildTracer *t) {
+        tracer = t;
+    }
+
+    BuildTracer *get_tracer() const {
+        return tracer;
+    }
+
+    // memory_usage - Bytes held by the tree, by component
+    //
+    // Computed in O(1) from counters kept by the insertions, so it can be
+    // polled while the tree grows. Hash table entries are counted as one
+    // heap node each (the element and a next pointer), and the allocator's
+    // own overhead is left out: the figures are close to, not exactly, the
+    // heap usage.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        m.tree = sizeof(*this) + (tree.owns_roots() ? sizeof(Roots) : 0);
+        m.nodes = footprint.nodes * (sizeof(Node) - sizeof(Node*));
+        m.leaves = footprint.leaves * (sizeof(Leaf) - sizeof(Node*));
+        m.suffix_lists = footprint.suffix_capacity * sizeof(SuffixEntry);
+        m.transitions = footprint.transitions * hash_node_size<std::pair<const CharType, Transition>>() +
+            footprint.buckets * sizeof(void*);
+        m.suffix_links = (footprint.nodes + footprint.leaves) * sizeof(Node*);
+        m.suffix_link_count = footprint.suffix_links;
+        m.text = footprint.text_capacity * sizeof(CharType);
+        m.haystack = haystack.size() * hash_node_size<std::pair<const int, string>>() +
+            haystack.bucket_count() * sizeof(void*);
+        m.borderpath_map = borderpath_map.size() * hash_node_size<std::pair<const int, Node*>>() +
+            borderpath_map.bucket_count() * sizeof(void*);
+        m.kgram_index = kgram_leaves.size() * hash_node_size<std::pair<const std::uint64_t, Leaf*>>() +
+            kgram_leaves.bucket_count() * sizeof(void*) + powers.capacity() * sizeof(std::uint64_t);
+        m.allocations = footprint.allocations;
+        m.input_characters = footprint.characters;
+        return m;
+    }
+
+    // tree_stats - Shape of the tree: node counts, branching, depth and edge
+    // length histograms, suffix links, and estimates for capacity planning
+    //
+    // The top of the tree is split breadth-first until there are 16 subtrees
+    // per hardware thread (a DNA tree has only five root subtrees), then the
+    // subtrees are walked concurrently, each with its own counters, merged at
+    // the end. The memory estimates come from memory_usage().
+    TreeStats tree_stats() const {
+        typedef std::pair<CharType, Transition> Element;
+        ShapeVisitor top;
+        std::size_t wanted = 16 * std::max(1u, std::thread::hardware_concurrency());
+        FrameStack frontier {VisitFrame{tree.root(), nullptr, Transition(), 0, 0, 0, false}};
+        FrameStack next;
+        ChildBuffer scratch;
+        for (bool split = true; split && frontier.size() < wanted;) {
+            split = false;
+            next.clear();
+            for (auto const & f : frontier) {
+                if (f.node->as_leaf()) {
+                    next.push_back(f);
+                    continue;
+                }
+                top.pre(node_info(f));
+                push_children(&next, f, false, false, &scratch);
+                split = true;
+            }
+            frontier.swap(next);
+        }
+        std::vector<ShapeVisitor> visitors(frontier.size());
+        walk_subtrees(&visitors, frontier, TraversalOptions());
+        TreeStats stats = top.stats;
+        for (auto const & v : visitors) {
+            stats.merge(v.stats);
+        }
+
+        stats.alphabet = std::max(tree.root()->g.size(), stats.branching.size() - 1);
+        MemoryUsage m = memory_usage();
+        std::size_t nodes = stats.internal_nodes + stats.leaves;
+        stats.transition_bytes[int(TransitionContainer::hash_map)] =
+            m.transitions + nodes * sizeof(TransitionMap);
+        stats.transition_bytes[int(TransitionContainer::sorted_vector)] =
+            stats.edges() * sizeof(Element) + nodes * sizeof(std::vector<Element>);
+        stats.transition_bytes[int(TransitionContainer::direct_array)] =
+            stats.internal_nodes * stats.alphabet * sizeof(Transition) + nodes * sizeof(Transition*);
+        // Every component but the tree object grows linearly with the input
+        stats.next_doubling_bytes = m.tree + 2 * (m.total() - m.tree);
+        return stats;
+    }
+
+    // iterate_lexicographic - Iterator over all the suffixes of the haystack
+    LexicographicIterator iterate_lexicographic() const {
+        return LexicographicIterator(this, tree.root(), 0);
+    }
+
+    // export_suffix_array - Generalized suffix array of the haystack
+    // @parallel[in]: Walk the root subtrees concurrently
+    //
+    // Every suffix of every string (end token included) appears once as a
+    // (string id, offset) pair, or only the indexed ones in a sparse tree.
+    // Equal suffixes of different strings are ordered by string id.
+    std::vector<SuffixEntry> export_suffix_array(bool parallel = false) const {
+        std::vector<SuffixEntry> sa;
+        export_suffixes(&sa, nullptr, parallel);
+        return sa;
+    }
+
+    // export_lcp - LCP array matching `export_suffix_array`
+    // lcp[i] is the longest common prefix of the suffixes i-1 and i, and
+    // lcp[0] is 0.
+    std::vector<index_type> export_lcp(bool parallel = false) const {
+        std::vector<index_type> lcp;
+        export_suffixes(nullptr, &lcp, parallel);
+        return lcp;
+    }
+
+    // traverse - Walk the whole tree with a visitor
+    // @v[in/out]: The visitor (see TreeVisitor)
+    // @opts[in]: Depth-first or breadth-first, ordered or not
+    //
+    // In breadth-first order, `post` immediately follows `pre`.
+    template <typename Visitor>
+    void traverse(Visitor& v, TraversalOptions const & opts = TraversalOptions()) const {
+        VisitFrame root {tree.root(), nullptr, Transition(), 0, 0, 0, false};
+        traverse_from(v, root, opts);
+    }
+
+    // traverse_parallel - Walk the root subtrees concurrently
+    // @make_visitor[in]: Returns a fresh visitor, called once per root subtree
+    // @opts[in]: Traversal options used within each subtree
+    //
+    // Each root subtree is walked by its own visitor, on a pool of at most
+    // `hardware_concurrency` threads. The visitors are returned in the order
+    // of the subtrees (lexicographic order if `opts.ordered` is set) for the
+    // caller to merge. The root itself is not visited.
+    template <typename VisitorFactory>
+    auto traverse_parallel(VisitorFactory make_visitor, TraversalOptions const & opts = TraversalOptions()) const
+        -> std::vector<decltype(make_visitor())> {
+        typedef decltype(make_visitor()) Visitor;
+        VisitFrame root {tree.root(), nullptr, Transition(), 0, 0, 0, false};
+        FrameStack subtrees;
+        ChildBuffer scratch;
+        push_children(&subtrees, root, opts.ordered, false, &scratch);
+        std::vector<Visitor> visitors;
+        visitors.reserve(subtrees.size());
+        for (std::size_t i = 0; i < subtrees.size(); ++i) {
+            visitors.push_back(make_visitor());
+        }
+        walk_subtrees(&visitors, subtrees, opts);
+        return visitors;
+    }
+
+    // dump_tree - Print the tree, children in lexicographic order
+    void dump_tree(std::ostream& out = std::cout) const {
+        BufferedWriter writer(out);
+        DumpVisitor v(this, &writer);
+        traverse(v, TraversalOptions(TraversalOrder::depth_first, true));
+        writer.flush();
+    }
+
+    // export_tree - Write the tree, or a subtree, in an exchange format
+    // @out[in]: Where to write
+    // @format[in]: DOT, JSON or binary edge list
+    // @opts[in]: Depth limit, subtree selection, label truncation
+    //
+    // Nodes are numbered in lexicographic pre-order, the exported root being
+    // node 0. The binary edge list is made of LEB128 varints:
+    //   - "STEL", version (1), sizeof(CharType), as raw bytes
+    //   - the number of strings, then for each: id, length and the raw
+    //     characters (end token included)
+    //   - one record per node in pre-order: (id - parent id) (0 for the
+    //     root), ref_str, edge_l, edge_length, number of suffixes, then
+    //     (ref_str, offset) for each suffix
+    //
+    // Returns false (and writes nothing) if the subtree string does not occur.
+    bool export_tree(BufferedWriter& out, ExportFormat format,
+                     ExportOptions const & opts = ExportOptions()) const {
+        VisitFrame start {tree.root(), nullptr, Transition(), 0, 0, 0, false};
+        if (!opts.subtree.empty() && !find_locus(opts.subtree, &start)) {
+            return false;
+        }
+        switch (format) {
+        case ExportFormat::dot:
+            out.write("digraph suffix_tree {\n  node [shape=circle, label=\"\"];\n");
+            break;
+        case ExportFormat::json:
+            out.write("{\"nodes\":[");
+            break;
+        case ExportFormat::edge_list:
+            out.write("STEL");
+            out.put(1);
+            out.put(static_cast<char>(sizeof(CharType)));
+            out.write_varint(haystack.size());
+            for (auto const & it : haystack) {
+                out.write_varint(it.first);
+                out.write_varint(it.second.size());
+                out.write(reinterpret_cast<const char*>(it.second.data()), it.second.size() * sizeof(CharType));
+            }
+            break;
+        }
+        ExportVisitor v(this, &out, format, opts, start.node_depth);
+        traverse_from(v, start, TraversalOptions(TraversalOrder::depth_first, true));
+        if (ExportFormat::dot == format) {
+            out.write("}\n");
+        } else if (ExportFormat::json == format) {
+            out.write("\n]}\n");
+        }
+        out.flush();
+        return true;
+    }
+
+    // export_tree - Write the tree to a file, see above
+    bool export_tree(std::string const & path, ExportFormat format,
+                     ExportOptions const & opts = ExportOptions()) const {
+        std::unique_ptr<std::FILE, int(*)(std::FILE*)> f(std::fopen(path.c_str(), "wb"), &std::fclose);
+        if (!f) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        BufferedWriter writer(f.get());
+        return export_tree(writer, format, opts);
+    }
+
+    // save - Write the tree in a compact binary form, read back by `load`
+    // @out[in]: Where to write
+    //
+    // What is saved is what the tree was built from: the strings with their
+    // ids, the insertion mode, the maximum depth of a truncated tree and the
+    // indexed positions of a sparse one. Loading inserts them again, in the
+    // time the construction took: it is a rebuild, not a node image. The
+    // format, in LEB128 varints:
+    //   - "STRE", version (1), sizeof(CharType) and the end token, as raw
+    //     bytes
+    //   - the mode (0 empty, 1 Ukkonen, 2 sparse, 3 truncated), the maximum
+    //     depth (0 unless truncated) and the number of strings
+    //   - for each string, by increasing id: id, length and the raw characters
+    //     (end token excluded); for a sparse tree, the number of positions and
+    //     their increasing values, delta-coded
+    void save(BufferedWriter& out) const {
+        out.write("STRE");
+        out.put(1);
+        out.put(static_cast<char>(sizeof(CharType)));
+        out.write_raw(end_token);
+        out.write_varint(static_cast<std::uint64_t>(mode));
+        out.write_varint(BuildMode::truncated == mode ? depth_limit : 0);
+        std::vector<std::vector<index_type>> positions;
+        if (BuildMode::sparse == mode) {
+            PositionVisitor v;
+            traverse(v);
+            positions.swap(v.positions);
+            positions.resize(std::max<std::size_t>(positions.size(), last_index + 1));
+        }
+        std::vector<int> ids = string_ids();
+        out.write_varint(ids.size());
+        for (int id : ids) {
+            string const & s = haystack.find(id)->second;
+            out.write_varint(id);
+            out.write_varint(s.size() - 1);
+            out.write(reinterpret_cast<const char*>(s.data()), (s.size() - 1) * sizeof(CharType));
+            if (BuildMode::sparse == mode) {
+                std::vector<index_type> & p = positions[id];
+                std::sort(p.begin(), p.end());
+                out.write_varint(p.size());
+                index_type previous = 0;
+                for (index_type offset : p) {
+                    out.write_varint(offset - previous);
+                    previous = offset;
+                }
+            }
+        }
+        out.flush();
+    }
+
+    // save - Write the tree to a file, see above
+    void save(std::string const & path) const {
+        std::unique_ptr<std::FILE, int(*)(std::FILE*)> f(std::fopen(path.c_str(), "wb"), &std::fclose);
+        if (!f) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        BufferedWriter writer(f.get());
+        save(writer);
+    }
+
+    // load - Rebuild a saved tree (see save) into this one
+    // @in[in]: Where to read
+    //
+    // The tree must hold no string. A default-constructed tree takes the mode
+    // and maximum depth of the saved one; a truncated tree only loads a tree
+    // truncated at the same depth. Throws std::runtime_error on malformed
+    // input, std::logic_error on a mode mismatch.
+    void load(BufferedReader& in) {
+        if (!haystack.empty()) {
+            throw std::logic_error("SuffixTree: load needs an empty tree");
+        }
+        char magic[4];
+        in.read(magic, 4);
+        if (0 != std::memcmp(magic, "STRE", 4)) {
+            throw std::runtime_error("SuffixTree: not a saved tree");
+        }
+        char header[2];
+        in.read(header, 2);
+        CharType saved_end_token;
+        in.read_raw(&saved_end_token);
+        if (1 != header[0] || sizeof(CharType) != static_cast<std::size_t>(header[1]) ||
+            end_token != saved_end_token) {
+            throw std::runtime_error("SuffixTree: saved with another version or symbol type");
+        }
+        std::uint64_t saved_mode = in.read_varint();
+        index_type saved_depth = in.read_varint();
+        if (saved_mode > static_cast<std::uint64_t>(BuildMode::truncated)) {
+            throw std::runtime_error("SuffixTree: unknown insertion mode");
+        }
+        if (static_cast<std::uint64_t>(BuildMode::truncated) == saved_mode) {
+            if (BuildMode::empty == mode) {
+                truncate(saved_depth);
+            } else if (BuildMode::truncated != mode || depth_limit != saved_depth) {
+                throw std::logic_error("SuffixTree: the saved tree is truncated at another depth");
+            }
+        } else if (BuildMode::truncated == mode && 0 != saved_mode) {
+            throw std::logic_error("SuffixTree: insertion modes cannot be mixed");
+        }
+        std::uint64_t n_strings = in.read_varint();
+        std::vector<CharType> s;
+        std::vector<index_type> positions;
+        for (std::uint64_t k = 0; k < n_strings; ++k) {
+            int id = in.read_varint();
+            // Read by chunks, so that a corrupted length runs into the end of
+            // the input before it exhausts the memory
+            std::uint64_t length = in.read_varint();
+            s.clear();
+            while (s.size() < length) {
+                std::size_t done = s.size();
+                s.resize(done + std::min<std::uint64_t>(length - done, 1 << 16));
+                in.read(reinterpret_cast<char*>(s.data() + done), (s.size() - done) * sizeof(CharType));
+            }
+            int added;
+            if (static_cast<std::uint64_t>(BuildMode::sparse) == saved_mode) {
+                std::uint64_t n_positions = in.read_varint();
+                positions.clear();
+                index_type previous = 0;
+                for (std::uint64_t i = 0; i < n_positions; ++i) {
+                    previous += in.read_varint();
+                    positions.push_back(previous);
+                }
+                added = add_string_sparse(s.begin(), s.end(), positions);
+            } else {
+                added = add_string(s.begin(), s.end());
+            }
+            if (added != id) {
+                throw std::runtime_error("SuffixTree: corrupted save");
+            }
+        }
+    }
+
+    // load - Read a saved tree from a file, see above
+    void load(std::string const & path) {
+        std::unique_ptr<std::FILE, int(*)(std::FILE*)> f(std::fopen(path.c_str(), "rb"), &std::fclose);
+        if (!f) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        BufferedReader reader(f.get());
+        load(reader);
+    }
+};
+
+// With SUFFIXTREE_EXTERN_TEMPLATES (set by the CMake target
+// suffixtree_compiled), the trees of characters and of 32-bit symbols are
+// compiled once, in suffixtree.cpp, instead of in every translation unit.
+#ifdef SUFFIXTREE_EXTERN_TEMPLATES
+extern template class SuffixTree<char>;
+extern template class SuffixTree<std::uint32_t, 0>;
+#endif
 
 #endif // _SUFFIX_TREE_HPP_INCLUDED_
 
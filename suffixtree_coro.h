@@ -0,0 +1,524 @@
+#ifndef _SUFFIX_TREE_CORO_HPP_INCLUDED_
+#define _SUFFIX_TREE_CORO_HPP_INCLUDED_
+
+// Coroutine interface of SuffixTree (C++20)
+//
+// The queries whose cost grows with the number of occurrences (count,
+// find_all) walk a whole subtree; on a worker thread of an async runtime, a
+// short pattern over a large tree holds the thread for as long. The
+// operations below are coroutines over an OccurrenceCursor instead: every
+// `every` nodes visited they `co_await executor.schedule()`, letting the
+// executor run other tasks before it resumes them, and they stop early when
+// their std::stop_token is triggered.
+//
+// The executor is anything whose `schedule()` returns an awaitable resuming
+// the awaiting coroutine later (the scheduler interface of cppcoro, libunifex
+// and the like; RunQueue below is a minimal single-threaded one). The tree
+// and the executor must outlive the operations, and the tree must not be
+// modified meanwhile. The pattern is looked up when the operation is created,
+// and needs not outlive it.
+//
+// The rest of the library is C++11; this header alone needs C++20.
+
+#include "suffixtree.h"
+
+#if !defined(__cpp_impl_coroutine)
+#error "suffixtree_coro.h needs C++20 coroutines"
+#endif
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+namespace suffixtree_coro {
+
+// Thrown by the tasks whose stop token was triggered
+class Cancelled : public std::runtime_error {
+public:
+    Cancelled() : std::runtime_error("suffix tree query cancelled") {}
+};
+
+// When asynchronous operations give the thread back
+struct YieldOptions {
+    // Nodes (or suffixes) visited between two co_await executor.schedule();
+    // 0 counts as 1
+    std::size_t every = 4096;
+    // Checked at each of those points
+    std::stop_token stop;
+};
+
+// Generator - Lazy sequence of values computed by a coroutine
+//
+// The coroutine runs up to its next co_yield each time the iterator is
+// advanced. Destroying the generator destroys the suspended coroutine.
+template <typename T>
+class Generator {
+public:
+    struct promise_type {
+        T const *value = nullptr;
+        std::exception_ptr error;
+
+        Generator get_return_object() {
+            return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always yield_value(T const & v) noexcept {
+            value = std::addressof(v);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            error = std::current_exception();
+        }
+        // Generators do not await anything
+        template <typename U>
+        void await_transform(U&&) = delete;
+    };
+
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef std::ptrdiff_t difference_type;
+        typedef T value_type;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> h) : coroutine(h) {}
+
+        T const & operator*() const {
+            return *coroutine.promise().value;
+        }
+        iterator& operator++() {
+            advance(coroutine);
+            return *this;
+        }
+        void operator++(int) {
+            ++*this;
+        }
+        bool operator==(std::default_sentinel_t) const {
+            return !coroutine || coroutine.done();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> coroutine;
+    };
+
+    Generator(Generator&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+    Generator& operator=(Generator&& other) noexcept {
+        std::swap(coroutine, other.coroutine);
+        return *this;
+    }
+    ~Generator() {
+        if (coroutine) {
+            coroutine.destroy();
+        }
+    }
+
+    iterator begin() {
+        advance(coroutine);
+        return iterator(coroutine);
+    }
+    std::default_sentinel_t end() {
+        return {};
+    }
+
+private:
+    explicit Generator(std::coroutine_handle<promise_type> h) : coroutine(h) {}
+
+    static void advance(std::coroutine_handle<promise_type> h) {
+        h.resume();
+        if (h.promise().error) {
+            std::rethrow_exception(std::exchange(h.promise().error, nullptr));
+        }
+    }
+
+    std::coroutine_handle<promise_type> coroutine;
+};
+
+// Task - Lazily started coroutine producing a T
+//
+// `co_await task` starts it and resumes the awaiting coroutine with its
+// result. A task may also be started on an executor (RunQueue::spawn) and
+// its result read once done.
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        std::optional<T> value;
+        std::exception_ptr error;
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                auto next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+        void return_value(T v) {
+            value.emplace(std::move(v));
+        }
+        void unhandled_exception() {
+            error = std::current_exception();
+        }
+    };
+
+    Task(Task&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        std::swap(coroutine, other.coroutine);
+        return *this;
+    }
+    ~Task() {
+        if (coroutine) {
+            coroutine.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        coroutine.promise().continuation = awaiting;
+        return coroutine;
+    }
+    T await_resume() {
+        return result();
+    }
+
+    bool done() const {
+        return coroutine.done();
+    }
+
+    // result - The value returned by the finished task (or its exception)
+    T result() {
+        if (coroutine.promise().error) {
+            std::rethrow_exception(coroutine.promise().error);
+        }
+        return std::move(*coroutine.promise().value);
+    }
+
+    std::coroutine_handle<> handle() const {
+        return coroutine;
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : coroutine(h) {}
+
+    std::coroutine_handle<promise_type> coroutine;
+};
+
+// Stream - Asynchronous generator: `co_await stream.next()` resumes the
+// producer until it yields the next value (a pointer valid until the next
+// call) or ends (nullptr)
+//
+// The producer may itself co_await (an executor in particular) between two
+// values; the consumer is resumed wherever the producer yields. Destroying
+// the stream cancels the production.
+template <typename T>
+class Stream {
+public:
+    struct promise_type {
+        T const *value = nullptr;
+        std::exception_ptr error;
+        std::coroutine_handle<> consumer;
+
+        // Suspends the producer and resumes the consumer
+        struct ToConsumer {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                return h.promise().consumer;
+            }
+            void await_resume() noexcept {}
+        };
+
+        Stream get_return_object() {
+            return Stream(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        ToConsumer final_suspend() noexcept {
+            value = nullptr;
+            return {};
+        }
+        ToConsumer yield_value(T const & v) noexcept {
+            value = std::addressof(v);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            error = std::current_exception();
+        }
+    };
+
+    class NextAwaiter {
+    public:
+        explicit NextAwaiter(std::coroutine_handle<promise_type> h) : producer(h) {}
+
+        bool await_ready() const noexcept {
+            return producer.done();
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            producer.promise().consumer = awaiting;
+            return producer;
+        }
+        T const * await_resume() {
+            if (producer.promise().error) {
+                std::rethrow_exception(std::exchange(producer.promise().error, nullptr));
+            }
+            return producer.done() ? nullptr : producer.promise().value;
+        }
+
+    private:
+        std::coroutine_handle<promise_type> producer;
+    };
+
+    Stream(Stream&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+    Stream& operator=(Stream&& other) noexcept {
+        std::swap(coroutine, other.coroutine);
+        return *this;
+    }
+    ~Stream() {
+        if (coroutine) {
+            coroutine.destroy();
+        }
+    }
+
+    NextAwaiter next() {
+        return NextAwaiter(coroutine);
+    }
+
+private:
+    explicit Stream(std::coroutine_handle<promise_type> h) : coroutine(h) {}
+
+    std::coroutine_handle<promise_type> coroutine;
+};
+
+// RunQueue - Single-threaded executor: `run` resumes the scheduled
+// coroutines in FIFO order until none is left
+class RunQueue {
+public:
+    class ScheduleAwaiter {
+    public:
+        explicit ScheduleAwaiter(RunQueue *q) : queue(q) {}
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            queue->ready.push_back(h);
+        }
+        void await_resume() noexcept {}
+
+    private:
+        RunQueue *queue;
+    };
+
+    ScheduleAwaiter schedule() {
+        return ScheduleAwaiter(this);
+    }
+
+    // spawn - Start @task at the next `run`; the task must outlive it
+    template <typename T>
+    void spawn(Task<T>& task) {
+        ready.push_back(task.handle());
+    }
+
+    void run() {
+        while (!ready.empty()) {
+            std::coroutine_handle<> h = ready.front();
+            ready.pop_front();
+            h.resume();
+        }
+    }
+
+private:
+    std::deque<std::coroutine_handle<>> ready;
+};
+
+namespace detail {
+
+template <typename Tree>
+Generator<typename Tree::SuffixEntry> occurrences(typename Tree::OccurrenceCursor cursor) {
+    typename Tree::SuffixEntry e;
+    while (cursor.next(&e)) {
+        co_yield e;
+    }
+}
+
+// Walk - The occurrences of a cursor cut into slices of options.every
+// nodes: the loop shared by the asynchronous operations, which give the
+// thread back to their executor between two slices
+template <typename Tree>
+class Walk {
+public:
+    enum Step {
+        // An occurrence was fetched
+        found,
+        // The slice is over: co_await the executor, then step again
+        yield,
+        // Every occurrence was fetched
+        done,
+        // options.stop was triggered at the end of a slice
+        stopped
+    };
+
+    Walk(typename Tree::OccurrenceCursor& c, YieldOptions const & o) : cursor(c), options(o), budget(slice()) {}
+
+    Step step(typename Tree::SuffixEntry *e) {
+        if (cursor.next(e, &budget)) {
+            return found;
+        } else if (cursor.exhausted()) {
+            return done;
+        } else if (options.stop.stop_requested()) {
+            return stopped;
+        }
+        budget = slice();
+        return yield;
+    }
+
+private:
+    std::size_t slice() const {
+        return std::max<std::size_t>(1, options.every);
+    }
+
+    typename Tree::OccurrenceCursor& cursor;
+    YieldOptions const & options;
+    std::size_t budget;
+};
+
+// for_each - The loop of the asynchronous tasks: @consume(occurrence) until
+// the end, or until it returns false. Returns false if stopped.
+template <typename Tree, typename Executor, typename Consume>
+Task<bool> for_each(typename Tree::OccurrenceCursor& cursor, Executor& executor, YieldOptions const & options,
+                    Consume consume) {
+    Walk<Tree> walk(cursor, options);
+    for (typename Tree::SuffixEntry e;;) {
+        switch (walk.step(&e)) {
+        case Walk<Tree>::found:
+            if (!consume(e)) {
+                co_return true;
+            }
+            break;
+        case Walk<Tree>::yield:
+            co_await executor.schedule();
+            break;
+        case Walk<Tree>::done:
+            co_return true;
+        case Walk<Tree>::stopped:
+            co_return false;
+        }
+    }
+}
+
+template <typename Tree, typename Executor>
+Stream<typename Tree::SuffixEntry> async_occurrences(typename Tree::OccurrenceCursor cursor, Executor& executor,
+                                                     YieldOptions options) {
+    // A stream yields from its own body, it cannot delegate to for_each
+    Walk<Tree> walk(cursor, options);
+    for (typename Tree::SuffixEntry e;;) {
+        typename Walk<Tree>::Step step = walk.step(&e);
+        if (Walk<Tree>::found == step) {
+            co_yield e;
+        } else if (Walk<Tree>::yield == step) {
+            co_await executor.schedule();
+        } else {
+            break;
+        }
+    }
+}
+
+template <typename Tree, typename Executor>
+Task<std::size_t> async_count(typename Tree::OccurrenceCursor cursor, Executor& executor, YieldOptions options) {
+    std::size_t n = 0;
+    if (!co_await for_each<Tree>(cursor, executor, options, [&n](typename Tree::SuffixEntry const &) {
+            ++n;
+            return true;
+        })) {
+        throw Cancelled();
+    }
+    co_return n;
+}
+
+template <typename Tree, typename Executor>
+Task<std::vector<typename Tree::SuffixEntry>> async_find_all(typename Tree::OccurrenceCursor cursor,
+                                                             Executor& executor, std::size_t limit,
+                                                             YieldOptions options) {
+    std::vector<typename Tree::SuffixEntry> result;
+    if (limit > 0 && !co_await for_each<Tree>(cursor, executor, options,
+                                              [&result, limit](typename Tree::SuffixEntry const & e) {
+            result.push_back(e);
+            return result.size() < limit;
+        })) {
+        throw Cancelled();
+    }
+    co_return result;
+}
+
+} // namespace detail
+
+// occurrences - Occurrences of a string, in the order of find_all, computed
+// as the generator is iterated
+template <typename Tree, typename InputIterator>
+Generator<typename Tree::SuffixEntry> occurrences(Tree const & tree, InputIterator const & str_begin,
+                                                  InputIterator const & str_end) {
+    return detail::occurrences<Tree>(tree.iterate_occurrences(str_begin, str_end));
+}
+
+// async_occurrences - Stream of the occurrences of a string, in the order of
+// find_all; the stream ends early once options.stop is triggered
+template <typename Tree, typename InputIterator, typename Executor>
+Stream<typename Tree::SuffixEntry> async_occurrences(Tree const & tree, InputIterator const & str_begin,
+                                                     InputIterator const & str_end, Executor& executor,
+                                                     YieldOptions const & options = YieldOptions()) {
+    return detail::async_occurrences<Tree>(tree.iterate_occurrences(str_begin, str_end), executor, options);
+}
+
+// async_count - Number of occurrences of a string; throws Cancelled once
+// options.stop is triggered
+template <typename Tree, typename InputIterator, typename Executor>
+Task<std::size_t> async_count(Tree const & tree, InputIterator const & str_begin, InputIterator const & str_end,
+                              Executor& executor, YieldOptions const & options = YieldOptions()) {
+    return detail::async_count<Tree>(tree.iterate_occurrences(str_begin, str_end), executor, options);
+}
+
+// async_find_all - The first @limit occurrences of a string, in the order of
+// find_all; throws Cancelled once options.stop is triggered
+template <typename Tree, typename InputIterator, typename Executor>
+Task<std::vector<typename Tree::SuffixEntry>> async_find_all(Tree const & tree, InputIterator const & str_begin,
+                                                             InputIterator const & str_end, Executor& executor,
+                                                             std::size_t limit = std::size_t(-1),
+                                                             YieldOptions const & options = YieldOptions()) {
+    return detail::async_find_all<Tree>(tree.iterate_occurrences(str_begin, str_end), executor, limit, options);
+}
+
+} // namespace suffixtree_coro
+
+#endif // _SUFFIX_TREE_CORO_HPP_INCLUDED_
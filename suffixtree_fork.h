@@ -0,0 +1,167 @@
+#ifndef _SUFFIX_TREE_FORK_HPP_INCLUDED_
+#define _SUFFIX_TREE_FORK_HPP_INCLUDED_
+
+#include "suffixtree.h"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// SuffixTreeFork - A tree that can be grown without copying nor modifying
+// the tree it starts from
+//
+// The fork shares a read-only base tree and keeps the strings added to it in
+// a tree of its own, the delta: forking takes O(1), and the fork only holds
+// the memory of what it adds. Queries combine the base and the delta, with
+// the results a tree holding both would give; the delta strings get the ids
+// that follow the base's. promote() builds that tree from the strings of
+// both, replay() adds the delta strings to another tree.
+//
+// Nodes cannot be shared copy-on-write instead: an Ukkonen insertion splits
+// edges and redirects suffix links anywhere in the tree.
+//
+// Any number of forks, and readers of the base, may run concurrently; the
+// base must not be modified while forks use it. A sparse base cannot be
+// forked (their strings need the positions they were inserted with), and
+// the queries over the whole tree (longest_common_substring, repeats,
+// exports, traversals) are not available on a fork.
+template <typename Tree>
+class SuffixTreeFork {
+public:
+    typedef typename Tree::SuffixEntry SuffixEntry;
+    typedef typename Tree::string string;
+    typedef typename Tree::allocator_type allocator_type;
+
+    // @base[in]: The tree to fork, shared with the fork
+    // @alloc[in]: The allocator of the delta tree
+    explicit SuffixTreeFork(std::shared_ptr<const Tree> base, allocator_type const & alloc = allocator_type()) :
+      base_(std::move(base)),
+      delta_(make_delta(base_.get(), alloc)),
+      offset(base_->last_string_id())
+      {}
+
+    // add_string - Add a string to the fork
+    //
+    // Returns its id, or -1 when the tree holding the base and the fork would
+    // reject it (a suffix of a string of either, see SuffixTree::add_string).
+    template <typename InputIterator>
+    int add_string(InputIterator const & str_begin, InputIterator const & str_end) {
+        if (!base_->is_truncated() && base_->is_suffix(str_begin, str_end)) {
+            return -1;
+        }
+        int id = delta_.add_string(str_begin, str_end);
+        return id < 0 ? id : offset + id;
+    }
+
+    template <typename InputIterator>
+    bool is_suffix(InputIterator const & str_begin, InputIterator const & str_end) const {
+        return base_->is_suffix(str_begin, str_end) || delta_.is_suffix(str_begin, str_end);
+    }
+
+    template <typename InputIterator>
+    bool is_substring(InputIterator const & str_begin, InputIterator const & str_end) const {
+        return base_->is_substring(str_begin, str_end) || delta_.is_substring(str_begin, str_end);
+    }
+
+    template <typename InputIterator>
+    std::size_t count(InputIterator const & str_begin, InputIterator const & str_end) const {
+        return base_->count(str_begin, str_end) + delta_.count(str_begin, str_end);
+    }
+
+    // find_all - The occurrences in the base and in the fork, in the order a
+    // tree holding both gives them (see SuffixTree::suffix_less)
+    template <typename InputIterator>
+    std::vector<SuffixEntry> find_all(InputIterator const & str_begin, InputIterator const & str_end) const {
+        std::vector<SuffixEntry> in_base = base_->find_all(str_begin, str_end);
+        std::vector<SuffixEntry> added = delta_.find_all(str_begin, str_end);
+        if (added.empty()) {
+            return in_base;
+        }
+        for (auto & e : added) {
+            e.ref_str += offset;
+        }
+        // On ties the base comes first: its ids are the smaller ones
+        std::vector<SuffixEntry> result;
+        result.reserve(in_base.size() + added.size());
+        std::merge(in_base.begin(), in_base.end(), added.begin(), added.end(), std::back_inserter(result),
+                   [this](SuffixEntry const & a, SuffixEntry const & b) {
+                       return base_->suffix_less(get_string(a.ref_str), a.offset, get_string(b.ref_str), b.offset);
+                   });
+        return result;
+    }
+
+    // string_ids - Ids of the strings of the base and of the fork, in
+    // increasing order
+    std::vector<int> string_ids() const {
+        std::vector<int> ids = base_->string_ids();
+        for (int id : delta_.string_ids()) {
+            ids.push_back(offset + id);
+        }
+        return ids;
+    }
+
+    // get_string - A string of the base or of the fork, end token included
+    string const & get_string(int id) const {
+        return id <= offset ? base_->get_string(id) : delta_.get_string(id - offset);
+    }
+
+    std::shared_ptr<const Tree> const & base() const {
+        return base_;
+    }
+
+    // delta - The strings added to the fork, under ids counted from 1
+    Tree const & delta() const {
+        return delta_;
+    }
+
+    // memory_usage - The memory of the fork, the base left out
+    typename Tree::MemoryUsage memory_usage() const {
+        return delta_.memory_usage();
+    }
+
+    // replay - Add the strings of the fork, in order, to @tree
+    //
+    // On the base itself (once no reader is left), or a tree built from the
+    // same strings, the strings get the ids they have in the fork.
+    void replay(Tree& tree) const {
+        for (int id : delta_.string_ids()) {
+            string const & s = delta_.get_string(id);
+            tree.add_string(s.begin(), s.end() - 1);
+        }
+    }
+
+    // promote - A standalone tree holding the base and the fork
+    //
+    // Built from the strings of the base then those of the fork, in the time
+    // a construction of both takes: the base is shared read-only, and is
+    // never moved from.
+    Tree promote() const {
+        Tree tree = base_->is_truncated() ? Tree(base_->max_depth(), base_->get_allocator())
+                                          : Tree(base_->get_allocator());
+        for (int id : base_->string_ids()) {
+            string const & s = base_->get_string(id);
+            tree.add_string(s.begin(), s.end() - 1);
+        }
+        replay(tree);
+        return tree;
+    }
+
+private:
+    static Tree make_delta(Tree const *base, allocator_type const & alloc) {
+        if (!base) {
+            throw std::invalid_argument("SuffixTreeFork: no base tree");
+        }
+        if (base->is_sparse()) {
+            throw std::logic_error("SuffixTreeFork: sparse trees cannot be forked");
+        }
+        return base->is_truncated() ? Tree(base->max_depth(), alloc) : Tree(alloc);
+    }
+
+    std::shared_ptr<const Tree> base_;
+    Tree delta_;
+    int offset;
+};
+
+#endif // _SUFFIX_TREE_FORK_HPP_INCLUDED_
@@ -0,0 +1,156 @@
+#ifndef _SUFFIXTREE_TESTS_BRUTEFORCE_HPP_INCLUDED_
+#define _SUFFIXTREE_TESTS_BRUTEFORCE_HPP_INCLUDED_
+
+// Reference answers computed naively, and the random inputs of the tests
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bruteforce {
+
+// (string id, offset), the form the tests compare occurrences in
+typedef std::pair<int, long> Occurrence;
+
+// The strings of an index, by id
+typedef std::map<int, std::string> Strings;
+
+// occurrences - Every occurrence of @pattern, sorted
+inline std::vector<Occurrence> occurrences(Strings const & strings, std::string const & pattern) {
+    std::vector<Occurrence> result;
+    for (auto const & s : strings) {
+        for (std::size_t i = 0; i + pattern.size() <= s.second.size(); ++i) {
+            if (0 == s.second.compare(i, pattern.size(), pattern)) {
+                result.push_back(Occurrence(s.first, long(i)));
+            }
+        }
+    }
+    return result;
+}
+
+// ends_string - Whether a string of @strings ends with @s
+inline bool ends_string(Strings const & strings, std::string const & s) {
+    for (auto const & t : strings) {
+        if (t.second.size() >= s.size() && 0 == t.second.compare(t.second.size() - s.size(), s.size(), s)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// suffix_array - The suffixes, end token included, in the order of the
+// suffix array exports: the end token sorts first, and equal suffixes of
+// different strings by string id
+inline std::vector<Occurrence> suffix_array(Strings const & strings) {
+    std::vector<Occurrence> result;
+    for (auto const & s : strings) {
+        for (std::size_t i = 0; i <= s.second.size(); ++i) {
+            result.push_back(Occurrence(s.first, long(i)));
+        }
+    }
+    std::sort(result.begin(), result.end(), [&](Occurrence const & a, Occurrence const & b) {
+        std::string const & x = strings.at(a.first);
+        std::string const & y = strings.at(b.first);
+        int c = x.compare(a.second, std::string::npos, y, b.second, std::string::npos);
+        // A proper prefix ends with the end token, which sorts first: the
+        // string comparison already orders it before
+        return c < 0 || (0 == c && a.first < b.first);
+    });
+    return result;
+}
+
+// lcp - Longest common prefix of two suffixes, end tokens excluded
+inline long lcp(Strings const & strings, Occurrence const & a, Occurrence const & b) {
+    std::string const & x = strings.at(a.first);
+    std::string const & y = strings.at(b.first);
+    long l = 0;
+    while (a.second + l < long(x.size()) && b.second + l < long(y.size()) && x[a.second + l] == y[b.second + l]) {
+        ++l;
+    }
+    return l;
+}
+
+// longest_common_substring - The lexicographically smallest of the longest
+// substrings of at least @min_strings strings ("" if none)
+inline std::string longest_common_substring(Strings const & strings, std::size_t min_strings) {
+    std::map<std::string, std::set<int>> holders;
+    for (auto const & s : strings) {
+        for (std::size_t i = 0; i < s.second.size(); ++i) {
+            for (std::size_t j = i + 1; j <= s.second.size(); ++j) {
+                holders[s.second.substr(i, j - i)].insert(s.first);
+            }
+        }
+    }
+    std::string best;
+    for (auto const & h : holders) {
+        if (h.second.size() >= min_strings && h.first.size() > best.size()) {
+            best = h.first;
+        }
+    }
+    return best;
+}
+
+// sorted - The occurrences of an index as sorted Occurrences
+template <typename Entries>
+std::vector<Occurrence> sorted(Entries const & entries) {
+    std::vector<Occurrence> result;
+    for (auto const & e : entries) {
+        result.push_back(Occurrence(e.ref_str, long(e.offset)));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// random_string - @length letters among the first @sigma of the alphabet
+inline std::string random_string(std::mt19937& rng, std::size_t length, int sigma) {
+    std::string s(length, 'a');
+    for (auto & c : s) {
+        c = static_cast<char>('a' + rng() % sigma);
+    }
+    return s;
+}
+
+// random_strings - @n strings of up to @max_length characters, none a
+// suffix of an earlier one, so that every index accepts them all: a string
+// that is one is lengthened (past @max_length if need be, as with a single
+// letter)
+inline std::vector<std::string> random_strings(std::mt19937& rng, std::size_t n, std::size_t max_length,
+                                               int sigma) {
+    std::vector<std::string> result;
+    Strings seen;
+    while (result.size() < n) {
+        std::string s = random_string(rng, 1 + rng() % max_length, sigma);
+        while (ends_string(seen, s)) {
+            s.insert(s.begin(), char('a' + rng() % sigma));
+        }
+        seen[int(result.size()) + 1] = s;
+        result.push_back(s);
+    }
+    return result;
+}
+
+// patterns - Substrings of the strings, and random strings that mostly do
+// not occur
+inline std::vector<std::string> patterns(std::mt19937& rng, std::vector<std::string> const & strings,
+                                         std::size_t n, int sigma) {
+    std::vector<std::string> result;
+    for (std::size_t k = 0; k < n; ++k) {
+        std::string const & s = strings[rng() % strings.size()];
+        if (k % 4 == 3 || s.empty()) {
+            result.push_back(random_string(rng, 1 + rng() % 12, sigma));
+            continue;
+        }
+        std::size_t begin = rng() % s.size();
+        result.push_back(s.substr(begin, 1 + rng() % (s.size() - begin)));
+    }
+    return result;
+}
+
+} // namespace bruteforce
+
+#endif // _SUFFIXTREE_TESTS_BRUTEFORCE_HPP_INCLUDED_
@@ -0,0 +1,202 @@
+// Moves and save/load round-trips of SuffixTree
+
+#include "suffixtree.h"
+#include "memoryresource.h"
+#include "bufferedreader.h"
+#include "bufferedwriter.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+typedef SuffixTree<char> Tree;
+typedef SuffixTree<char, '$', ResourceAllocator<char>> ResourceTree;
+
+static_assert(std::is_nothrow_move_constructible<Tree>::value, "std::allocator trees move without throwing");
+static_assert(std::is_nothrow_move_assignable<Tree>::value, "std::allocator trees move without throwing");
+static_assert(!std::is_nothrow_move_assignable<ResourceTree>::value,
+              "trees over different resources are rebuilt on move assignment");
+
+namespace {
+
+// What the tests compare trees on: a query sample and the exports
+template <typename A, typename B>
+void expect_same(A const & a, B const & b, std::vector<std::string> const & patterns) {
+    EXPECT_EQ(a.string_ids(), b.string_ids());
+    for (auto const & p : patterns) {
+        EXPECT_EQ(bruteforce::sorted(a.find_all(p.begin(), p.end())),
+                  bruteforce::sorted(b.find_all(p.begin(), p.end()))) << p;
+    }
+    EXPECT_EQ(bruteforce::sorted(a.export_suffix_array()), bruteforce::sorted(b.export_suffix_array()));
+}
+
+struct Input {
+    std::vector<std::string> texts;
+    std::vector<std::string> more;
+    std::vector<std::string> patterns;
+
+    explicit Input(unsigned seed) {
+        std::mt19937 rng(seed);
+        std::vector<std::string> all = bruteforce::random_strings(rng, 16, 200, 4);
+        texts.assign(all.begin(), all.begin() + 12);
+        more.assign(all.begin() + 12, all.end());
+        patterns = bruteforce::patterns(rng, all, 100, 4);
+    }
+};
+
+template <typename T>
+void add(T& tree, std::vector<std::string> const & texts) {
+    for (auto const & s : texts) {
+        tree.add_string(s.begin(), s.end());
+    }
+}
+
+} // namespace
+
+TEST(Move, ConstructionAndAssignment) {
+    Input in(4);
+    Tree tree;
+    add(tree, in.texts);
+    Tree reference;
+    add(reference, in.texts);
+
+    Tree moved(std::move(tree));
+    expect_same(moved, reference, in.patterns);
+    EXPECT_TRUE(tree.string_ids().empty());
+    EXPECT_EQ(0u, tree.memory_usage().nodes);
+    // The moved-from tree is usable
+    add(tree, in.more);
+    EXPECT_EQ(in.more.size(), tree.string_ids().size());
+
+    tree = std::move(moved);
+    expect_same(tree, reference, in.patterns);
+    EXPECT_TRUE(moved.string_ids().empty());
+
+    Tree truncated(4);
+    add(truncated, in.texts);
+    tree = std::move(truncated);
+    EXPECT_TRUE(tree.is_truncated());
+    EXPECT_FALSE(truncated.is_truncated());
+
+    std::vector<Tree> trees;
+    for (int i = 0; i < 8; ++i) {
+        Tree t;
+        add(t, in.texts);
+        trees.push_back(std::move(t));
+    }
+    for (auto const & t : trees) {
+        expect_same(t, reference, in.patterns);
+    }
+}
+
+TEST(Move, AssignmentBetweenResources) {
+    Input in(5);
+    CountingResource ra, rb;
+    {
+        ResourceTree a(&ra), b(&rb), c(&rb);
+        add(a, in.texts);
+        add(b, in.more);
+        Tree reference;
+        add(reference, in.texts);
+        std::size_t bytes = a.memory_usage().total();
+
+        // Unequal resources that do not propagate: b is rebuilt from the
+        // strings in its own resource, with the same nodes
+        b = std::move(a);
+        EXPECT_EQ(&rb, b.get_allocator().resource());
+        EXPECT_EQ(bytes, b.memory_usage().total());
+        EXPECT_TRUE(a.string_ids().empty());
+        expect_same(b, reference, in.patterns);
+
+        // Equal resources: the nodes are taken
+        c = std::move(b);
+        EXPECT_EQ(bytes, c.memory_usage().total());
+        expect_same(c, reference, in.patterns);
+    }
+    EXPECT_EQ(0u, ra.bytes_in_use());
+    EXPECT_EQ(0u, rb.bytes_in_use());
+}
+
+// The rebuild of a move between resources keeps the mode, the depth of a
+// truncated tree and the positions of a sparse one
+TEST(Move, AssignmentBetweenResourcesKeepsTheMode) {
+    Input in(8);
+    CountingResource ra, rb;
+    {
+        ResourceTree truncated(5, &ra), sparse(&ra), into(&rb);
+        add(truncated, in.texts);
+        Tree truncated_reference(5);
+        add(truncated_reference, in.texts);
+        into = std::move(truncated);
+        EXPECT_TRUE(into.is_truncated());
+        EXPECT_EQ(5, into.max_depth());
+        expect_same(into, truncated_reference, in.patterns);
+        // The ids follow on
+        add(into, in.more);
+        add(truncated_reference, in.more);
+        expect_same(into, truncated_reference, in.patterns);
+
+        Tree sparse_reference;
+        for (auto const & s : in.texts) {
+            std::vector<Tree::index_type> positions;
+            for (Tree::index_type p = 0; p <= Tree::index_type(s.size()); p += 3) {
+                positions.push_back(p);
+            }
+            sparse.add_string_sparse(s.begin(), s.end(), positions);
+            sparse_reference.add_string_sparse(s.begin(), s.end(), positions);
+        }
+        into = std::move(sparse);
+        EXPECT_TRUE(into.is_sparse());
+        EXPECT_FALSE(into.is_truncated());
+        expect_same(into, sparse_reference, in.patterns);
+    }
+    EXPECT_EQ(0u, ra.bytes_in_use());
+    EXPECT_EQ(0u, rb.bytes_in_use());
+}
+
+TEST(SaveLoad, RoundTrips) {
+    Input in(6);
+    Tree ukkonen, truncated(6), sparse;
+    add(ukkonen, in.texts);
+    add(truncated, in.texts);
+    for (auto const & s : in.texts) {
+        sparse.add_string_sparse(s.begin(), s.end(), {0, Tree::index_type(s.size() / 2)});
+    }
+    for (Tree const *tree : {&ukkonen, &truncated, &sparse}) {
+        std::string bytes;
+        {
+            BufferedWriter out(&bytes);
+            tree->save(out);
+        }
+        Tree loaded = tree->is_truncated() ? Tree(tree->max_depth()) : Tree();
+        BufferedReader reader(&bytes);
+        loaded.load(reader);
+        EXPECT_EQ(tree->is_sparse(), loaded.is_sparse());
+        EXPECT_EQ(tree->is_truncated(), loaded.is_truncated());
+        expect_same(*tree, loaded, in.patterns);
+    }
+}
+
+TEST(SaveLoad, RejectsNonEmptyTreesAndBadInput) {
+    Input in(7);
+    Tree tree;
+    add(tree, in.texts);
+    std::string bytes;
+    {
+        BufferedWriter out(&bytes);
+        tree.save(out);
+    }
+    BufferedReader reader(&bytes);
+    EXPECT_THROW(tree.load(reader), std::logic_error);
+
+    std::string garbage = "not a tree";
+    BufferedReader bad(&garbage);
+    Tree empty;
+    EXPECT_THROW(empty.load(bad), std::runtime_error);
+}
@@ -0,0 +1,217 @@
+// The coroutine interface (suffixtree_coro.h, C++20): results against the
+// synchronous queries, the points where the operations give the thread
+// back, cancellation and limits
+
+#include "suffixtree_coro.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+using namespace suffixtree_coro;
+
+typedef SuffixTree<char> Tree;
+typedef std::vector<Tree::SuffixEntry> Entries;
+
+namespace {
+
+// RunQueue counting the schedule() calls, and requesting a stop at the
+// @stop_at-th one (0: never)
+struct CountingQueue {
+    RunQueue queue;
+    std::size_t schedules = 0;
+    std::size_t stop_at = 0;
+    std::stop_source stop;
+
+    RunQueue::ScheduleAwaiter schedule() {
+        if (++schedules == stop_at) {
+            stop.request_stop();
+        }
+        return queue.schedule();
+    }
+};
+
+// Runs @task to completion on @q
+template <typename T>
+T run(Task<T> task, CountingQueue& q) {
+    q.queue.spawn(task);
+    q.queue.run();
+    EXPECT_TRUE(task.done());
+    return task.result();
+}
+
+Task<Entries> drain(Stream<Tree::SuffixEntry> stream) {
+    Entries result;
+    while (Tree::SuffixEntry const *e = co_await stream.next()) {
+        result.push_back(*e);
+    }
+    co_return result;
+}
+
+std::vector<bruteforce::Occurrence> in_order(Entries const & entries) {
+    std::vector<bruteforce::Occurrence> result;
+    for (auto const & e : entries) {
+        result.push_back(bruteforce::Occurrence(e.ref_str, long(e.offset)));
+    }
+    return result;
+}
+
+struct Fixture {
+    Tree tree;
+    std::vector<std::string> patterns;
+
+    Fixture() {
+        std::mt19937 rng(1);
+        std::vector<std::string> texts = bruteforce::random_strings(rng, 6, 300, 2);
+        for (auto const & s : texts) {
+            tree.add_string(s.begin(), s.end());
+        }
+        patterns = bruteforce::patterns(rng, texts, 30, 2);
+        patterns.push_back("a");
+    }
+};
+
+} // namespace
+
+TEST(Coroutines, MatchTheSynchronousQueries) {
+    Fixture f;
+    for (auto const & p : f.patterns) {
+        Entries expected = f.tree.find_all(p.begin(), p.end());
+        Entries generated;
+        for (auto const & e : occurrences(f.tree, p.begin(), p.end())) {
+            generated.push_back(e);
+        }
+        EXPECT_EQ(in_order(expected), in_order(generated)) << p;
+        for (std::size_t every : {0, 1, 5, 4096}) {
+            YieldOptions options;
+            options.every = every;
+            CountingQueue q;
+            EXPECT_EQ(expected.size(), run(async_count(f.tree, p.begin(), p.end(), q, options), q)) << p;
+            EXPECT_EQ(in_order(expected),
+                      in_order(run(async_find_all(f.tree, p.begin(), p.end(), q, std::size_t(-1), options), q)))
+                << p;
+            EXPECT_EQ(in_order(expected),
+                      in_order(run(drain(async_occurrences(f.tree, p.begin(), p.end(), q, options)), q))) << p;
+        }
+    }
+}
+
+// Every `every` nodes visited an operation schedules itself again; 0 counts
+// as 1, and a budget covering the whole walk never gives the thread back
+TEST(Coroutines, YieldEveryBudget) {
+    Fixture f;
+    std::string a = "a";
+    std::size_t n = f.tree.count(a.begin(), a.end());
+    std::vector<std::size_t> schedules;
+    for (std::size_t every : {0, 1, 16, 1000000}) {
+        YieldOptions options;
+        options.every = every;
+        CountingQueue q;
+        EXPECT_EQ(n, run(async_count(f.tree, a.begin(), a.end(), q, options), q));
+        schedules.push_back(q.schedules);
+    }
+    EXPECT_EQ(schedules[0], schedules[1]);
+    // At least a node per occurrence
+    EXPECT_GE(schedules[1], n);
+    EXPECT_LT(schedules[2], schedules[1]);
+    EXPECT_GT(schedules[2], 0u);
+    EXPECT_EQ(0u, schedules[3]);
+}
+
+// Two walks share the queue: neither finishes before the other starts
+TEST(Coroutines, WalksInterleave) {
+    Fixture f;
+    std::string a = "a", b = "b";
+    YieldOptions options;
+    options.every = 8;
+    CountingQueue q;
+    std::string log;
+    auto tagged = [&log](Stream<Tree::SuffixEntry> stream, char tag) -> Task<std::size_t> {
+        std::size_t n = 0;
+        while (co_await stream.next()) {
+            log.push_back(tag);
+            ++n;
+        }
+        co_return n;
+    };
+    Task<std::size_t> walk_a = tagged(async_occurrences(f.tree, a.begin(), a.end(), q, options), 'a');
+    Task<std::size_t> walk_b = tagged(async_occurrences(f.tree, b.begin(), b.end(), q, options), 'b');
+    q.queue.spawn(walk_a);
+    q.queue.spawn(walk_b);
+    q.queue.run();
+    ASSERT_TRUE(walk_a.done() && walk_b.done());
+    EXPECT_EQ(f.tree.count(a.begin(), a.end()), walk_a.result());
+    EXPECT_EQ(f.tree.count(b.begin(), b.end()), walk_b.result());
+    EXPECT_LT(log.find('b'), log.rfind('a'));
+    EXPECT_LT(log.find('a'), log.rfind('b'));
+}
+
+// The stop token is checked where the operations yield: a walk stopped
+// halfway throws Cancelled (tasks) or ends early (streams)
+TEST(Coroutines, CancellationMidWalk) {
+    Fixture f;
+    std::string a = "a";
+    Entries all = f.tree.find_all(a.begin(), a.end());
+    {
+        CountingQueue q;
+        q.stop_at = 3;
+        YieldOptions options;
+        options.every = 4;
+        options.stop = q.stop.get_token();
+        EXPECT_THROW(run(async_count(f.tree, a.begin(), a.end(), q, options), q), Cancelled);
+        EXPECT_EQ(3u, q.schedules);
+    }
+    {
+        CountingQueue q;
+        q.stop_at = 3;
+        YieldOptions options;
+        options.every = 4;
+        options.stop = q.stop.get_token();
+        EXPECT_THROW(run(async_find_all(f.tree, a.begin(), a.end(), q, std::size_t(-1), options), q), Cancelled);
+    }
+    {
+        CountingQueue q;
+        q.stop_at = 3;
+        YieldOptions options;
+        options.every = 4;
+        options.stop = q.stop.get_token();
+        Entries partial = run(drain(async_occurrences(f.tree, a.begin(), a.end(), q, options)), q);
+        // A prefix of the occurrences, in order
+        ASSERT_GT(partial.size(), 0u);
+        ASSERT_LT(partial.size(), all.size());
+        EXPECT_EQ(in_order(Entries(all.begin(), all.begin() + partial.size())), in_order(partial));
+    }
+    {
+        // Stopped before the start: a walk within one slice still finishes
+        std::stop_source stopped;
+        stopped.request_stop();
+        YieldOptions options;
+        options.stop = stopped.get_token();
+        CountingQueue q;
+        EXPECT_EQ(all.size(), run(async_count(f.tree, a.begin(), a.end(), q, options), q));
+    }
+}
+
+TEST(Coroutines, FindAllLimit) {
+    Fixture f;
+    std::string a = "a";
+    Entries all = f.tree.find_all(a.begin(), a.end());
+    YieldOptions options;
+    options.every = 3;
+    for (std::size_t limit : {std::size_t(0), std::size_t(1), std::size_t(10), all.size(), all.size() + 5}) {
+        CountingQueue q;
+        Entries found = run(async_find_all(f.tree, a.begin(), a.end(), q, limit, options), q);
+        std::size_t n = std::min(limit, all.size());
+        EXPECT_EQ(in_order(Entries(all.begin(), all.begin() + n)), in_order(found)) << limit;
+        if (0 == limit) {
+            // Nothing walked
+            EXPECT_EQ(0u, q.schedules);
+        }
+    }
+}
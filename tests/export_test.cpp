@@ -0,0 +1,165 @@
+// export_tree: the DOT and JSON outputs, and the binary edge list decoded
+// back into the suffixes of the strings
+
+#include "suffixtree.h"
+#include "bufferedreader.h"
+#include "bufferedwriter.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+using bruteforce::Occurrence;
+using bruteforce::Strings;
+
+typedef SuffixTree<char> Tree;
+
+namespace {
+
+std::string export_tree(Tree const & tree, Tree::ExportFormat format,
+                        Tree::ExportOptions const & opts = Tree::ExportOptions()) {
+    std::string out;
+    {
+        BufferedWriter w(&out);
+        tree.export_tree(w, format, opts);
+    }
+    return out;
+}
+
+// A decoded edge list: the strings, and per node its parent, path label and
+// suffixes
+struct EdgeList {
+    Strings strings;
+    std::vector<std::uint64_t> parent;
+    std::vector<std::string> label;
+    std::vector<Occurrence> suffixes;
+
+    // @whole[in]: The whole tree was exported, the labels start at the root
+    EdgeList(std::string const & bytes, bool whole) {
+        std::string data = bytes;
+        BufferedReader in(&data);
+        char header[6];
+        in.read(header, 6);
+        EXPECT_EQ("STEL", std::string(header, 4));
+        EXPECT_EQ(1, header[4]);
+        EXPECT_EQ(1, header[5]);
+        std::uint64_t n = in.read_varint();
+        for (std::uint64_t i = 0; i < n; ++i) {
+            int id = static_cast<int>(in.read_varint());
+            std::string s(in.read_varint(), '\0');
+            in.read(&s[0], s.size());
+            strings[id] = s;
+        }
+        while (!in.eof()) {
+            std::uint64_t delta = in.read_varint();
+            int ref = static_cast<int>(in.read_varint());
+            std::uint64_t l = in.read_varint();
+            std::uint64_t length = in.read_varint();
+            std::uint64_t id = label.size();
+            parent.push_back(0 == delta ? id : id - delta);
+            label.push_back(0 == delta ? std::string() : label[id - delta] + strings[ref].substr(l, length));
+            for (std::uint64_t k = in.read_varint(); k > 0; --k) {
+                int r = static_cast<int>(in.read_varint());
+                long offset = static_cast<long>(in.read_varint());
+                suffixes.push_back(Occurrence(r, offset));
+                if (whole) {
+                    // The path of a leaf spells its suffixes
+                    EXPECT_EQ(strings[r].substr(offset), label.back());
+                }
+            }
+        }
+    }
+};
+
+} // namespace
+
+TEST(ExportTree, DotAndJson) {
+    Tree tree;
+    std::string s = "ab";
+    tree.add_string(s.begin(), s.end());
+    EXPECT_EQ("digraph suffix_tree {\n"
+              "  node [shape=circle, label=\"\"];\n"
+              "  n0 [shape=doublecircle];\n"
+              "  n1 [shape=box, label=\"1:2\"];\n"
+              "  n0 -> n1 [label=\"$\"];\n"
+              "  n2 [shape=box, label=\"1:0\"];\n"
+              "  n0 -> n2 [label=\"ab$\"];\n"
+              "  n3 [shape=box, label=\"1:1\"];\n"
+              "  n0 -> n3 [label=\"b$\"];\n"
+              "}\n", export_tree(tree, Tree::ExportFormat::dot));
+    EXPECT_EQ("{\"nodes\":[\n"
+              "{\"id\":0,\"parent\":null,\"depth\":0},\n"
+              "{\"id\":1,\"parent\":0,\"label\":\"$\",\"depth\":1,\"suffixes\":[[1,2]]},\n"
+              "{\"id\":2,\"parent\":0,\"label\":\"ab$\",\"depth\":3,\"suffixes\":[[1,0]]},\n"
+              "{\"id\":3,\"parent\":0,\"label\":\"b$\",\"depth\":2,\"suffixes\":[[1,1]]}\n"
+              "]}\n", export_tree(tree, Tree::ExportFormat::json));
+}
+
+TEST(ExportTree, EscapesAndTruncatesLabels) {
+    Tree tree;
+    std::string s = "a\"b\\c\nd";
+    tree.add_string(s.begin(), s.end());
+    Tree::ExportOptions opts;
+    std::string json = export_tree(tree, Tree::ExportFormat::json, opts);
+    EXPECT_NE(std::string::npos, json.find("\"label\":\"a\\\"b\\\\c\\u000ad$\"")) << json;
+    std::string dot = export_tree(tree, Tree::ExportFormat::dot, opts);
+    EXPECT_NE(std::string::npos, dot.find("[label=\"a\\\"b\\\\c d$\"]")) << dot;
+    opts.max_label_length = 3;
+    json = export_tree(tree, Tree::ExportFormat::json, opts);
+    EXPECT_NE(std::string::npos, json.find("\"label\":\"a\\\"b...\"")) << json;
+}
+
+TEST(ExportTree, EdgeListSpellsEverySuffix) {
+    std::mt19937 rng(1);
+    for (int sigma : {1, 2, 4}) {
+        Tree tree;
+        Strings strings;
+        for (auto const & s : bruteforce::random_strings(rng, 6, 50, sigma)) {
+            strings[tree.add_string(s.begin(), s.end())] = s + '$';
+        }
+        EdgeList list(export_tree(tree, Tree::ExportFormat::edge_list), true);
+        EXPECT_EQ(strings, list.strings);
+        Tree::TreeStats shape = tree.tree_stats();
+        EXPECT_EQ(shape.internal_nodes + shape.leaves, list.label.size());
+        // Pre-order, children in lexicographic order
+        EXPECT_TRUE(std::is_sorted(list.label.begin(), list.label.end()));
+        std::sort(list.suffixes.begin(), list.suffixes.end());
+        EXPECT_EQ(bruteforce::sorted(tree.export_suffix_array()), list.suffixes);
+    }
+}
+
+TEST(ExportTree, DepthLimitAndSubtree) {
+    Tree tree;
+    std::string s = "banana";
+    tree.add_string(s.begin(), s.end());
+    Tree::ExportOptions opts;
+    opts.max_depth = 1;
+    EdgeList top(export_tree(tree, Tree::ExportFormat::edge_list, opts), true);
+    // The root and its children $, a, banana$ and na
+    EXPECT_EQ(5u, top.label.size());
+
+    opts = Tree::ExportOptions();
+    std::string an_text = "an";
+    opts.subtree.assign(an_text.begin(), an_text.end());
+    EdgeList an(export_tree(tree, Tree::ExportFormat::edge_list, opts), false);
+    // The locus of "an" is the node of "ana", with the leaves of ana$ and
+    // anana$; labels are relative to the exported root
+    ASSERT_EQ(3u, an.label.size());
+    EXPECT_EQ("", an.label[0]);
+    EXPECT_EQ("$", an.label[1]);
+    EXPECT_EQ("na$", an.label[2]);
+
+    std::string missing = "nab";
+    opts.subtree.assign(missing.begin(), missing.end());
+    std::string out;
+    {
+        BufferedWriter w(&out);
+        EXPECT_FALSE(tree.export_tree(w, Tree::ExportFormat::json, opts));
+    }
+    EXPECT_TRUE(out.empty());
+}
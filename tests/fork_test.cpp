@@ -0,0 +1,141 @@
+// SuffixTreeFork against a tree holding the base and the fork's strings
+
+#include "suffixtree.h"
+#include "suffixtree_fork.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using bruteforce::Occurrence;
+using bruteforce::Strings;
+
+typedef SuffixTree<char> Tree;
+typedef SuffixTreeFork<Tree> Fork;
+
+namespace {
+
+template <typename Index>
+void expect_occurrences(Index const & index, Strings const & strings, std::vector<std::string> const & patterns) {
+    for (auto const & p : patterns) {
+        std::vector<Occurrence> expected = bruteforce::occurrences(strings, p);
+        EXPECT_EQ(expected.size(), index.count(p.begin(), p.end())) << p;
+        EXPECT_EQ(expected, bruteforce::sorted(index.find_all(p.begin(), p.end()))) << p;
+        EXPECT_EQ(!expected.empty(), index.is_substring(p.begin(), p.end())) << p;
+    }
+}
+
+std::vector<Occurrence> in_order(std::vector<Tree::SuffixEntry> const & entries) {
+    std::vector<Occurrence> result;
+    for (auto const & e : entries) {
+        result.push_back(Occurrence(e.ref_str, long(e.offset)));
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(SuffixTreeFork, QueriesCoverTheBaseAndTheFork) {
+    std::mt19937 rng(1);
+    std::vector<std::string> texts = bruteforce::random_strings(rng, 14, 100, 3);
+    std::vector<std::string> patterns = bruteforce::patterns(rng, texts, 150, 3);
+    std::shared_ptr<Tree> base = std::make_shared<Tree>();
+    Strings strings;
+    for (std::size_t i = 0; i < 8; ++i) {
+        strings[base->add_string(texts[i].begin(), texts[i].end())] = texts[i];
+    }
+    Strings base_strings = strings;
+
+    Fork fork(base);
+    Fork other(base);
+    for (std::size_t i = 8; i < texts.size(); ++i) {
+        int id = fork.add_string(texts[i].begin(), texts[i].end());
+        EXPECT_EQ(int(i) + 1, id);
+        strings[id] = texts[i];
+    }
+    expect_occurrences(fork, strings, patterns);
+    // Forks do not see each other, and leave the base alone
+    expect_occurrences(other, base_strings, patterns);
+    expect_occurrences(*base, base_strings, patterns);
+
+    for (auto const & s : strings) {
+        EXPECT_EQ(s.second + '$', std::string(fork.get_string(s.first).begin(), fork.get_string(s.first).end()));
+    }
+
+    Tree promoted = fork.promote();
+    expect_occurrences(promoted, strings, patterns);
+    Tree replayed;
+    for (int id : base->string_ids()) {
+        replayed.add_string(base->get_string(id).begin(), base->get_string(id).end() - 1);
+    }
+    fork.replay(replayed);
+    expect_occurrences(replayed, strings, patterns);
+}
+
+TEST(SuffixTreeFork, RejectsWhatTheWholeTreeWould) {
+    std::shared_ptr<Tree> base = std::make_shared<Tree>();
+    std::string hello = "hello", llo = "llo", help = "help", lp = "lp";
+    base->add_string(hello.begin(), hello.end());
+    Fork fork(base);
+    // A suffix of a string of the base, or of the fork
+    EXPECT_EQ(-1, fork.add_string(llo.begin(), llo.end()));
+    EXPECT_EQ(2, fork.add_string(help.begin(), help.end()));
+    EXPECT_EQ(-1, fork.add_string(lp.begin(), lp.end()));
+    EXPECT_TRUE(fork.is_suffix(lp.begin(), lp.end()));
+}
+
+TEST(SuffixTreeFork, TruncatedAndSparseBases) {
+    std::mt19937 rng(2);
+    std::vector<std::string> texts = bruteforce::random_strings(rng, 10, 80, 2);
+    std::vector<std::string> patterns = bruteforce::patterns(rng, texts, 100, 2);
+    std::shared_ptr<Tree> base = std::make_shared<Tree>(4);
+    Strings strings;
+    for (std::size_t i = 0; i < 5; ++i) {
+        strings[base->add_string(texts[i].begin(), texts[i].end())] = texts[i];
+    }
+    Fork fork(base);
+    EXPECT_TRUE(fork.delta().is_truncated());
+    for (std::size_t i = 5; i < texts.size(); ++i) {
+        strings[fork.add_string(texts[i].begin(), texts[i].end())] = texts[i];
+    }
+    expect_occurrences(fork, strings, patterns);
+
+    std::shared_ptr<Tree> sparse = std::make_shared<Tree>();
+    sparse->add_string_sparse(texts[0].begin(), texts[0].end(), {0});
+    EXPECT_THROW(Fork f(sparse), std::logic_error);
+    EXPECT_THROW(Fork f(nullptr), std::invalid_argument);
+}
+
+// find_all lists the occurrences in the order of a single tree, for the
+// fork and for its promotion
+TEST(SuffixTreeFork, FindAllInTheOrderOfASingleTree) {
+    std::mt19937 rng(3);
+    std::vector<std::string> texts = bruteforce::random_strings(rng, 12, 60, 2);
+    std::vector<std::string> patterns = bruteforce::patterns(rng, texts, 100, 2);
+    patterns.push_back("");
+    for (Tree::index_type depth : {0, 3}) {
+        std::shared_ptr<Tree> base = depth > 0 ? std::make_shared<Tree>(depth) : std::make_shared<Tree>();
+        Tree whole = depth > 0 ? Tree(depth) : Tree();
+        for (std::size_t i = 0; i < 6; ++i) {
+            base->add_string(texts[i].begin(), texts[i].end());
+            whole.add_string(texts[i].begin(), texts[i].end());
+        }
+        Fork fork(base);
+        for (std::size_t i = 6; i < texts.size(); ++i) {
+            EXPECT_EQ(whole.add_string(texts[i].begin(), texts[i].end()),
+                      fork.add_string(texts[i].begin(), texts[i].end()));
+        }
+        Tree promoted = fork.promote();
+        EXPECT_EQ(whole.is_truncated(), promoted.is_truncated());
+        for (auto const & p : patterns) {
+            std::vector<Occurrence> expected = in_order(whole.find_all(p.begin(), p.end()));
+            EXPECT_EQ(expected, in_order(fork.find_all(p.begin(), p.end()))) << depth << ' ' << p;
+            EXPECT_EQ(expected, in_order(promoted.find_all(p.begin(), p.end()))) << depth << ' ' << p;
+        }
+    }
+}
@@ -0,0 +1,289 @@
+// The other indexes (enhanced suffix array, FM-index, compressed suffix tree,
+// suffix automaton, lazy suffix tree) against brute force
+
+#include "suffixtree.h"
+#include "enhancedsuffixarray.h"
+#include "fmindex.h"
+#include "compressedsuffixtree.h"
+#include "suffixautomaton.h"
+#include "lazysuffixtree.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using bruteforce::Occurrence;
+using bruteforce::Strings;
+
+typedef SuffixTree<char> Tree;
+typedef EnhancedSuffixArray<char> ESA;
+
+namespace {
+
+// A random collection, the tree holding it and the expected occurrences of
+// random patterns
+struct Fixture {
+    std::vector<std::string> texts;
+    Strings strings;
+    Tree tree;
+    std::vector<std::string> patterns;
+
+    Fixture(unsigned seed, int sigma) {
+        std::mt19937 rng(seed);
+        texts = bruteforce::random_strings(rng, 10, 120, sigma);
+        for (auto const & s : texts) {
+            strings[tree.add_string(s.begin(), s.end())] = s;
+        }
+        patterns = bruteforce::patterns(rng, texts, 150, sigma);
+    }
+};
+
+// The count and find_all of @index on the patterns of @f
+template <typename Index>
+void expect_occurrences(Index const & index, Fixture const & f) {
+    for (auto const & p : f.patterns) {
+        std::vector<Occurrence> expected = bruteforce::occurrences(f.strings, p);
+        EXPECT_EQ(expected.size(), index.count(p.begin(), p.end())) << p;
+        EXPECT_EQ(expected, bruteforce::sorted(index.find_all(p.begin(), p.end()))) << p;
+        EXPECT_EQ(!expected.empty(), index.is_substring(p.begin(), p.end())) << p;
+    }
+}
+
+} // namespace
+
+TEST(EnhancedSuffixArray, FromTreeAndFromStrings) {
+    for (int sigma : {1, 2, 4}) {
+        Fixture f(10 + sigma, sigma);
+        ESA from_tree(f.tree);
+        expect_occurrences(from_tree, f);
+        ESA from_strings;
+        for (auto const & s : f.texts) {
+            from_strings.add_string(s.begin(), s.end());
+        }
+        from_strings.build();
+        expect_occurrences(from_strings, f);
+        EXPECT_EQ(from_tree.get_suffix_array(), from_strings.get_suffix_array());
+    }
+}
+
+TEST(EnhancedSuffixArray, FollowsTheRulesOfTheTree) {
+    std::mt19937 rng(5);
+    for (int round = 0; round < 50; ++round) {
+        Tree tree;
+        ESA esa;
+        for (int i = 0; i < 12; ++i) {
+            std::string s = bruteforce::random_string(rng, rng() % 6, 2);
+            EXPECT_EQ(tree.add_string(s.begin(), s.end()), esa.add_string(s.begin(), s.end())) << s;
+            // The strings of earlier builds are checked on the suffix array,
+            // the others on the pending strings, in a moved index too
+            if (0 == i % 4) {
+                esa.build();
+            } else if (5 == i) {
+                ESA moved(std::move(esa));
+                esa = std::move(moved);
+            }
+        }
+        esa.build();
+        EXPECT_EQ(tree.string_ids(), esa.string_ids());
+        std::string p = "ab";
+        EXPECT_EQ(bruteforce::sorted(tree.find_all(p.begin(), p.end())),
+                  bruteforce::sorted(esa.find_all(p.begin(), p.end())));
+    }
+}
+
+TEST(EnhancedSuffixArray, RejectsTheEndToken) {
+    ESA esa;
+    std::string s = "abc", p = "c$";
+    esa.add_string(s.begin(), s.end());
+    esa.build();
+    EXPECT_THROW(esa.count(p.begin(), p.end()), std::invalid_argument);
+    EXPECT_THROW(esa.find_all(p.begin(), p.end()), std::invalid_argument);
+    EXPECT_THROW(esa.is_substring(p.begin(), p.end()), std::invalid_argument);
+    EXPECT_THROW(esa.is_suffix(p.begin(), p.end()), std::invalid_argument);
+}
+
+TEST(FMIndex, FromTreeAndFromEnhancedSuffixArray) {
+    for (int sigma : {1, 2, 4}) {
+        Fixture f(20 + sigma, sigma);
+        for (bool parallel : {false, true}) {
+            FMIndex<char> fm(f.tree, 4, parallel);
+            expect_occurrences(fm, f);
+        }
+        FMIndex<char> fm(ESA(f.tree), 7);
+        expect_occurrences(fm, f);
+    }
+}
+
+TEST(FMIndex, RejectsTheEndToken) {
+    Tree tree;
+    std::string s = "abc", p = "c$";
+    tree.add_string(s.begin(), s.end());
+    FMIndex<char> fm(tree);
+    EXPECT_THROW(fm.count(p.begin(), p.end()), std::invalid_argument);
+    EXPECT_THROW(fm.find_all(p.begin(), p.end()), std::invalid_argument);
+    EXPECT_THROW(fm.is_substring(p.begin(), p.end()), std::invalid_argument);
+}
+
+TEST(CompressedSuffixTree, LocusCoversTheOccurrences) {
+    for (int sigma : {1, 2, 4}) {
+        Fixture f(30 + sigma, sigma);
+        CompressedSuffixTree<char> cst(f.tree, 8);
+        // A copy: EXPECT_EQ takes references, and the constant has no definition
+        const auto no_node = CompressedSuffixTree<char>::no_node;
+        for (auto const & p : f.patterns) {
+            std::vector<Occurrence> expected = bruteforce::occurrences(f.strings, p);
+            auto v = cst.locus(p.begin(), p.end());
+            if (expected.empty()) {
+                EXPECT_EQ(no_node, v) << p;
+                continue;
+            }
+            ASSERT_NE(no_node, v) << p;
+            EXPECT_EQ(expected.size(), cst.leaf_count(v)) << p;
+            std::vector<Tree::SuffixEntry> found;
+            for (auto row = cst.lb(v); row <= cst.rb(v); ++row) {
+                found.push_back(cst.suffix(cst.leaf(row)));
+            }
+            EXPECT_EQ(expected, bruteforce::sorted(found)) << p;
+            EXPECT_GE(cst.string_depth(v), Tree::index_type(p.size())) << p;
+        }
+        CompressedSuffixTree<char> from_strings(f.texts.begin(), f.texts.end(), 8);
+        EXPECT_EQ(cst.size(), from_strings.size());
+    }
+}
+
+TEST(SuffixAutomaton, CountsMatchBruteForce) {
+    for (int sigma : {1, 2, 4}) {
+        Fixture f(40 + sigma, sigma);
+        SuffixAutomaton<char> sam;
+        for (auto const & s : f.texts) {
+            sam.add_string(s.begin(), s.end());
+        }
+        for (auto const & p : f.patterns) {
+            std::size_t expected = bruteforce::occurrences(f.strings, p).size();
+            EXPECT_EQ(expected, sam.count(p.begin(), p.end())) << p;
+            EXPECT_EQ(expected > 0, sam.is_substring(p.begin(), p.end())) << p;
+        }
+    }
+}
+
+TEST(LazySuffixTree, QueriesMatchBruteForce) {
+    for (int sigma : {1, 2, 4}) {
+        Fixture f(50 + sigma, sigma);
+        LazySuffixTree<char> lazy;
+        for (auto const & s : f.texts) {
+            lazy.add_string(s.begin(), s.end());
+        }
+        expect_occurrences(lazy, f);
+    }
+}
+
+TEST(LazySuffixTree, AddsBetweenQueries) {
+    std::mt19937 rng(6);
+    LazySuffixTree<char> lazy;
+    Strings strings;
+    for (int i = 0; i < 6; ++i) {
+        std::string s = bruteforce::random_string(rng, 50, 2);
+        strings[lazy.add_string(s.begin(), s.end())] = s;
+        std::string p = s.substr(rng() % 40, 3);
+        EXPECT_EQ(bruteforce::occurrences(strings, p), bruteforce::sorted(lazy.find_all(p.begin(), p.end())));
+    }
+}
+
+TEST(LazySuffixTree, FollowsTheRulesOfTheTree) {
+    std::mt19937 rng(7);
+    for (int round = 0; round < 50; ++round) {
+        Tree tree;
+        LazySuffixTree<char> lazy;
+        for (int i = 0; i < 12; ++i) {
+            std::string s = bruteforce::random_string(rng, rng() % 6, 2);
+            EXPECT_EQ(tree.add_string(s.begin(), s.end()), lazy.add_string(s.begin(), s.end())) << s;
+        }
+        EXPECT_EQ(tree.string_ids(), lazy.string_ids());
+        // The empty pattern occurs at every suffix
+        std::string empty;
+        EXPECT_EQ(tree.count(empty.begin(), empty.end()), lazy.count(empty.begin(), empty.end()));
+        EXPECT_EQ(bruteforce::sorted(tree.find_all(empty.begin(), empty.end())),
+                  bruteforce::sorted(lazy.find_all(empty.begin(), empty.end())));
+    }
+}
+
+// Threads querying a tree no query expanded yet race on the expansion of
+// the same nodes
+TEST(LazySuffixTree, ConcurrentQueriesOnAColdTree) {
+    for (int sigma : {1, 2, 4}) {
+        Fixture f(60 + sigma, sigma);
+        LazySuffixTree<char> whole;
+        for (auto const & s : f.texts) {
+            whole.add_string(s.begin(), s.end());
+        }
+        whole.expand_all();
+        for (int round = 0; round < 4; ++round) {
+            LazySuffixTree<char> lazy;
+            for (auto const & s : f.texts) {
+                lazy.add_string(s.begin(), s.end());
+            }
+            std::atomic<std::size_t> mismatches(0);
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < 4; ++t) {
+                threads.push_back(std::thread([&f, &lazy, &mismatches, t]() {
+                    // Each thread starts at another pattern
+                    for (std::size_t k = 0; k < f.patterns.size(); ++k) {
+                        std::string const & p = f.patterns[(k + t * 37) % f.patterns.size()];
+                        std::vector<Occurrence> expected = bruteforce::occurrences(f.strings, p);
+                        if (expected.size() != lazy.count(p.begin(), p.end()) ||
+                                expected != bruteforce::sorted(lazy.find_all(p.begin(), p.end()))) {
+                            ++mismatches;
+                        }
+                    }
+                }));
+            }
+            for (auto & t : threads) {
+                t.join();
+            }
+            EXPECT_EQ(0u, mismatches.load());
+            // A node is expanded once, whichever thread got there first: the
+            // whole tree has the nodes of one expanded by a single thread
+            lazy.expand_all();
+            EXPECT_EQ(whole.node_count(), lazy.node_count());
+            EXPECT_EQ(whole.expanded_count(), lazy.expanded_count());
+        }
+    }
+}
+
+// The walks of the lazy tree are iterative: a path 20000 nodes deep (a
+// string of one letter, quadratic to expand top-down, hence not longer) is
+// queried on a thread with a 256 KiB stack
+TEST(LazySuffixTree, DeepPathsDoNotOverflowTheStack) {
+    std::string s(20000, 'a');
+    LazySuffixTree<char> lazy;
+    lazy.add_string(s.begin(), s.end());
+    struct Query {
+        LazySuffixTree<char> const *lazy;
+        std::size_t count;
+        std::size_t found;
+        static void *run(void *arg) {
+            Query *q = static_cast<Query*>(arg);
+            std::string p = "a";
+            q->count = q->lazy->count(p.begin(), p.end());
+            q->found = q->lazy->find_all(p.begin(), p.end()).size();
+            return nullptr;
+        }
+    } query = {&lazy, 0, 0};
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, &attr, &Query::run, &query));
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+    EXPECT_EQ(s.size(), query.count);
+    EXPECT_EQ(s.size(), query.found);
+}
@@ -0,0 +1,58 @@
+// memory_usage against the allocations a counting resource sees
+
+#include "suffixtree.h"
+#include "memoryresource.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+typedef SuffixTree<char, '$', ResourceAllocator<char>> ResourceTree;
+
+namespace {
+
+// The heap part of a memory_usage (the tree object is not allocated)
+template <typename MemoryUsage>
+std::size_t heap_bytes(MemoryUsage const & m) {
+    return m.total() - m.tree;
+}
+
+} // namespace
+
+// The counters follow the insertions: the estimate stays within 3% of the
+// bytes the tree holds, for full and truncated trees over small and large
+// alphabets
+TEST(MemoryUsage, MatchesTheAllocations) {
+    std::mt19937 rng(1);
+    for (ResourceTree::index_type depth : {0, 5}) {
+        for (int sigma : {2, 4, 26}) {
+            CountingResource resource;
+            {
+                ResourceTree tree = depth > 0 ? ResourceTree(depth, &resource) : ResourceTree(&resource);
+                for (auto const & s : bruteforce::random_strings(rng, 30, 300, sigma)) {
+                    tree.add_string(s.begin(), s.end());
+                    auto m = tree.memory_usage();
+                    double in_use = resource.bytes_in_use();
+                    EXPECT_NEAR(in_use, heap_bytes(m), 0.03 * in_use) << depth << ' ' << sigma;
+                    EXPECT_LE(m.allocations, resource.allocations());
+                }
+                auto m = tree.memory_usage();
+                EXPECT_GE(m.text / sizeof(char), m.input_characters + tree.string_ids().size());
+                // Truncated trees are not built with suffix links
+                EXPECT_EQ(0 == depth, m.suffix_link_count > 0);
+            }
+            EXPECT_EQ(0u, resource.bytes_in_use());
+        }
+    }
+}
+
+TEST(MemoryUsage, EmptyTree) {
+    CountingResource resource;
+    ResourceTree tree(&resource);
+    auto m = tree.memory_usage();
+    EXPECT_EQ(0u, m.nodes + m.leaves + m.suffix_lists + m.text + m.input_characters);
+    EXPECT_NEAR(double(resource.bytes_in_use()), double(heap_bytes(m)), 64.0);
+}
@@ -0,0 +1,196 @@
+// LatencyHistogram, the metrics and tracers of a tree, and their Prometheus
+// output
+
+#include "suffixtree.h"
+#include "metrics.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+typedef SuffixTree<char> Tree;
+
+namespace {
+
+// Records the calls of a tree, checking they come in begin/end pairs
+struct RecordingTracer : public BuildTracer {
+    std::map<int, std::vector<BuildPhase>> phases;
+    std::vector<BuildPhase> open;
+    bool paired = true;
+    void begin(BuildPhase phase, int string_id) override {
+        paired = paired && open.empty();
+        open.push_back(phase);
+        phases[string_id].push_back(phase);
+    }
+    void end(BuildPhase phase, int) override {
+        paired = paired && !open.empty() && open.back() == phase;
+        open.clear();
+    }
+};
+
+// The value of a sample line of a Prometheus output
+double sample(std::string const & text, std::string const & series) {
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (0 == line.compare(0, series.size() + 1, series + " ")) {
+            return std::stod(line.substr(series.size() + 1));
+        }
+    }
+    ADD_FAILURE() << "no sample " << series << " in\n" << text;
+    return -1;
+}
+
+} // namespace
+
+TEST(LatencyHistogram, PercentilesWithinABucket) {
+    std::unique_ptr<LatencyHistogram> h(new LatencyHistogram());
+    EXPECT_EQ(0u, h->percentile(0.5));
+    // Below sub_buckets, values are exact
+    for (std::uint64_t v = 0; v < 10; ++v) {
+        h->record(v);
+    }
+    EXPECT_EQ(10u, h->count());
+    EXPECT_EQ(45u, h->sum());
+    EXPECT_EQ(0u, h->percentile(0));
+    EXPECT_EQ(5u, h->percentile(0.5));
+    EXPECT_EQ(9u, h->percentile(1));
+
+    // Above, a percentile is the floor of its bucket: within 1/16 below
+    std::mt19937_64 rng(1);
+    std::vector<std::uint64_t> values;
+    h->reset();
+    EXPECT_EQ(0u, h->count());
+    for (int i = 0; i < 10000; ++i) {
+        values.push_back(rng() % (std::uint64_t(1) << (1 + rng() % 39)));
+        h->record(values.back());
+    }
+    std::sort(values.begin(), values.end());
+    for (double q : {0.1, 0.5, 0.9, 0.99, 0.999}) {
+        std::uint64_t exact = values[static_cast<std::size_t>(q * values.size())];
+        std::uint64_t p = h->percentile(q);
+        EXPECT_LE(p, exact) << q;
+        EXPECT_GE(p, exact - exact / LatencyHistogram::sub_buckets) << q;
+    }
+
+    // Durations past the range go to the last bucket
+    h->reset();
+    h->record(std::uint64_t(1) << 50);
+    EXPECT_LT(h->percentile(0.5), std::uint64_t(1) << 50);
+    EXPECT_GE(h->percentile(0.5), std::uint64_t(1) << LatencyHistogram::max_exponent);
+}
+
+TEST(LatencyHistogram, ThreadsRecordIntoTheSameHistogram) {
+    std::unique_ptr<LatencyHistogram> h(new LatencyHistogram());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([&h, t]() {
+            for (int i = 0; i < 1000; ++i) {
+                h->record(t + 1);
+            }
+        }));
+    }
+    for (auto & t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(4000u, h->count());
+    EXPECT_EQ(10000u, h->sum());
+    EXPECT_EQ(2u, h->percentile(0.3));
+}
+
+TEST(QueryMetrics, TimesEachOperation) {
+    std::unique_ptr<QueryMetrics> metrics(new QueryMetrics());
+    Tree tree;
+    tree.set_metrics(metrics.get());
+    std::mt19937 rng(2);
+    std::vector<std::string> texts = bruteforce::random_strings(rng, 5, 50, 3);
+    for (auto const & s : texts) {
+        tree.add_string(s.begin(), s.end());
+    }
+    std::string p = "ab";
+    for (int i = 0; i < 3; ++i) {
+        tree.is_substring(p.begin(), p.end());
+        tree.count(p.begin(), p.end());
+    }
+    tree.find_all(p.begin(), p.end());
+    EXPECT_EQ(5u, metrics->histogram(Operation::add_string).count());
+    EXPECT_EQ(3u, metrics->histogram(Operation::is_substring).count());
+    EXPECT_EQ(3u, metrics->histogram(Operation::count).count());
+    EXPECT_EQ(1u, metrics->histogram(Operation::find_all).count());
+
+    std::ostringstream out;
+    write_prometheus(out, *metrics);
+    std::string text = out.str();
+    EXPECT_EQ(0u, text.find("# HELP suffixtree_operation_latency_seconds "));
+    EXPECT_EQ(3, sample(text, "suffixtree_operation_latency_seconds_count{operation=\"count\"}"));
+    EXPECT_EQ(5, sample(text, "suffixtree_operation_latency_seconds_count{operation=\"add_string\"}"));
+    EXPECT_NEAR(metrics->histogram(Operation::add_string).sum() * 1e-9,
+                sample(text, "suffixtree_operation_latency_seconds_sum{operation=\"add_string\"}"), 1e-6);
+    EXPECT_GE(sample(text, "suffixtree_operation_latency_seconds{operation=\"find_all\",quantile=\"0.5\"}"), 0);
+
+    tree.set_metrics(nullptr);
+    tree.count(p.begin(), p.end());
+    EXPECT_EQ(3u, metrics->histogram(Operation::count).count());
+    metrics->reset();
+    EXPECT_EQ(0u, metrics->histogram(Operation::add_string).count());
+}
+
+TEST(BuildTracer, SeesThePhasesOfEachString) {
+    std::string hello = "hello", llo = "llo", help = "help";
+    RecordingTracer tracer;
+    Tree tree;
+    tree.set_tracer(&tracer);
+    EXPECT_EQ(1, tree.add_string(hello.begin(), hello.end()));
+    EXPECT_EQ(-1, tree.add_string(llo.begin(), llo.end()));
+    EXPECT_EQ(2, tree.add_string(help.begin(), help.end()));
+    EXPECT_TRUE(tracer.paired);
+    std::vector<BuildPhase> ukkonen {BuildPhase::text_ingestion, BuildPhase::descent,
+                                     BuildPhase::insertion, BuildPhase::post_processing};
+    EXPECT_EQ(ukkonen, tracer.phases[1]);
+    // A rejected string is traced under the id it would have had, up to the
+    // descent that finds it in the tree
+    std::vector<BuildPhase> rejected_then_added {BuildPhase::text_ingestion, BuildPhase::descent};
+    rejected_then_added.insert(rejected_then_added.end(), ukkonen.begin(), ukkonen.end());
+    EXPECT_EQ(rejected_then_added, tracer.phases[2]);
+
+    RecordingTracer truncated_tracer;
+    Tree truncated(3);
+    truncated.set_tracer(&truncated_tracer);
+    truncated.add_string(hello.begin(), hello.end());
+    truncated.add_string(llo.begin(), llo.end());
+    EXPECT_TRUE(truncated_tracer.paired);
+    std::vector<BuildPhase> top_down {BuildPhase::text_ingestion, BuildPhase::insertion};
+    EXPECT_EQ(top_down, truncated_tracer.phases[1]);
+    EXPECT_EQ(top_down, truncated_tracer.phases[2]);
+}
+
+TEST(PhaseTimes, CountsThePhasesAndWritesThem) {
+    PhaseTimes times;
+    Tree tree;
+    tree.set_tracer(&times);
+    std::mt19937 rng(3);
+    for (auto const & s : bruteforce::random_strings(rng, 4, 200, 2)) {
+        tree.add_string(s.begin(), s.end());
+    }
+    EXPECT_EQ(4u, times.count(BuildPhase::text_ingestion));
+    EXPECT_EQ(4u, times.count(BuildPhase::insertion));
+    EXPECT_EQ(4u, times.count(BuildPhase::post_processing));
+
+    std::ostringstream out;
+    write_prometheus(out, times);
+    std::string text = out.str();
+    EXPECT_EQ(4, sample(text, "suffixtree_build_phase_calls_total{phase=\"descent\"}"));
+    EXPECT_NEAR(times.total(BuildPhase::insertion) * 1e-9,
+                sample(text, "suffixtree_build_phase_seconds_total{phase=\"insertion\"}"), 1e-6);
+    EXPECT_NE(std::string::npos, text.find("# TYPE suffixtree_build_phase_calls_total counter\n"));
+}
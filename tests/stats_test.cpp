@@ -0,0 +1,70 @@
+// ConstructionStats, in a build of its own with SUFFIXTREE_INSTRUMENTATION
+// defined (the other tests use the counter-free tree)
+
+#include "suffixtree.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifndef SUFFIXTREE_INSTRUMENTATION
+#error "stats_test.cpp needs SUFFIXTREE_INSTRUMENTATION"
+#endif
+
+typedef SuffixTree<char> Tree;
+
+TEST(ConstructionStats, CountsTheUkkonenSteps) {
+    Tree tree;
+    std::string s = "banana";
+    std::ostringstream out;
+    {
+        ConstructionStatsBatch batch(out);
+        tree.add_string(s.begin(), s.end());
+        ConstructionStats const & stats = construction_stats();
+        // banana$: 7 phases and leaves; a, ana and na split edges; the
+        // phases of the second a, n and a end at the end point
+        EXPECT_EQ(7u, stats.phases);
+        EXPECT_EQ(7u, stats.leaves);
+        EXPECT_EQ(3u, stats.splits);
+        EXPECT_EQ(3u, stats.endpoint_hits);
+        EXPECT_EQ(3u, stats.max_active_depth);
+    }
+    EXPECT_EQ(0u, out.str().find("splits=3 leaves=7 "));
+}
+
+TEST(ConstructionStats, MatchTheShapeOfTheTree) {
+    std::mt19937 rng(1);
+    for (int sigma : {1, 2, 4}) {
+        Tree tree;
+        construction_stats().reset();
+        for (auto const & s : bruteforce::random_strings(rng, 20, 200, sigma)) {
+            tree.add_string(s.begin(), s.end());
+        }
+        Tree::TreeStats shape = tree.tree_stats();
+        EXPECT_EQ(shape.leaves, construction_stats().leaves);
+        // Every internal node but the root comes from a split
+        EXPECT_EQ(shape.internal_nodes - 1, construction_stats().splits);
+        EXPECT_LE(construction_stats().endpoint_hits, construction_stats().phases);
+        construction_stats().reset();
+        EXPECT_EQ(0u, construction_stats().leaves);
+        EXPECT_EQ(0u, construction_stats().phases);
+    }
+}
+
+TEST(ConstructionStats, EachThreadCountsItsOwnTrees) {
+    construction_stats().reset();
+    std::uint64_t leaves = 0;
+    std::thread builder([&leaves]() {
+        Tree tree;
+        std::string s = "mississippi";
+        tree.add_string(s.begin(), s.end());
+        leaves = construction_stats().leaves;
+    });
+    builder.join();
+    EXPECT_EQ(12u, leaves);
+    EXPECT_EQ(0u, construction_stats().leaves);
+}
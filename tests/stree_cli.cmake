@@ -0,0 +1,41 @@
+# Builds an index with the stree tool and queries it, comparing the answers
+# with the expected ones
+#
+#   cmake -DSTREE=path/to/stree -DWORK_DIR=dir -P stree_cli.cmake
+
+if(NOT STREE OR NOT WORK_DIR)
+    message(FATAL_ERROR "usage: cmake -DSTREE=... -DWORK_DIR=... -P stree_cli.cmake")
+endif()
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# Records 1 and 3 are suffixes of record 0, record 4 holds the end token
+file(WRITE ${WORK_DIR}/records.txt "banana\nbandana\nnana\nbanana\nba$\n")
+file(WRITE ${WORK_DIR}/patterns.txt "ana\nband\nx\nna\n")
+
+function(run_stree expected)
+    execute_process(COMMAND ${STREE} ${ARGN}
+        INPUT_FILE ${WORK_DIR}/patterns.txt
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE errors
+        RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "stree ${ARGN} failed (${status}): ${errors}")
+    endif()
+    if(NOT output STREQUAL expected)
+        message(FATAL_ERROR "stree ${ARGN}: expected\n${expected}got\n${output}")
+    endif()
+endfunction()
+
+foreach(shards 1 2)
+    set(index ${WORK_DIR}/index${shards}.stix)
+    run_stree("" build -o ${index} --shards ${shards} ${WORK_DIR}/records.txt)
+    run_stree("1\n1\n0\n1\n" query -i ${index})
+    run_stree("6\n1\n0\n7\n" query -i ${index} --count)
+    run_stree("0:1 0:3 1:4\n1:0\n\n0:2 0:4 1:5\n"
+        query -i ${index} --find --limit 3)
+    # No limit, or a limit of 0 as in the server protocol: every occurrence
+    foreach(limit "" "--limit;0")
+        run_stree("0:1 0:3 1:4 2:1 3:1 3:3\n1:0\n\n0:2 0:4 1:5 2:0 2:2 3:2 3:4\n"
+            query -i ${index} --find ${limit})
+    endforeach()
+endforeach()
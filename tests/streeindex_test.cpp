@@ -0,0 +1,190 @@
+// StreeIndex (the index of the stree tools) against brute force over its
+// records, and the answers of answer_batch
+
+#include "streeindex.h"
+#include "bufferedreader.h"
+#include "bufferedwriter.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::pair<std::uint64_t, std::uint64_t> Found;
+
+// Records with duplicates, suffixes of other records, empty records and
+// records holding the end token
+std::vector<std::string> make_records(unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> records;
+    for (int i = 0; i < 60; ++i) {
+        switch (rng() % 6) {
+        case 0:
+            if (!records.empty()) {
+                records.push_back(records[rng() % records.size()]);
+                break;
+            }
+            // Fall through
+        case 1:
+            if (!records.empty()) {
+                std::string const & r = records[rng() % records.size()];
+                records.push_back(r.substr(rng() % (r.size() + 1)));
+                break;
+            }
+            // Fall through
+        default:
+            records.push_back(bruteforce::random_string(rng, rng() % 30, 3));
+            break;
+        }
+    }
+    records.push_back("");
+    records.push_back("ab$c");
+    return records;
+}
+
+std::vector<Found> expected_occurrences(std::vector<std::string> const & records, std::string const & p) {
+    std::vector<Found> result;
+    if (p.empty() || std::string::npos != p.find('$')) {
+        return result;
+    }
+    for (std::size_t r = 0; r < records.size(); ++r) {
+        if (std::string::npos != records[r].find('$')) {
+            continue;
+        }
+        for (std::size_t i = 0; i + p.size() <= records[r].size(); ++i) {
+            if (0 == records[r].compare(i, p.size(), p)) {
+                result.push_back(Found(r, i));
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> make_patterns(std::vector<std::string> const & records, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> texts;
+    for (auto const & r : records) {
+        if (std::string::npos == r.find('$')) {
+            texts.push_back(r);
+        }
+    }
+    std::vector<std::string> patterns = bruteforce::patterns(rng, texts, 300, 3);
+    patterns.push_back("");
+    patterns.push_back("a$");
+    return patterns;
+}
+
+void expect_queries(StreeIndex const & index, std::vector<std::string> const & records,
+                    std::vector<std::string> const & patterns) {
+    std::vector<StreeIndex::Occurrence> found;
+    for (auto const & p : patterns) {
+        std::vector<Found> expected = expected_occurrences(records, p);
+        EXPECT_EQ(!expected.empty(), index.contains(p)) << p;
+        EXPECT_EQ(expected.size(), index.count(p)) << p;
+        index.find_all(p, &found);
+        std::vector<Found> actual;
+        for (auto const & o : found) {
+            actual.push_back(Found(o.record, o.offset));
+        }
+        EXPECT_EQ(expected, actual) << p;
+    }
+}
+
+} // namespace
+
+TEST(StreeIndex, QueriesMatchBruteForce) {
+    std::vector<std::string> records = make_records(1);
+    std::vector<std::string> patterns = make_patterns(records, 2);
+    std::uint64_t skipped = 0;
+    for (auto const & r : records) {
+        skipped += r.empty() || std::string::npos != r.find('$');
+    }
+    for (std::size_t shards = 1; shards <= 3; ++shards) {
+        for (StreeIndex::Tree::index_type depth : {0, 3, 8}) {
+            StreeIndex index;
+            index.build(records, shards, depth);
+            EXPECT_EQ(records.size(), index.record_count());
+            EXPECT_EQ(shards, index.shard_count());
+            EXPECT_EQ(skipped, index.skipped_count());
+            if (0 == depth) {
+                EXPECT_GT(index.dropped_count(), 0u);
+            } else {
+                // Truncated trees keep every record
+                EXPECT_EQ(0u, index.dropped_count());
+                EXPECT_TRUE(index.shard(0).is_truncated());
+            }
+            expect_queries(index, records, patterns);
+            EXPECT_THROW(index.build(records, shards, depth), std::logic_error);
+        }
+    }
+}
+
+TEST(StreeIndex, SaveLoadRoundTrips) {
+    std::vector<std::string> records = make_records(3);
+    std::vector<std::string> patterns = make_patterns(records, 4);
+    for (StreeIndex::Tree::index_type depth : {0, 5}) {
+        StreeIndex index;
+        index.build(records, 3, depth);
+        std::string bytes;
+        {
+            BufferedWriter out(&bytes);
+            index.save(out);
+        }
+        StreeIndex loaded;
+        BufferedReader in(&bytes);
+        loaded.load(in, 2);
+        EXPECT_EQ(index.record_count(), loaded.record_count());
+        EXPECT_EQ(index.character_count(), loaded.character_count());
+        EXPECT_EQ(index.dropped_count(), loaded.dropped_count());
+        EXPECT_EQ(index.skipped_count(), loaded.skipped_count());
+        EXPECT_EQ(index.shard_count(), loaded.shard_count());
+        expect_queries(loaded, records, patterns);
+    }
+    std::string garbage = "STIX";
+    garbage.push_back(1);
+    BufferedReader bad(&garbage);
+    StreeIndex index;
+    EXPECT_THROW(index.load(bad), std::runtime_error);
+}
+
+TEST(StreeIndex, AnswerBatch) {
+    std::vector<std::string> records = make_records(5);
+    std::vector<std::string> patterns = make_patterns(records, 6);
+    StreeIndex index;
+    index.build(records, 2);
+    const std::size_t limit = 3;
+    std::ostringstream exists, count, find, find_all;
+    for (auto const & p : patterns) {
+        std::vector<Found> expected = expected_occurrences(records, p);
+        exists << (expected.empty() ? '0' : '1') << '\n';
+        count << expected.size() << '\n';
+        for (std::size_t k = 0; k < expected.size(); ++k) {
+            if (k < limit) {
+                find << (k > 0 ? " " : "") << expected[k].first << ':' << expected[k].second;
+            }
+            find_all << (k > 0 ? " " : "") << expected[k].first << ':' << expected[k].second;
+        }
+        find << '\n';
+        find_all << '\n';
+    }
+    for (std::size_t threads : {1, 4}) {
+        std::string out;
+        answer_batch(index, patterns, QueryMode::exists, limit, threads, &out);
+        EXPECT_EQ(exists.str(), out);
+        answer_batch(index, patterns, QueryMode::count, limit, threads, &out);
+        EXPECT_EQ(count.str(), out);
+        answer_batch(index, patterns, QueryMode::find, limit, threads, &out);
+        EXPECT_EQ(find.str(), out);
+        // No limit, as in the protocol
+        answer_batch(index, patterns, QueryMode::find, 0, threads, &out);
+        EXPECT_EQ(find_all.str(), out);
+    }
+}
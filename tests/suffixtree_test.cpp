@@ -0,0 +1,184 @@
+// SuffixTree queries and suffix array exports against brute force, for full,
+// truncated and sparse trees
+
+#include "suffixtree.h"
+#include "enhancedsuffixarray.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using bruteforce::Occurrence;
+using bruteforce::Strings;
+
+typedef SuffixTree<char> Tree;
+
+#ifndef SUFFIXTREE_INSTRUMENTATION
+static_assert(sizeof(ConstructionStatsBatch) == 1, "without the counters, a batch is empty");
+#endif
+
+namespace {
+
+// The queries of @tree, holding @strings, on random patterns
+void expect_queries(Tree const & tree, Strings const & strings, std::mt19937& rng, int sigma) {
+    std::vector<std::string> texts;
+    for (auto const & s : strings) {
+        texts.push_back(s.second);
+    }
+    for (auto const & p : bruteforce::patterns(rng, texts, 200, sigma)) {
+        std::vector<Occurrence> expected = bruteforce::occurrences(strings, p);
+        EXPECT_EQ(expected.size(), tree.count(p.begin(), p.end())) << p;
+        EXPECT_EQ(expected, bruteforce::sorted(tree.find_all(p.begin(), p.end()))) << p;
+        EXPECT_EQ(!expected.empty(), tree.is_substring(p.begin(), p.end())) << p;
+        if (!tree.is_truncated()) {
+            EXPECT_EQ(bruteforce::ends_string(strings, p), tree.is_suffix(p.begin(), p.end())) << p;
+        }
+    }
+}
+
+void expect_exports(Tree const & tree, Strings const & strings) {
+    std::vector<Occurrence> expected = bruteforce::suffix_array(strings);
+    for (bool parallel : {false, true}) {
+        std::vector<Tree::SuffixEntry> sa = tree.export_suffix_array(parallel);
+        std::vector<Tree::index_type> lcp = tree.export_lcp(parallel);
+        ASSERT_EQ(expected.size(), sa.size()) << "parallel " << parallel;
+        ASSERT_EQ(expected.size(), lcp.size()) << "parallel " << parallel;
+        for (std::size_t i = 0; i < sa.size(); ++i) {
+            EXPECT_EQ(expected[i], Occurrence(sa[i].ref_str, long(sa[i].offset))) << "row " << i;
+            if (i > 0) {
+                EXPECT_EQ(bruteforce::lcp(strings, expected[i - 1], expected[i]), long(lcp[i])) << "row " << i;
+            }
+        }
+    }
+}
+
+} // namespace
+
+TEST(SuffixTree, QueriesMatchBruteForce) {
+    std::mt19937 rng(1);
+    for (int sigma : {1, 2, 4, 26}) {
+        for (int round = 0; round < 20; ++round) {
+            Tree tree;
+            Strings strings;
+            for (int i = 0; i < 8; ++i) {
+                std::string s = bruteforce::random_string(rng, rng() % 40, sigma);
+                bool suffix = bruteforce::ends_string(strings, s);
+                int id = tree.add_string(s.begin(), s.end());
+                // A suffix of a string of the tree, and only that, is rejected
+                EXPECT_EQ(suffix, id < 0) << s;
+                if (id > 0) {
+                    strings[id] = s;
+                }
+            }
+            if (!strings.empty()) {
+                expect_queries(tree, strings, rng, sigma);
+            }
+        }
+    }
+}
+
+TEST(SuffixTree, SuffixArrayAndLcpExports) {
+    std::mt19937 rng(2);
+    for (int sigma : {1, 2, 4}) {
+        Tree tree;
+        Strings strings;
+        for (auto const & s : bruteforce::random_strings(rng, 12, 300, sigma)) {
+            strings[tree.add_string(s.begin(), s.end())] = s;
+        }
+        expect_exports(tree, strings);
+    }
+}
+
+TEST(SuffixTree, LongestCommonSubstring) {
+    std::mt19937 rng(5);
+    for (int sigma : {2, 4}) {
+        for (int round = 0; round < 20; ++round) {
+            Tree tree;
+            Strings strings;
+            for (auto const & s : bruteforce::random_strings(rng, 2 + rng() % 6, 30, sigma)) {
+                strings[tree.add_string(s.begin(), s.end())] = s;
+            }
+            for (std::size_t k = 0; k <= strings.size(); ++k) {
+                std::string expected = bruteforce::longest_common_substring(strings, 0 == k ? strings.size() : k);
+                Tree::SubstringEntry lcs = tree.longest_common_substring(k);
+                ASSERT_EQ(long(expected.size()), long(lcs.length)) << "k " << k;
+                EXPECT_EQ(expected, strings[lcs.ref_str].substr(lcs.offset, lcs.length)) << "k " << k;
+                EXPECT_EQ(lcs.length, EnhancedSuffixArray<char>(tree).longest_common_substring(k).length) << "k " << k;
+            }
+        }
+    }
+}
+
+TEST(SuffixTree, RejectsTheEndToken) {
+    Tree tree;
+    std::string s = "ab$c";
+    EXPECT_THROW(tree.add_string(s.begin(), s.end()), std::invalid_argument);
+    std::string t = "abc";
+    tree.add_string(t.begin(), t.end());
+    EXPECT_THROW(tree.count(s.begin(), s.end()), std::invalid_argument);
+    EXPECT_THROW(tree.find_all(s.begin(), s.end()), std::invalid_argument);
+}
+
+TEST(TruncatedSuffixTree, QueriesMatchBruteForce) {
+    std::mt19937 rng(3);
+    for (Tree::index_type k = 1; k <= 6; ++k) {
+        for (int sigma : {1, 2, 4}) {
+            Tree tree(k);
+            Strings strings;
+            // Truncated trees keep every string, suffixes of others included
+            for (int i = 0; i < 8; ++i) {
+                std::string s = bruteforce::random_string(rng, 1 + rng() % 40, sigma);
+                strings[tree.add_string(s.begin(), s.end())] = s;
+            }
+            EXPECT_TRUE(tree.is_truncated());
+            EXPECT_EQ(k, tree.max_depth());
+            expect_queries(tree, strings, rng, sigma);
+        }
+    }
+}
+
+TEST(SparseSuffixTree, ReportsOnlyIndexedPositions) {
+    std::mt19937 rng(4);
+    for (int sigma : {1, 2, 4}) {
+        Tree tree;
+        Strings strings;
+        std::set<Occurrence> indexed;
+        for (auto const & s : bruteforce::random_strings(rng, 8, 60, sigma)) {
+            std::vector<Tree::index_type> positions;
+            for (std::size_t p = 0; p <= s.size(); ++p) {
+                if (rng() % 3 == 0) {
+                    positions.push_back(Tree::index_type(p));
+                }
+            }
+            int id = tree.add_string_sparse(s.begin(), s.end(), positions);
+            strings[id] = s;
+            for (auto p : positions) {
+                indexed.insert(Occurrence(id, long(p)));
+            }
+        }
+        EXPECT_TRUE(tree.is_sparse());
+        std::vector<std::string> texts;
+        for (auto const & s : strings) {
+            texts.push_back(s.second);
+        }
+        for (auto const & p : bruteforce::patterns(rng, texts, 200, sigma)) {
+            std::vector<Occurrence> expected;
+            for (auto const & o : bruteforce::occurrences(strings, p)) {
+                if (indexed.count(o)) {
+                    expected.push_back(o);
+                }
+            }
+            EXPECT_EQ(expected.size(), tree.count(p.begin(), p.end())) << p;
+            EXPECT_EQ(expected, bruteforce::sorted(tree.find_all(p.begin(), p.end()))) << p;
+        }
+        std::vector<Occurrence> sa = bruteforce::sorted(tree.export_suffix_array());
+        EXPECT_EQ(std::vector<Occurrence>(indexed.begin(), indexed.end()), sa);
+        std::string s = "abc";
+        EXPECT_THROW(tree.add_string(s.begin(), s.end()), std::logic_error);
+    }
+}
@@ -0,0 +1,388 @@
+// traverse, traverse_parallel, dump_tree, tree_stats and OccurrenceCursor:
+// the nodes a visitor sees against the suffixes of the strings
+
+#include "suffixtree.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using bruteforce::Occurrence;
+using bruteforce::Strings;
+
+typedef SuffixTree<char> Tree;
+
+namespace {
+
+// Records what a traversal shows: the path label of each node, built from
+// the edge labels, checked against the depths, and the suffixes on the
+// leaves in visiting order
+struct RecordingVisitor : public Tree::TreeVisitor {
+    Tree const *tree;
+    std::vector<std::string> path;
+    std::vector<std::string> labels;
+    std::vector<Occurrence> leaves;
+    std::vector<Tree::index_type> node_depths;
+    std::size_t open;
+    std::size_t internal_nodes;
+    bool consistent;
+    explicit RecordingVisitor(Tree const *t) : tree(t), open(0), internal_nodes(0), consistent(true) {}
+    bool pre(Tree::NodeInfo const & n) {
+        std::string label = path.empty() ? std::string() : path.back();
+        if (nullptr != n.parent) {
+            Tree::string const & s = tree->get_string(n.ref_str);
+            label.append(s.begin() + n.edge_l, s.begin() + n.edge_l + n.edge_length);
+        }
+        consistent = consistent && Tree::index_type(label.size()) == n.string_depth &&
+                     Tree::index_type(path.size()) == n.node_depth;
+        path.push_back(label);
+        labels.push_back(label);
+        node_depths.push_back(n.node_depth);
+        ++open;
+        if (n.is_leaf()) {
+            for (auto const & e : *n.suffixes) {
+                leaves.push_back(Occurrence(e.ref_str, long(e.offset)));
+                // The path of a leaf spells its suffixes
+                Tree::string const & s = tree->get_string(e.ref_str);
+                consistent = consistent && label == std::string(s.begin() + e.offset, s.end());
+            }
+        } else {
+            ++internal_nodes;
+        }
+        return true;
+    }
+    void post(Tree::NodeInfo const &) {
+        path.pop_back();
+        --open;
+    }
+};
+
+std::vector<Occurrence> sorted(std::vector<Occurrence> v) {
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+// The shape of the tree of @strings: the path labels of the nodes are the
+// distinct suffixes (end token included) and the substrings followed by
+// several symbols, the parent of a node is its longest proper prefix
+// among them
+struct BruteShape {
+    std::size_t internal_nodes;
+    std::size_t leaves;
+    std::size_t suffixes;
+    std::size_t total_edge_length;
+    std::size_t max_string_depth;
+    std::size_t alphabet;
+
+    explicit BruteShape(Strings const & strings) : suffixes(0), max_string_depth(0) {
+        std::map<std::string, std::set<char>> followers;
+        std::set<std::string> leaf_labels;
+        std::set<char> symbols {'$'};
+        for (auto const & s : strings) {
+            std::string t = s.second + '$';
+            symbols.insert(s.second.begin(), s.second.end());
+            for (std::size_t i = 0; i < t.size(); ++i) {
+                leaf_labels.insert(t.substr(i));
+                ++suffixes;
+                for (std::size_t j = i; j < t.size(); ++j) {
+                    followers[t.substr(i, j - i)].insert(t[j]);
+                }
+            }
+        }
+        std::set<std::string> labels = leaf_labels;
+        for (auto const & f : followers) {
+            if (f.second.size() > 1 || f.first.empty()) {
+                labels.insert(f.first);
+            }
+        }
+        leaves = leaf_labels.size();
+        internal_nodes = labels.size() - leaves;
+        alphabet = symbols.size();
+        total_edge_length = 0;
+        for (auto const & l : labels) {
+            max_string_depth = std::max(max_string_depth, l.size());
+            std::size_t parent = l.size();
+            while (parent > 0 && !labels.count(l.substr(0, --parent))) {
+            }
+            total_edge_length += l.size() - parent;
+        }
+    }
+};
+
+Tree make_tree(std::mt19937& rng, int sigma, Strings *strings) {
+    Tree tree;
+    for (auto const & s : bruteforce::random_strings(rng, 8, 60, sigma)) {
+        (*strings)[tree.add_string(s.begin(), s.end())] = s;
+    }
+    return tree;
+}
+
+} // namespace
+
+TEST(Traverse, VisitsEveryNodeOnce) {
+    std::mt19937 rng(1);
+    for (int sigma : {1, 2, 4}) {
+        Strings strings;
+        Tree tree = make_tree(rng, sigma, &strings);
+        Tree::TreeStats shape = tree.tree_stats();
+        for (bool ordered : {false, true}) {
+            RecordingVisitor v(&tree);
+            tree.traverse(v, Tree::TraversalOptions(Tree::TraversalOrder::depth_first, ordered));
+            EXPECT_TRUE(v.consistent);
+            EXPECT_EQ(0u, v.open);
+            EXPECT_EQ(shape.internal_nodes, v.internal_nodes);
+            EXPECT_EQ(shape.internal_nodes + shape.leaves, v.labels.size());
+            if (ordered) {
+                // Children in lexicographic order: the leaves come in suffix
+                // array order, up to the order of the suffixes of a leaf
+                std::vector<std::string> sorted_labels;
+                for (auto const & o : v.leaves) {
+                    sorted_labels.push_back(strings[o.first].substr(o.second));
+                }
+                EXPECT_TRUE(std::is_sorted(sorted_labels.begin(), sorted_labels.end()));
+            }
+            EXPECT_EQ(sorted(bruteforce::suffix_array(strings)), sorted(v.leaves));
+        }
+    }
+}
+
+TEST(Traverse, BreadthFirstAndPruning) {
+    std::mt19937 rng(2);
+    Strings strings;
+    Tree tree = make_tree(rng, 2, &strings);
+    struct Levels : public Tree::TreeVisitor {
+        std::vector<Tree::index_type> depths;
+        Tree::index_type limit;
+        explicit Levels(Tree::index_type l) : limit(l) {}
+        bool pre(Tree::NodeInfo const & n) {
+            depths.push_back(n.node_depth);
+            return n.node_depth < limit;
+        }
+    };
+    Levels all(std::numeric_limits<Tree::index_type>::max());
+    tree.traverse(all, Tree::TraversalOptions(Tree::TraversalOrder::breadth_first));
+    EXPECT_TRUE(std::is_sorted(all.depths.begin(), all.depths.end()));
+    RecordingVisitor dfs(&tree);
+    tree.traverse(dfs);
+    EXPECT_EQ(dfs.labels.size(), all.depths.size());
+
+    // Pruned below depth 2: the nodes of depth 0, 1 and 2 only
+    Levels pruned(2);
+    tree.traverse(pruned);
+    std::size_t shallow = std::count_if(dfs.node_depths.begin(), dfs.node_depths.end(),
+                                        [](Tree::index_type d) { return d <= 2; });
+    EXPECT_EQ(shallow, pruned.depths.size());
+    EXPECT_EQ(2, *std::max_element(pruned.depths.begin(), pruned.depths.end()));
+}
+
+TEST(Traverse, ParallelVisitorsCoverTheRootSubtrees) {
+    std::mt19937 rng(3);
+    Strings strings;
+    Tree tree = make_tree(rng, 4, &strings);
+    RecordingVisitor whole(&tree);
+    tree.traverse(whole);
+    std::vector<RecordingVisitor> parts = tree.traverse_parallel([&tree]() { return RecordingVisitor(&tree); });
+    std::vector<Occurrence> leaves;
+    std::size_t nodes = 0;
+    for (auto const & v : parts) {
+        EXPECT_EQ(0u, v.open);
+        nodes += v.labels.size();
+        leaves.insert(leaves.end(), v.leaves.begin(), v.leaves.end());
+    }
+    // The root is not visited
+    EXPECT_EQ(whole.labels.size() - 1, nodes);
+    EXPECT_EQ(sorted(whole.leaves), sorted(leaves));
+}
+
+// The traversal stack is on the heap: a path 100000 nodes deep is walked on
+// a thread with a 256 KiB stack
+TEST(Traverse, DeepTreesDoNotOverflowTheStack) {
+    std::string s(100000, 'a');
+    Tree tree;
+    tree.add_string(s.begin(), s.end());
+    struct Walk {
+        Tree const *tree;
+        std::size_t nodes;
+        static void *run(void *arg) {
+            Walk *w = static_cast<Walk*>(arg);
+            struct Count : public Tree::TreeVisitor {
+                std::size_t n = 0;
+                bool pre(Tree::NodeInfo const &) {
+                    ++n;
+                    return true;
+                }
+            } count;
+            w->tree->traverse(count);
+            w->nodes = count.n;
+            return nullptr;
+        }
+    } walk = {&tree, 0};
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, &attr, &Walk::run, &walk));
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+    // a^k for k < 100000 are internal nodes, with the root; one leaf per
+    // suffix
+    EXPECT_EQ(2 * s.size() + 1, walk.nodes);
+}
+
+TEST(TreeStats, Banana) {
+    Tree tree;
+    std::string s = "banana";
+    tree.add_string(s.begin(), s.end());
+    Tree::TreeStats shape = tree.tree_stats();
+    // The root, a, ana and na; one leaf per suffix
+    EXPECT_EQ(4u, shape.internal_nodes);
+    EXPECT_EQ(7u, shape.leaves);
+    EXPECT_EQ(7u, shape.suffixes);
+    EXPECT_EQ(4u, shape.alphabet);
+    EXPECT_EQ(7, shape.max_string_depth);
+    EXPECT_EQ(3, shape.max_node_depth);
+    EXPECT_EQ(22u, shape.total_edge_length);
+    // The root has 4 children, the others 2
+    EXPECT_EQ((std::vector<std::size_t> {0, 0, 3, 0, 1}), shape.branching);
+    EXPECT_EQ(2u, shape.branching_percentile(0.5));
+    EXPECT_EQ(4u, shape.branching_percentile(1));
+    EXPECT_EQ(3u, shape.suffix_links);
+    EXPECT_EQ(0u, shape.missing_suffix_links);
+    // String depths in buckets 0 (the root), 1 ($, a), [2, 4) (a$, na,
+    // ana, na$) and [4, 8) (ana$, nana$, anana$, banana$)
+    EXPECT_EQ((std::vector<std::size_t> {1, 2, 4, 4}), shape.string_depth);
+}
+
+TEST(TreeStats, MatchTheBruteForceShape) {
+    std::mt19937 rng(4);
+    for (int sigma : {1, 2, 4}) {
+        Strings strings;
+        Tree tree = make_tree(rng, sigma, &strings);
+        BruteShape expected(strings);
+        Tree::TreeStats shape = tree.tree_stats();
+        EXPECT_EQ(expected.internal_nodes, shape.internal_nodes);
+        EXPECT_EQ(expected.leaves, shape.leaves);
+        EXPECT_EQ(expected.suffixes, shape.suffixes);
+        EXPECT_EQ(expected.total_edge_length, shape.total_edge_length);
+        EXPECT_EQ(Tree::index_type(expected.max_string_depth), shape.max_string_depth);
+        EXPECT_EQ(expected.alphabet, shape.alphabet);
+        // Every internal node but the root has its suffix link
+        EXPECT_EQ(shape.internal_nodes - 1, shape.suffix_links);
+        std::size_t children = 0, nodes = 0;
+        for (std::size_t k = 0; k < shape.branching.size(); ++k) {
+            children += k * shape.branching[k];
+        }
+        for (std::size_t n : shape.string_depth) {
+            nodes += n;
+        }
+        EXPECT_EQ(shape.edges(), children);
+        EXPECT_EQ(shape.internal_nodes + shape.leaves, nodes);
+    }
+}
+
+// A cursor drained by slices of @budget nodes: the occurrences of find_all,
+// in the same order, whatever the slices; counts the slices in @slices
+std::vector<Tree::SuffixEntry> drain(Tree::OccurrenceCursor cursor, std::size_t budget, std::size_t *slices) {
+    std::vector<Tree::SuffixEntry> result;
+    *slices = 1;
+    for (std::size_t left = budget;;) {
+        Tree::SuffixEntry e;
+        if (cursor.next(&e, &left)) {
+            result.push_back(e);
+        } else if (cursor.exhausted()) {
+            return result;
+        } else {
+            // The budget ran out: resume with a new one
+            EXPECT_EQ(0u, left);
+            left = budget;
+            ++*slices;
+        }
+    }
+}
+
+TEST(OccurrenceCursor, ResumesWhereTheBudgetRanOut) {
+    std::mt19937 rng(5);
+    for (Tree::index_type depth : {0, 4}) {
+        Strings strings;
+        Tree tree = depth > 0 ? Tree(depth) : Tree();
+        for (auto const & s : bruteforce::random_strings(rng, 8, 60, 2)) {
+            strings[tree.add_string(s.begin(), s.end())] = s;
+        }
+        std::vector<std::string> texts;
+        for (auto const & s : strings) {
+            texts.push_back(s.second);
+        }
+        // Patterns past the depth of the truncated tree check the suffixes of
+        // a cut leaf one by one
+        for (auto const & p : bruteforce::patterns(rng, texts, 60, 2)) {
+            std::vector<Tree::SuffixEntry> all = tree.find_all(p.begin(), p.end());
+            EXPECT_EQ(bruteforce::occurrences(strings, p), bruteforce::sorted(all)) << p;
+            std::size_t previous = 0;
+            for (std::size_t budget : {1, 2, 7, 1000000}) {
+                std::size_t slices;
+                std::vector<Tree::SuffixEntry> found =
+                    drain(tree.iterate_occurrences(p.begin(), p.end()), budget, &slices);
+                ASSERT_EQ(all.size(), found.size()) << p;
+                for (std::size_t k = 0; k < all.size(); ++k) {
+                    EXPECT_EQ(all[k].ref_str, found[k].ref_str) << p;
+                    EXPECT_EQ(all[k].offset, found[k].offset) << p;
+                }
+                // Larger budgets, fewer slices
+                EXPECT_TRUE(0 == previous || slices <= previous) << p;
+                previous = slices;
+            }
+        }
+    }
+}
+
+TEST(OccurrenceCursor, ZeroBudgetMakesNoProgress) {
+    Tree tree;
+    std::string s = "abracadabra", p = "a";
+    tree.add_string(s.begin(), s.end());
+    Tree::OccurrenceCursor cursor = tree.iterate_occurrences(p.begin(), p.end());
+    Tree::SuffixEntry e;
+    std::size_t budget = 0;
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_FALSE(cursor.next(&e, &budget));
+        EXPECT_FALSE(cursor.exhausted());
+    }
+    std::size_t n = 0;
+    while (cursor.next(&e)) {
+        ++n;
+    }
+    EXPECT_EQ(5u, n);
+    EXPECT_TRUE(cursor.exhausted());
+
+    std::string missing = "abc";
+    Tree::OccurrenceCursor none = tree.iterate_occurrences(missing.begin(), missing.end());
+    EXPECT_TRUE(none.exhausted());
+    EXPECT_FALSE(none.next(&e, &budget));
+}
+
+TEST(DumpTree, PrintsTheEdgesInLexicographicOrder) {
+    Tree tree;
+    std::string s = "banana";
+    tree.add_string(s.begin(), s.end());
+    std::ostringstream out;
+    tree.dump_tree(out);
+    EXPECT_EQ("$ - ##\n"
+              "a - $ - ##\n"
+              "    n a - $ - ##\n"
+              "          n a $ - ##\n"
+              "b a n a n a $ - ##\n"
+              "n a - $ - ##\n"
+              "      n a $ - ##\n", out.str());
+    std::ostringstream empty;
+    Tree().dump_tree(empty);
+    EXPECT_EQ("##\n", empty.str());
+}
@@ -0,0 +1,155 @@
+// WordSuffixTree against brute force over letter strings: each letter is a
+// word, a document is its letters spelled as words
+
+#include "wordsuffixtree.h"
+#include "bruteforce.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using bruteforce::Occurrence;
+using bruteforce::Strings;
+
+typedef WordSuffixTree<> Words;
+
+namespace {
+
+const char *const spelled[] = {"alpha", "beta", "gamma", "delta"};
+
+// The text of a document: the words of @s separated by random whitespace,
+// with the byte offset of each word
+std::string spell(std::mt19937& rng, std::string const & s, std::vector<std::size_t> *offsets = nullptr) {
+    std::string text;
+    for (char c : s) {
+        text.append(rng() % 3, " \t\n"[rng() % 3]);
+        text.push_back(' ');
+        if (offsets) {
+            offsets->push_back(text.size());
+        }
+        text.append(spelled[c - 'a']);
+    }
+    text.append(rng() % 2, ' ');
+    return text;
+}
+
+std::vector<std::string> tokenize(std::string const & text, bool alnum) {
+    std::vector<WordToken> tokens;
+    if (alnum) {
+        AlnumTokenizer()(text, &tokens);
+    } else {
+        WhitespaceTokenizer()(text, &tokens);
+    }
+    std::vector<std::string> result;
+    for (auto const & t : tokens) {
+        result.push_back(std::to_string(t.offset) + ":" + t.word);
+    }
+    return result;
+}
+
+// Documents with duplicates, suffixes of other documents and empty ones
+std::vector<std::string> make_documents(std::mt19937& rng, std::size_t n) {
+    std::vector<std::string> documents;
+    while (documents.size() < n) {
+        if (!documents.empty() && 0 == rng() % 4) {
+            std::string const & d = documents[rng() % documents.size()];
+            documents.push_back(d.substr(rng() % (d.size() + 1)));
+        } else {
+            documents.push_back(bruteforce::random_string(rng, rng() % 40, 3));
+        }
+    }
+    return documents;
+}
+
+} // namespace
+
+TEST(Tokenizers, SplitAndNormalize) {
+    std::string text = "  Hello, World!\tfoo-bar 42x ";
+    EXPECT_EQ((std::vector<std::string> {"2:Hello,", "9:World!", "16:foo-bar", "24:42x"}), tokenize(text, false));
+    EXPECT_EQ((std::vector<std::string> {"2:hello", "9:world", "16:foo", "20:bar", "24:42x"}), tokenize(text, true));
+    EXPECT_TRUE(tokenize(" \t\n", false).empty());
+    EXPECT_TRUE(tokenize("-- !", true).empty());
+}
+
+TEST(WordSuffixTree, PhrasesMatchBruteForce) {
+    std::mt19937 rng(1);
+    std::vector<std::string> documents = make_documents(rng, 40);
+    Words words;
+    Strings strings;
+    std::vector<std::vector<std::size_t>> offsets;
+    for (auto const & d : documents) {
+        offsets.push_back(std::vector<std::size_t>());
+        int id = words.add_document(spell(rng, d, &offsets.back()));
+        EXPECT_EQ(int(strings.size()) + 1, id);
+        strings[id] = d;
+    }
+    EXPECT_EQ(documents.size(), words.document_count());
+    EXPECT_GT(words.alias_count(), 0u);
+    EXPECT_EQ(3u, words.vocabulary_size());
+
+    std::vector<std::string> patterns = bruteforce::patterns(rng, documents, 300, 3);
+    patterns.push_back("d");
+    for (auto const & p : patterns) {
+        std::vector<Occurrence> expected = bruteforce::occurrences(strings, p);
+        std::string phrase = spell(rng, p);
+        EXPECT_EQ(!expected.empty(), words.contains(phrase)) << p;
+        EXPECT_EQ(expected.size(), words.count(phrase)) << p;
+        std::vector<Words::SuffixEntry> found = words.find_all(phrase);
+        EXPECT_EQ(expected, bruteforce::sorted(found)) << p;
+        for (auto const & e : found) {
+            EXPECT_EQ(offsets[e.ref_str - 1][e.offset], words.char_offset(e));
+            std::vector<std::string> spelled_phrase = words.phrase(e, p.size());
+            ASSERT_EQ(p.size(), spelled_phrase.size());
+            for (std::size_t k = 0; k < p.size(); ++k) {
+                EXPECT_EQ(spelled[p[k] - 'a'], spelled_phrase[k]);
+            }
+        }
+    }
+}
+
+TEST(WordSuffixTree, OutOfRangePositionsThrow) {
+    Words words;
+    words.add_document("to be or not to be");
+    words.add_document("not to be");
+    Words::SuffixEntry e(2, 2);
+    EXPECT_EQ(7u, words.char_offset(e));
+    EXPECT_EQ((std::vector<std::string> {"be"}), words.phrase(e, 1));
+    EXPECT_TRUE(words.phrase(Words::SuffixEntry(2, 3), 0).empty());
+    EXPECT_THROW(words.char_offset(Words::SuffixEntry(2, 3)), std::out_of_range);
+    EXPECT_THROW(words.char_offset(Words::SuffixEntry(3, 0)), std::out_of_range);
+    EXPECT_THROW(words.char_offset(Words::SuffixEntry(0, 0)), std::out_of_range);
+    EXPECT_THROW(words.phrase(Words::SuffixEntry(2, 2), 2), std::out_of_range);
+    EXPECT_THROW(words.phrase(Words::SuffixEntry(1, -1), 1), std::out_of_range);
+    EXPECT_THROW(words.phrase(Words::SuffixEntry(4, 0), 0), std::out_of_range);
+}
+
+TEST(WordSuffixTree, LongestCommonPhrase) {
+    std::mt19937 rng(2);
+    for (int round = 0; round < 10; ++round) {
+        std::vector<std::string> documents = bruteforce::random_strings(rng, 6, 30, 2);
+        Words words;
+        Strings strings;
+        for (auto const & d : documents) {
+            strings[words.add_document(spell(rng, d))] = d;
+        }
+        for (std::size_t k : {0, 2, 4}) {
+            std::string expected = bruteforce::longest_common_substring(strings, 0 == k ? strings.size() : k);
+            Words::SubstringEntry best = words.longest_common_phrase(k);
+            ASSERT_EQ(Words::index_type(expected.size()), best.length) << k;
+            if (expected.empty()) {
+                continue;
+            }
+            // One of the longest, held by enough documents
+            std::string found = strings[best.ref_str].substr(best.offset, best.length);
+            std::set<int> holders;
+            for (auto const & o : bruteforce::occurrences(strings, found)) {
+                holders.insert(o.first);
+            }
+            EXPECT_GE(holders.size(), 0 == k ? strings.size() : k) << found;
+        }
+    }
+}
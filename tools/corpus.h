@@ -0,0 +1,242 @@
+#ifndef _CORPUS_HPP_INCLUDED_
+#define _CORPUS_HPP_INCLUDED_
+
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+
+// Synthetic corpora for the benchmarks and the tools
+//
+// Every generator is deterministic for a given seed on every platform: the
+// random numbers come from std::mt19937_64, whose output is fixed by the
+// standard, reduced without the implementation-defined distributions. A
+// corpus is a list of strings without '\n' nor the default end token '$',
+// stored one string per line.
+namespace corpus {
+
+typedef std::vector<std::string> Corpus;
+
+// Random - Seeded generator with portable reductions
+class Random {
+    std::mt19937_64 engine;
+public:
+    explicit Random(std::uint64_t seed) : engine(seed) {}
+    // Uniform in [0, n)
+    std::uint64_t below(std::uint64_t n) {
+        return engine() % n;
+    }
+    // Uniform in [0, 1)
+    double unit() {
+        return (engine() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// The alphabet: printable characters but the end token
+inline std::string alphabet(std::size_t sigma) {
+    std::string symbols;
+    for (char c = '!'; c <= '~' && symbols.size() < sigma; ++c) {
+        if ('$' != c) {
+            symbols.push_back(c);
+        }
+    }
+    if (symbols.empty()) {
+        throw std::invalid_argument("corpus: the alphabet is empty");
+    }
+    return symbols;
+}
+
+// Cuts a text into @strings strings of (almost) equal length
+inline Corpus split(std::string const & text, std::size_t strings) {
+    strings = std::max<std::size_t>(1, std::min(strings, std::max<std::size_t>(text.size(), 1)));
+    Corpus result;
+    for (std::size_t i = 0; i < strings; ++i) {
+        result.push_back(text.substr(text.size() * i / strings, text.size() * (i + 1) / strings - text.size() * i / strings));
+    }
+    return result;
+}
+
+inline std::string random_string(std::size_t length, std::string const & symbols, Random & rng) {
+    std::string s(length, symbols[0]);
+    for (auto & c : s) {
+        c = symbols[rng.below(symbols.size())];
+    }
+    return s;
+}
+
+// uniform - Independent uniform characters
+inline Corpus uniform(std::size_t length, std::size_t strings, std::size_t sigma, std::uint64_t seed) {
+    Random rng(seed);
+    return split(random_string(length, alphabet(sigma), rng), strings);
+}
+
+// zipf_text - Words separated by spaces, drawn from a vocabulary with Zipf
+// frequencies (exponent @skew); with probability 1/2 a word is instead one of
+// four fixed successors of the previous one (an order-1 Markov chain), so
+// that phrases repeat as in natural language
+inline Corpus zipf_text(std::size_t length, std::size_t strings, std::size_t vocabulary,
+                        double skew, std::uint64_t seed) {
+    Random rng(seed);
+    std::string letters = "abcdefghijklmnopqrstuvwxyz";
+    vocabulary = std::max<std::size_t>(vocabulary, 1);
+    std::vector<std::string> words;
+    for (std::size_t i = 0; i < vocabulary; ++i) {
+        words.push_back(random_string(2 + rng.below(9), letters, rng));
+    }
+    std::vector<double> cumulative(vocabulary);
+    double total = 0;
+    for (std::size_t i = 0; i < vocabulary; ++i) {
+        total += 1.0 / std::pow(double(i + 1), skew);
+        cumulative[i] = total;
+    }
+    std::vector<std::size_t> successors(4 * vocabulary);
+    for (auto & s : successors) {
+        s = rng.below(vocabulary);
+    }
+    std::string text;
+    std::size_t previous = 0;
+    while (text.size() < length) {
+        std::size_t w;
+        if (!text.empty() && 0 == rng.below(2)) {
+            w = successors[4 * previous + rng.below(4)];
+        } else {
+            double x = rng.unit() * total;
+            w = std::min<std::size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), x) - cumulative.begin(),
+                                      vocabulary - 1);
+        }
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        text += words[w];
+        previous = w;
+    }
+    text.resize(length);
+    return split(text, strings);
+}
+
+// fibonacci - Prefix of the Fibonacci word (a, ab, aba, abaab...): the most
+// repetitive binary text, with long chains of suffix links to follow
+inline Corpus fibonacci(std::size_t length, std::size_t strings) {
+    std::string a = "a", b = "ab";
+    while (b.size() < length) {
+        std::string c = b + a;
+        a.swap(b);
+        b.swap(c);
+    }
+    b.resize(length);
+    return split(b, strings);
+}
+
+// tandem - Strings repeating a random unit of their own: periodic strings,
+// whose tree is as deep as they are long (a unit of 1 gives runs of one
+// character)
+inline Corpus tandem(std::size_t length, std::size_t strings, std::size_t unit, std::size_t sigma,
+                     std::uint64_t seed) {
+    Random rng(seed);
+    std::string symbols = alphabet(sigma);
+    Corpus result;
+    for (auto const & s : split(std::string(length, ' '), strings)) {
+        std::string u = random_string(std::max<std::size_t>(unit, 1), symbols, rng);
+        std::string t;
+        while (t.size() < s.size()) {
+            t += u;
+        }
+        t.resize(s.size());
+        result.push_back(t);
+    }
+    return result;
+}
+
+// mutated_genome - Copies of a random DNA sequence, each with substitutions
+// and short insertions or deletions at @rate per base (a population of
+// genomes)
+inline Corpus mutated_genome(std::size_t length, std::size_t strings, double rate, std::uint64_t seed) {
+    Random rng(seed);
+    std::string const bases = "acgt";
+    strings = std::max<std::size_t>(strings, 1);
+    std::string reference = random_string(std::max<std::size_t>(length / strings, 1), bases, rng);
+    Corpus result;
+    for (std::size_t i = 0; i < strings; ++i) {
+        std::string copy;
+        for (std::size_t p = 0; p < reference.size(); ++p) {
+            if (rng.unit() >= rate) {
+                copy.push_back(reference[p]);
+                continue;
+            }
+            switch (rng.below(3)) {
+            case 0:
+                copy.push_back(bases[rng.below(4)]);
+                break;
+            case 1:
+                copy += random_string(1 + rng.below(3), bases, rng);
+                copy.push_back(reference[p]);
+                break;
+            default:
+                p += rng.below(3);
+                break;
+            }
+        }
+        result.push_back(copy);
+    }
+    return result;
+}
+
+// records - Many short key/value records sharing their field names and
+// drawing their values from small domains (log lines, table rows)
+inline Corpus records(std::size_t length, std::uint64_t seed) {
+    Random rng(seed);
+    std::string const digits = "0123456789";
+    std::string const letters = "abcdefghijklmnopqrstuvwxyz";
+    std::vector<std::string> cities;
+    for (int i = 0; i < 50; ++i) {
+        cities.push_back(random_string(4 + rng.below(6), letters, rng));
+    }
+    Corpus result;
+    std::size_t used = 0;
+    for (std::uint64_t id = 0; used < length; ++id) {
+        std::string r = "id=" + std::to_string(100000 + id) + ";user=" + random_string(6, letters, rng) +
+            ";city=" + cities[rng.below(cities.size())] + ";amount=" + random_string(1 + rng.below(5), digits, rng);
+        used += r.size();
+        result.push_back(r);
+    }
+    return result;
+}
+
+// One string per line
+inline void write_lines(Corpus const & c, std::ostream & out) {
+    for (auto const & s : c) {
+        out << s << '\n';
+    }
+}
+
+inline Corpus read_lines(std::istream & in) {
+    Corpus c;
+    for (std::string line; std::getline(in, line); ) {
+        c.push_back(line);
+    }
+    return c;
+}
+
+inline Corpus read_file(std::string const & path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("corpus: cannot open " + path);
+    }
+    return read_lines(in);
+}
+
+inline std::size_t total_length(Corpus const & c) {
+    std::size_t total = 0;
+    for (auto const & s : c) {
+        total += s.size();
+    }
+    return total;
+}
+
+} // namespace corpus
+
+#endif // _CORPUS_HPP_INCLUDED_
@@ -0,0 +1,94 @@
+// corpusgen - Write a synthetic corpus, one string per line
+//
+//   corpusgen <kind> [options] > corpus.txt
+//
+// Kinds (see corpus.h):
+//   uniform   independent characters           --sigma
+//   zipf      Zipf/Markov words                --vocabulary --skew
+//   fibonacci prefix of the Fibonacci word
+//   tandem    repeats of a random unit         --unit --sigma
+//   genome    mutated copies of a DNA sequence --rate
+//   records   short key/value records
+//
+// Common options: --length (total characters, default 1000000), --strings
+// (how many strings the text is cut into, default 1), --seed (default 1),
+// --out (file, default standard output). The same arguments always give the
+// same corpus.
+
+#include "corpus.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+static void usage() {
+    std::cerr << "usage: corpusgen uniform|zipf|fibonacci|tandem|genome|records"
+                 " [--length N] [--strings N] [--seed N] [--sigma N] [--vocabulary N]"
+                 " [--skew X] [--unit N] [--rate X] [--out FILE]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    std::string kind = argv[1];
+    std::map<std::string, std::string> options {
+        {"length", "1000000"}, {"strings", "1"}, {"seed", "1"}, {"sigma", "4"}, {"vocabulary", "10000"},
+        {"skew", "1.1"}, {"unit", "7"}, {"rate", "0.01"}, {"out", ""}
+    };
+    for (int i = 2; i < argc; i += 2) {
+        std::string name = argv[i];
+        if (0 != name.compare(0, 2, "--") || !options.count(name.substr(2)) || i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        options[name.substr(2)] = argv[i + 1];
+    }
+    auto number = [&options](char const *name) {
+        return std::strtoull(options[name].c_str(), nullptr, 10);
+    };
+    auto real = [&options](char const *name) {
+        return std::strtod(options[name].c_str(), nullptr);
+    };
+    std::size_t length = number("length");
+    std::size_t strings = number("strings");
+    std::uint64_t seed = number("seed");
+
+    corpus::Corpus c;
+    try {
+        if ("uniform" == kind) {
+            c = corpus::uniform(length, strings, number("sigma"), seed);
+        } else if ("zipf" == kind) {
+            c = corpus::zipf_text(length, strings, number("vocabulary"), real("skew"), seed);
+        } else if ("fibonacci" == kind) {
+            c = corpus::fibonacci(length, strings);
+        } else if ("tandem" == kind) {
+            c = corpus::tandem(length, strings, number("unit"), number("sigma"), seed);
+        } else if ("genome" == kind) {
+            c = corpus::mutated_genome(length, strings, real("rate"), seed);
+        } else if ("records" == kind) {
+            c = corpus::records(length, seed);
+        } else {
+            usage();
+            return 2;
+        }
+    } catch (std::exception const & e) {
+        std::cerr << "corpusgen: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (options["out"].empty()) {
+        corpus::write_lines(c, std::cout);
+    } else {
+        std::ofstream out(options["out"]);
+        if (!out) {
+            std::cerr << "corpusgen: cannot open " << options["out"] << std::endl;
+            return 1;
+        }
+        corpus::write_lines(c, out);
+    }
+    return 0;
+}
@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+"""Performance regression harness for suffixtree.h.
+
+Runs suffixtree_bench with repetitions, on the generated argument grid and on
+a corpus file written by corpusgen, and keeps four measures per benchmark:
+
+    AddString    mb_per_s        construction throughput (higher is better)
+                 bytes_per_char  heap held by the tree (lower is better)
+    IsSubstring  ns_per_query    query latency (lower is better)
+    IsSuffix     ns_per_query
+    Destroy      teardown_ms     time to free a tree (lower is better)
+
+`record` stores them as a JSON baseline, `compare` runs the same benchmarks
+again (same filter, corpus and repetitions as the baseline) and flags every
+measure that got worse by more than its noise threshold: `--sigmas` times
+the combined coefficient of variation of the two sets of runs, and at least
+`--min-change` percent. The exit status is 1 when something regressed.
+
+    cmake -S . -B build && cmake --build build
+    tools/perf_regress.py record baseline.json --build build
+    ... change suffixtree.h, rebuild ...
+    tools/perf_regress.py compare baseline.json --build build
+
+Nothing is downloaded: the corpora come from corpus.h, through the benchmark
+itself and corpusgen.
+"""
+
+import argparse
+import datetime
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+FORMAT_VERSION = 1
+
+# The benchmarks of the default filter: one point of the grid per corpus kind
+# (128 KiB of DNA-like text), and the corpusgen file. The benchmark library
+# takes POSIX extended regexes: no \w or \d.
+DEFAULT_FILTER = "BM_[A-Za-z]+/(length:131072/sigma:4/strings:16/corpus:[0-9]|file)$"
+
+DEFAULT_CORPUS = {"kind": "genome", "length": 1000000, "strings": 16, "seed": 1}
+
+# benchmark family -> [(measure, better, extractor)]
+MEASURES = {
+    "BM_AddString": [
+        ("mb_per_s", "higher", lambda run: run["bytes_per_second"] / 1e6),
+        ("bytes_per_char", "lower", lambda run: run["bytes_per_char"]),
+    ],
+    "BM_IsSubstring": [("ns_per_query", "lower", lambda run: to_unit(run, "ns"))],
+    "BM_IsSuffix": [("ns_per_query", "lower", lambda run: to_unit(run, "ns"))],
+    "BM_Destroy": [("teardown_ms", "lower", lambda run: to_unit(run, "ms"))],
+}
+
+UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def to_unit(run, unit):
+    return run["real_time"] * UNITS[run["time_unit"]] / UNITS[unit]
+
+
+def fail(message):
+    sys.stderr.write("perf_regress: %s\n" % message)
+    sys.exit(2)
+
+
+def find_binary(build, name):
+    for sub in ("benchmarks", "tools", ""):
+        path = os.path.join(build, sub, name)
+        if os.path.isfile(path) and os.access(path, os.X_OK):
+            return path
+    fail("%s not found in %s (build with -DSUFFIXTREE_BUILD_BENCHMARKS=ON and Google Benchmark installed)"
+         % (name, build))
+
+
+def git_revision():
+    try:
+        out = subprocess.check_output(["git", "rev-parse", "--short", "HEAD"], stderr=subprocess.DEVNULL,
+                                      cwd=os.path.dirname(os.path.abspath(__file__)))
+        return out.decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def generate_corpus(build, settings, directory):
+    """Write the corpus file of the settings with corpusgen, return its path"""
+    path = os.path.join(directory, "corpus.txt")
+    corpus = settings["corpus"]
+    command = [find_binary(build, "corpusgen"), corpus["kind"], "--length", str(corpus["length"]),
+               "--strings", str(corpus["strings"]), "--seed", str(corpus["seed"]), "--out", path]
+    if subprocess.call(command) != 0:
+        fail("corpusgen failed")
+    return path
+
+
+def run_benchmarks(build, settings):
+    """Run suffixtree_bench, return {benchmark: {measure: [one value per repetition]}}"""
+    bench = find_binary(build, "suffixtree_bench")
+    with tempfile.TemporaryDirectory() as directory:
+        env = dict(os.environ)
+        if settings["corpus"]:
+            env["SUFFIXTREE_CORPUS"] = generate_corpus(build, settings, directory)
+        output = os.path.join(directory, "results.json")
+        command = [bench, "--benchmark_filter=" + settings["filter"],
+                   "--benchmark_repetitions=%d" % settings["repetitions"],
+                   "--benchmark_min_time=%g" % settings["min_time"],
+                   "--benchmark_out=" + output, "--benchmark_out_format=json"]
+        sys.stderr.write("running %s\n" % " ".join(command))
+        if subprocess.call(command, env=env, stdout=subprocess.DEVNULL) != 0:
+            fail("suffixtree_bench failed")
+        with open(output) as f:
+            report = json.load(f)
+    samples = {}
+    for run in report["benchmarks"]:
+        if run.get("run_type", "iteration") != "iteration" or "error_occurred" in run:
+            continue
+        name = run.get("run_name", run["name"])
+        for measure, _, extract in MEASURES.get(name.split("/")[0], []):
+            samples.setdefault(name, {}).setdefault(measure, []).append(extract(run))
+    if not samples:
+        fail("no benchmark matched %r" % settings["filter"])
+    return report.get("context", {}), samples
+
+
+def summarize(values):
+    n = len(values)
+    mean = sum(values) / n
+    stddev = math.sqrt(sum((v - mean) ** 2 for v in values) / (n - 1)) if n > 1 else 0.0
+    return {"mean": mean, "stddev": stddev, "runs": n}
+
+
+def measure_results(build, settings):
+    context, samples = run_benchmarks(build, settings)
+    results = {}
+    for name, measures in samples.items():
+        family = name.split("/")[0]
+        better = dict((m, b) for m, b, _ in MEASURES[family])
+        results[name] = dict((m, dict(summarize(v), better=better[m])) for m, v in measures.items())
+    return {
+        "version": FORMAT_VERSION,
+        "date": datetime.datetime.now().isoformat(timespec="seconds"),
+        "revision": git_revision(),
+        "host": context.get("host_name"),
+        "num_cpus": context.get("num_cpus"),
+        "settings": settings,
+        "results": results,
+    }
+
+
+def load(path):
+    try:
+        with open(path) as f:
+            baseline = json.load(f)
+    except (OSError, ValueError) as e:
+        fail("cannot read %s: %s" % (path, e))
+    if baseline.get("version") != FORMAT_VERSION:
+        fail("%s: unsupported baseline version %r" % (path, baseline.get("version")))
+    return baseline
+
+
+def save(data, path):
+    with open(path, "w") as f:
+        json.dump(data, f, indent=2, sort_keys=True)
+        f.write("\n")
+
+
+def cv(stats):
+    return stats["stddev"] / stats["mean"] if stats["mean"] else 0.0
+
+
+def compare(baseline, current, sigmas, min_change):
+    """Print the comparison table, return the number of regressions"""
+    regressions = 0
+    rows = []
+    for name in sorted(baseline["results"]):
+        for measure, old in sorted(baseline["results"][name].items()):
+            new = current["results"].get(name, {}).get(measure)
+            if new is None:
+                rows.append((name, measure, old["mean"], None, None, None, "missing"))
+                continue
+            change = (new["mean"] - old["mean"]) / old["mean"] if old["mean"] else 0.0
+            worse = -change if old["better"] == "higher" else change
+            threshold = max(min_change / 100.0, sigmas * math.sqrt(cv(old) ** 2 + cv(new) ** 2))
+            if worse > threshold:
+                verdict = "REGRESSION"
+                regressions += 1
+            elif -worse > threshold:
+                verdict = "improved"
+            else:
+                verdict = ""
+            rows.append((name, measure, old["mean"], new["mean"], change, threshold, verdict))
+    width = max([len(r[0]) for r in rows] + [9])
+    print("%-*s  %-14s %12s %12s %8s %7s" % (width, "benchmark", "measure", "baseline", "current", "change",
+                                             "noise"))
+    for name, measure, old, new, change, threshold, verdict in rows:
+        if new is None:
+            print("%-*s  %-14s %12.4g %12s %8s %7s  %s" % (width, name, measure, old, "-", "-", "-", verdict))
+        else:
+            print("%-*s  %-14s %12.4g %12.4g %+7.1f%% %6.1f%%  %s" % (width, name, measure, old, new,
+                                                                    100 * change, 100 * threshold, verdict))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("command", choices=["record", "compare", "show"])
+    parser.add_argument("baseline", help="baseline JSON file")
+    parser.add_argument("--build", default="build", help="CMake build directory (default: build)")
+    parser.add_argument("--filter", help="benchmark regex (default: one grid point per corpus kind, and the file)")
+    parser.add_argument("--repetitions", type=int, help="runs per benchmark, for the noise estimate (default: 5)")
+    parser.add_argument("--min-time", type=float, help="seconds per run (default: 0.2)")
+    parser.add_argument("--corpus", metavar="KIND", help="corpusgen kind of the file corpus, 'none' to skip "
+                        "(default: genome)")
+    parser.add_argument("--corpus-length", type=int, help="characters of the file corpus (default: 1000000)")
+    parser.add_argument("--corpus-strings", type=int, help="strings of the file corpus (default: 16)")
+    parser.add_argument("--seed", type=int, help="corpusgen seed (default: 1)")
+    parser.add_argument("--sigmas", type=float, default=3.0,
+                        help="noise threshold, in coefficients of variation (default: 3)")
+    parser.add_argument("--min-change", type=float, default=3.0,
+                        help="smallest change reported, in percent (default: 3)")
+    parser.add_argument("--save", metavar="FILE", help="compare: also store the new results")
+    args = parser.parse_args()
+
+    if "show" == args.command:
+        baseline = load(args.baseline)
+        print(json.dumps(baseline, indent=2, sort_keys=True))
+        return 0
+
+    # compare reruns what the baseline measured, unless told otherwise
+    settings = {
+        "filter": DEFAULT_FILTER,
+        "repetitions": 5,
+        "min_time": 0.2,
+        "corpus": dict(DEFAULT_CORPUS),
+    }
+    baseline = None
+    if "compare" == args.command:
+        baseline = load(args.baseline)
+        settings = baseline["settings"]
+    if args.filter is not None:
+        settings["filter"] = args.filter
+    if args.repetitions is not None:
+        if args.repetitions < 2:
+            fail("at least two repetitions are needed to estimate the noise")
+        settings["repetitions"] = args.repetitions
+    if args.min_time is not None:
+        settings["min_time"] = args.min_time
+    if "none" == args.corpus:
+        settings["corpus"] = None
+    elif settings["corpus"] or args.corpus:
+        corpus = settings["corpus"] or dict(DEFAULT_CORPUS)
+        settings["corpus"] = corpus
+        for key, value in (("kind", args.corpus), ("length", args.corpus_length),
+                           ("strings", args.corpus_strings), ("seed", args.seed)):
+            if value is not None:
+                corpus[key] = value
+
+    current = measure_results(args.build, settings)
+    if "record" == args.command:
+        save(current, args.baseline)
+        print("%d benchmarks recorded in %s" % (len(current["results"]), args.baseline))
+        return 0
+    if args.save:
+        save(current, args.save)
+    print("baseline: %s (%s), current: %s" % (baseline["date"], baseline["revision"], current["revision"]))
+    regressions = compare(baseline, current, args.sigmas, args.min_change)
+    print("%d regression%s" % (regressions, "" if 1 == regressions else "s"))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,59 @@
+// pgo_train - Training run of the profile-guided build
+//
+// Builds trees on each kind of generated corpus and queries them, so that the
+// profile covers the construction loop and the lookups on small and large
+// alphabets, unique and repetitive text. Run by the pgo_train target of a
+// build configured with -DSUFFIXTREE_PGO=generate (see README).
+//
+//   pgo_train [characters per corpus, default 1000000]
+
+#include "suffixtree.h"
+#include "corpus.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static std::size_t train(corpus::Corpus const & strings, corpus::Random & rng) {
+    SuffixTree<char> tree;
+    for (auto const & s : strings) {
+        tree.add_string(s.begin(), s.end());
+    }
+    std::size_t hits = 0;
+    // Half of the queries occur; listing the occurrences is sampled less, as
+    // short patterns of the repetitive corpora occur everywhere
+    for (std::size_t i = 0; i < 100000; ++i) {
+        std::string const & s = strings[rng.below(strings.size())];
+        std::size_t len = 8 + rng.below(24);
+        if (s.size() <= len) {
+            continue;
+        }
+        std::string q = s.substr(rng.below(s.size() - len), len);
+        if (0 == i % 2) {
+            q[rng.below(len)] = 'a' + rng.below(26);
+        }
+        if (0 == i % 64) {
+            hits += tree.find_all(q.begin(), q.end()).size();
+        } else if (0 == i % 16) {
+            hits += tree.count(q.begin(), q.end());
+        } else {
+            hits += tree.is_substring(q.begin(), q.end());
+        }
+    }
+    return hits;
+}
+
+int main(int argc, char **argv) {
+    std::size_t length = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    corpus::Random rng(1);
+    std::size_t hits = 0;
+    hits += train(corpus::mutated_genome(length, 16, 0.01, 1), rng);
+    hits += train(corpus::uniform(length, 64, 4, 2), rng);
+    hits += train(corpus::uniform(length / 2, 64, 90, 3), rng);
+    hits += train(corpus::zipf_text(length, 256, 10000, 1.1, 4), rng);
+    hits += train(corpus::tandem(length / 2, 32, 7, 4, 5), rng);
+    hits += train(corpus::fibonacci(length / 4, 1), rng);
+    hits += train(corpus::records(length / 2, 6), rng);
+    std::cout << "pgo_train: " << hits << " hits" << std::endl;
+    return 0;
+}
@@ -0,0 +1,247 @@
+// stree - Index text records and query them
+//
+//   stree build -o FILE [--shards N] [--max-depth K] [--whole-files] [RECORDS...]
+//   stree query -i FILE [--exists | --count | --find] [--limit N]
+//               [--threads N] [--batch N] [--stats]
+//   stree info -i FILE
+//
+// build reads records from the files (standard input if none or "-"), one
+// per line, or one per file with --whole-files, indexes them (see StreeIndex
+// in streeindex.h): --shards trees built concurrently (default: one per
+// hardware thread), truncated at depth K with --max-depth; and saves the
+// records with their shard layout to FILE. The trees themselves are not
+// persisted (yet): query and info build them again from FILE, in about the
+// time build took.
+//
+// query reads patterns from standard input, one per line, and writes one
+// answer line per pattern: 1 or 0 (--exists, the default), the number of
+// occurrences (--count), or the occurrences as record:offset pairs, records
+// numbered from 0 in input order (--find, at most --limit of them, 0 for all
+// as in the server protocol, the default). Patterns are answered by batches
+// of --batch (default 65536), each batch split between --threads threads.
+// --stats prints the rebuild time and the throughput on standard error.
+//
+// The exit status is 0 on success, 1 on errors, 2 on usage errors.
+
+#include "streeindex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef std::unique_ptr<std::FILE, int(*)(std::FILE*)> File;
+
+static void usage() {
+    std::cerr << "usage: stree build -o FILE [--shards N] [--max-depth K] [--whole-files] [RECORDS...]\n"
+                 "       stree query -i FILE [--exists | --count | --find] [--limit N] [--threads N]"
+                 " [--batch N] [--stats]\n"
+                 "       stree info -i FILE\n"
+                 "FILE holds the records and their shards; query and info rebuild the trees from it"
+              << std::endl;
+}
+
+static File open_file(std::string const & path, char const *how) {
+    if ("-" == path) {
+        return File(std::strcmp(how, "rb") ? stdout : stdin, [](std::FILE*) { return 0; });
+    }
+    File f(std::fopen(path.c_str(), how), &std::fclose);
+    if (!f) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    return f;
+}
+
+// Command line: flags, options with a value, and the remaining arguments
+struct Arguments {
+    std::map<std::string, std::string> options;
+    std::vector<std::string> files;
+
+    // parse - false on unknown options
+    bool parse(int argc, char **argv, std::vector<std::string> const & flags,
+               std::vector<std::string> const & valued) {
+        for (int i = 2; i < argc; ++i) {
+            std::string a = argv[i];
+            if (a.size() < 2 || '-' != a[0]) {
+                files.push_back(a);
+            } else if (std::find(flags.begin(), flags.end(), a) != flags.end()) {
+                options[a] = "1";
+            } else if (std::find(valued.begin(), valued.end(), a) != valued.end() && i + 1 < argc) {
+                options[a] = argv[++i];
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool has(char const *name) const {
+        return options.count(name) > 0;
+    }
+
+    std::string get(char const *name, std::string const & fallback = std::string()) const {
+        auto it = options.find(name);
+        return options.end() == it ? fallback : it->second;
+    }
+
+    std::size_t number(char const *name, std::size_t fallback) const {
+        return has(name) ? std::strtoull(get(name).c_str(), nullptr, 10) : fallback;
+    }
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int build(Arguments const & args) {
+    if (!args.has("-o")) {
+        usage();
+        return 2;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> records;
+    std::vector<std::string> files = args.files;
+    if (files.empty()) {
+        files.push_back("-");
+    }
+    for (auto const & path : files) {
+        File f = open_file(path, "rb");
+        BufferedReader in(f.get());
+        if (args.has("--whole-files")) {
+            records.emplace_back();
+            in.read_rest(&records.back());
+        } else {
+            std::string line;
+            while (in.read_line(&line)) {
+                records.push_back(line);
+            }
+        }
+    }
+    StreeIndex index;
+    index.build(records, args.number("--shards", default_threads()), args.number("--max-depth", 0));
+    double built = seconds_since(start);
+    File out = open_file(args.get("-o"), "wb");
+    BufferedWriter writer(out.get());
+    index.save(writer);
+    std::cerr << "stree: " << index.record_count() << " records, " << index.character_count() << " characters, "
+              << index.shard_count() << " shards in " << built << " s";
+    if (index.dropped_count() > 0) {
+        std::cerr << "; " << index.dropped_count() << " records are suffixes of others, found through them";
+    }
+    if (index.skipped_count() > 0) {
+        std::cerr << "; " << index.skipped_count() << " empty records or records with '$' skipped";
+    }
+    std::cerr << std::endl;
+    return 0;
+}
+
+static void load(Arguments const & args, StreeIndex *index) {
+    File f = open_file(args.get("-i"), "rb");
+    BufferedReader in(f.get());
+    index->load(in, args.number("--threads", default_threads()));
+}
+
+static int query(Arguments const & args) {
+    if (!args.has("-i") || args.has("--count") + args.has("--find") + args.has("--exists") > 1) {
+        usage();
+        return 2;
+    }
+    QueryMode mode = args.has("--count") ? QueryMode::count : args.has("--find") ? QueryMode::find :
+        QueryMode::exists;
+    std::size_t limit = args.number("--limit", 0);
+    std::size_t threads = std::max<std::size_t>(1, args.number("--threads", default_threads()));
+    std::size_t batch = std::max<std::size_t>(1, args.number("--batch", 1 << 16));
+
+    auto start = std::chrono::steady_clock::now();
+    StreeIndex index;
+    load(args, &index);
+    double loaded = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    BufferedReader in(stdin);
+    BufferedWriter out(stdout);
+    std::vector<std::string> patterns(batch);
+    std::string answers;
+    std::size_t total = 0;
+    for (;;) {
+        std::size_t n = 0;
+        while (n < batch && in.read_line(&patterns[n])) {
+            ++n;
+        }
+        if (0 == n) {
+            break;
+        }
+        patterns.resize(n);
+        answer_batch(index, patterns, mode, limit, threads, &answers);
+        out.write(answers);
+        total += n;
+        patterns.resize(batch);
+    }
+    out.flush();
+    if (args.has("--stats")) {
+        double elapsed = seconds_since(start);
+        std::cerr << "stree: trees rebuilt in " << loaded << " s; " << total << " patterns in " << elapsed
+                  << " s (" << total / std::max(elapsed, 1e-9) << " patterns/s)" << std::endl;
+    }
+    return 0;
+}
+
+static int info(Arguments const & args) {
+    if (!args.has("-i")) {
+        usage();
+        return 2;
+    }
+    StreeIndex index;
+    load(args, &index);
+    std::cout << "records " << index.record_count() << "\ncharacters " << index.character_count()
+              << "\ndropped " << index.dropped_count() << "\nskipped " << index.skipped_count()
+              << "\nshards " << index.shard_count() << "\n";
+    std::size_t bytes = 0;
+    for (std::size_t s = 0; s < index.shard_count(); ++s) {
+        bytes += index.shard(s).memory_usage().total();
+    }
+    std::cout << "memory " << bytes << " bytes\n";
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    std::string command = argv[1];
+    Arguments args;
+    try {
+        if ("build" == command) {
+            if (!args.parse(argc, argv, {"--whole-files"}, {"-o", "--shards", "--max-depth"})) {
+                usage();
+                return 2;
+            }
+            return build(args);
+        } else if ("query" == command) {
+            if (!args.parse(argc, argv, {"--exists", "--count", "--find", "--stats"},
+                            {"-i", "--limit", "--threads", "--batch"}) || !args.files.empty()) {
+                usage();
+                return 2;
+            }
+            return query(args);
+        } else if ("info" == command) {
+            if (!args.parse(argc, argv, {}, {"-i", "--threads"}) || !args.files.empty()) {
+                usage();
+                return 2;
+            }
+            return info(args);
+        }
+    } catch (std::exception const & e) {
+        std::cerr << "stree: " << e.what() << std::endl;
+        return 1;
+    }
+    usage();
+    return 2;
+}
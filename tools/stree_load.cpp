@@ -0,0 +1,262 @@
+// stree_load - Load generator of stree_server
+//
+//   stree_load -s SOCKET [--exists | --count | --find] [--limit N]
+//              [--connections C] [--depth D] [--requests N] [--echo]
+//              [PATTERNS]
+//
+// Sends the patterns of the file (standard input if none or "-"), one per
+// line, cycling through them, from C concurrent connections (default 4), each
+// keeping D requests in flight (default 16), until N requests (default: one
+// per pattern) are answered. Prints the throughput and the latency
+// percentiles of the requests, from sending to receiving the response.
+//
+// --echo prints the answers in the format of `stree query` instead, in the
+// order of the patterns (a single connection).
+
+#include "streeprotocol.h"
+#include "metrics.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace stree_protocol;
+
+typedef std::chrono::steady_clock Clock;
+
+static void usage() {
+    std::cerr << "usage: stree_load -s SOCKET [--exists | --count | --find] [--limit N] [--connections C]"
+                 " [--depth D] [--requests N] [--echo] [PATTERNS]" << std::endl;
+}
+
+static int connect_to(std::string const & path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("socket path too long: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || 0 != connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+        int error = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::system_error(error, std::generic_category(), "connect " + path);
+    }
+    return fd;
+}
+
+struct Settings {
+    std::string socket_path;
+    QueryMode mode;
+    std::uint64_t limit;
+    std::size_t depth;
+};
+
+// Client - One connection, pipelining requests
+class Client {
+public:
+    Client(Settings const & s, std::vector<std::string> const & patterns, LatencyHistogram *latency) :
+      settings(s),
+      patterns(patterns),
+      latency(latency),
+      fd(connect_to(s.socket_path))
+      {}
+
+    ~Client() {
+        close(fd);
+    }
+
+    // run - Send requests for patterns first, first + step, ... until @n
+    // are answered; @answer(pattern index, response) receives the responses
+    template <typename Callback>
+    void run(std::size_t first, std::size_t step, std::size_t n, Callback answer) {
+        std::deque<std::pair<std::size_t, Clock::time_point>> in_flight;
+        std::string out, in;
+        std::size_t sent = 0, done = 0, next = first;
+        Response response;
+        while (done < n) {
+            while (in_flight.size() < settings.depth && sent < n) {
+                std::size_t p = next % patterns.size();
+                encode_request(&out, Request{settings.mode, settings.limit, patterns[p]});
+                in_flight.emplace_back(p, Clock::now());
+                next += step;
+                ++sent;
+            }
+            for (std::size_t pos = 0; pos < out.size();) {
+                ssize_t k = ::send(fd, out.data() + pos, out.size() - pos, MSG_NOSIGNAL);
+                if (k < 0 && EINTR != errno) {
+                    throw std::system_error(errno, std::generic_category(), "send");
+                }
+                pos += std::max<ssize_t>(k, 0);
+            }
+            out.clear();
+            char buffer[1 << 16];
+            ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+            if (got < 0 && EINTR == errno) {
+                continue;
+            } else if (got <= 0) {
+                throw std::runtime_error(got < 0 ? std::strerror(errno) : "connection closed by the server");
+            }
+            in.append(buffer, got);
+            std::size_t pos = 0;
+            char const *body;
+            std::size_t size;
+            while (take_frame(in, &pos, &body, &size)) {
+                latency->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - in_flight.front().second).count());
+                decode_response(body, size, settings.mode, &response);
+                answer(in_flight.front().first, response);
+                in_flight.pop_front();
+                ++done;
+            }
+            in.erase(0, pos);
+        }
+    }
+
+private:
+    Settings settings;
+    std::vector<std::string> const & patterns;
+    LatencyHistogram *latency;
+    int fd;
+};
+
+static void echo(Response const & r, QueryMode mode, BufferedWriter& out) {
+    if (ok != r.status) {
+        out.write("error");
+    } else if (QueryMode::find == mode) {
+        for (std::size_t k = 0; k < r.occurrences.size(); ++k) {
+            if (k > 0) {
+                out.put(' ');
+            }
+            out.write_decimal(r.occurrences[k].record);
+            out.put(':');
+            out.write_decimal(r.occurrences[k].offset);
+        }
+    } else {
+        out.write_decimal(r.value);
+    }
+    out.put('\n');
+}
+
+int main(int argc, char **argv) {
+    Settings settings {std::string(), QueryMode::exists, 0, 16};
+    std::size_t connections = 4;
+    std::size_t requests = 0;
+    bool echo_answers = false;
+    int modes = 0;
+    std::string path = "-";
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if ("--exists" == a || "--count" == a || "--find" == a) {
+            settings.mode = "--exists" == a ? QueryMode::exists : "--count" == a ? QueryMode::count : QueryMode::find;
+            ++modes;
+        } else if ("--echo" == a) {
+            echo_answers = true;
+        } else if (i + 1 < argc && "-s" == a) {
+            settings.socket_path = argv[++i];
+        } else if (i + 1 < argc && "--limit" == a) {
+            settings.limit = std::strtoull(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && "--connections" == a) {
+            connections = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (i + 1 < argc && "--depth" == a) {
+            settings.depth = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (i + 1 < argc && "--requests" == a) {
+            requests = std::strtoull(argv[++i], nullptr, 10);
+        } else if (a.size() < 2 || '-' != a[0]) {
+            path = a;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (settings.socket_path.empty() || modes > 1) {
+        usage();
+        return 2;
+    }
+    try {
+        std::vector<std::string> patterns;
+        {
+            std::unique_ptr<std::FILE, int(*)(std::FILE*)> f(
+                "-" == path ? stdin : std::fopen(path.c_str(), "rb"), [](std::FILE *f) {
+                    return f == stdin ? 0 : std::fclose(f);
+                });
+            if (!f) {
+                throw std::runtime_error("cannot open " + path);
+            }
+            BufferedReader in(f.get());
+            std::string line;
+            while (in.read_line(&line)) {
+                patterns.push_back(line);
+            }
+        }
+        if (patterns.empty()) {
+            throw std::runtime_error("no patterns");
+        }
+        if (0 == requests) {
+            requests = patterns.size();
+        }
+        LatencyHistogram latency;
+        if (echo_answers) {
+            BufferedWriter out(stdout);
+            Client(settings, patterns, &latency).run(0, 1, requests, [&](std::size_t, Response const & r) {
+                echo(r, settings.mode, out);
+            });
+            return 0;
+        }
+
+        // Connect all the clients before starting the clock
+        std::vector<std::unique_ptr<Client>> clients;
+        for (std::size_t c = 0; c < connections; ++c) {
+            clients.emplace_back(new Client(settings, patterns, &latency));
+        }
+        std::vector<std::uint64_t> found(connections, 0);
+        std::vector<std::string> errors(connections);
+        auto start = Clock::now();
+        run_parallel(connections, connections, [&](std::size_t c) {
+            try {
+                clients[c]->run(c, connections, requests * (c + 1) / connections - requests * c / connections,
+                                [&](std::size_t, Response const & r) {
+                    found[c] += 0 != r.value;
+                });
+            } catch (std::exception const & e) {
+                errors[c] = e.what();
+            }
+        });
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        for (auto const & e : errors) {
+            if (!e.empty()) {
+                throw std::runtime_error(e);
+            }
+        }
+        std::uint64_t hits = 0;
+        for (auto f : found) {
+            hits += f;
+        }
+        std::cout << "stree_load: " << latency.count() << " requests in " << seconds << " s, "
+                  << latency.count() / std::max(seconds, 1e-9) << " requests/s, " << hits << " found; latency us:";
+        for (double q : {0.5, 0.9, 0.99, 0.999}) {
+            std::cout << " p" << q * 100 << " " << latency.percentile(q) / 1000.0;
+        }
+        std::cout << " mean " << latency.sum() / std::max<double>(1, latency.count()) / 1000.0 << std::endl;
+    } catch (std::exception const & e) {
+        std::cerr << "stree_load: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,375 @@
+// stree_server - Serve an stree index over a Unix domain socket
+//
+//   stree_server -i FILE -s SOCKET [--threads N] [--max-batch N] [--stats]
+//
+// Builds the trees of a file written by `stree build` once (the file holds
+// the records, the trees are rebuilt from it as by `stree query`), and
+// answers the requests of any number of local clients (protocol in
+// streeprotocol.h) until SIGINT or SIGTERM.
+//
+// A single thread multiplexes the connections with epoll. Every wakeup reads
+// what all the ready connections sent, and the complete requests (at most
+// --max-batch, default 65536) form one batch, answered on --threads threads
+// (default: one per hardware thread) like the batches of `stree query`. The
+// more concurrent the clients, the larger the batches: requests arriving
+// while a batch is answered wait for the next one. A connection whose
+// responses are not read fast enough is not read until they are sent. A
+// frame larger than the protocol allows gets a malformed response, after
+// the responses to the requests before it, and the connection is closed
+// once they are sent: the stream cannot be resynchronized.
+//
+// --stats prints the number of requests and batches on exit.
+
+#include "streeprotocol.h"
+
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace stree_protocol;
+
+// Responses queued beyond this stop the reading of a connection
+static const std::size_t max_output = 1 << 22;
+// Unparsed input beyond this (room for a frame of any size) waits in the socket
+static const std::size_t max_input = 2 * max_frame;
+
+static void usage() {
+    std::cerr << "usage: stree_server -i FILE -s SOCKET [--threads N] [--max-batch N] [--stats]" << std::endl;
+}
+
+static void check(bool ok, char const *what) {
+    if (!ok) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+}
+
+struct Connection {
+    int fd;
+    // Received bytes, parsed up to in_pos
+    std::string in;
+    std::size_t in_pos;
+    // Responses, sent up to out_pos
+    std::string out;
+    std::size_t out_pos;
+    // The client closed its side, or the connection failed
+    bool peer_closed;
+    bool failed;
+    // A protocol error was answered: nothing more is read, and the
+    // connection is closed once the responses are sent
+    bool closing;
+    // Complete requests may be left in `in` (the batch was full, or too
+    // many responses are queued)
+    bool stalled;
+    // Events the connection is registered for
+    std::uint32_t events;
+
+    explicit Connection(int f) : fd(f), in_pos(0), out_pos(0), peer_closed(false), failed(false), closing(false),
+      stalled(false), events(EPOLLIN) {}
+
+    ~Connection() {
+        close(fd);
+    }
+};
+
+class Server {
+public:
+    Server(StreeIndex const & idx, std::string const & path, std::size_t threads, std::size_t max_batch) :
+      index(idx),
+      socket_path(path),
+      threads(threads),
+      max_batch(max_batch),
+      requests(0),
+      batches(0),
+      largest_batch(0),
+      accepted(0)
+    {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            throw std::invalid_argument("socket path too long: " + path);
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        check(listener >= 0, "socket");
+        unlink(path.c_str());
+        check(0 == bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "bind");
+        check(0 == listen(listener, SOMAXCONN), "listen");
+
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigprocmask(SIG_BLOCK, &signals, nullptr);
+        signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        check(signal_fd >= 0, "signalfd");
+
+        epoll = epoll_create1(EPOLL_CLOEXEC);
+        check(epoll >= 0, "epoll_create1");
+        watch(listener, EPOLLIN, EPOLL_CTL_ADD);
+        watch(signal_fd, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+    ~Server() {
+        connections.clear();
+        close(epoll);
+        close(signal_fd);
+        close(listener);
+        unlink(socket_path.c_str());
+    }
+
+    // run - Serve until a signal
+    void run() {
+        std::vector<epoll_event> events(256);
+        // Connections holding complete requests beyond the last batch
+        bool backlog = false;
+        for (;;) {
+            int n = epoll_wait(epoll, events.data(), static_cast<int>(events.size()), backlog ? 0 : -1);
+            if (n < 0 && EINTR == errno) {
+                continue;
+            }
+            check(n >= 0, "epoll_wait");
+            for (int e = 0; e < n; ++e) {
+                int fd = events[e].data.fd;
+                if (fd == signal_fd) {
+                    return;
+                } else if (fd == listener) {
+                    accept_all();
+                    continue;
+                }
+                Connection & c = *connections.at(fd);
+                if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    receive(c);
+                }
+                if (events[e].events & EPOLLOUT) {
+                    send(c);
+                }
+            }
+            backlog = serve_batch();
+        }
+    }
+
+    void print_stats(std::ostream& os) const {
+        os << "stree_server: " << accepted << " connections, " << requests << " requests in " << batches
+           << " batches (mean " << (batches ? double(requests) / batches : 0.0) << ", largest " << largest_batch
+           << ")" << std::endl;
+    }
+
+private:
+    struct Pending {
+        Connection *connection;
+        Request request;
+        std::string response;
+    };
+
+    void watch(int fd, std::uint32_t events, int op) {
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.fd = fd;
+        check(0 == epoll_ctl(epoll, op, fd, &ev), "epoll_ctl");
+    }
+
+    void accept_all() {
+        for (;;) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno) {
+                    std::cerr << "stree_server: accept: " << std::strerror(errno) << std::endl;
+                }
+                return;
+            }
+            connections[fd].reset(new Connection(fd));
+            watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+            ++accepted;
+        }
+    }
+
+    void receive(Connection & c) {
+        char buffer[1 << 16];
+        // Level-triggered: what is left is read at the next wakeup
+        while (!c.closing && c.in.size() < max_input) {
+            ssize_t got = read(c.fd, buffer, sizeof(buffer));
+            if (got > 0) {
+                c.in.append(buffer, got);
+            } else if (0 == got) {
+                c.peer_closed = true;
+                return;
+            } else if (EINTR != errno) {
+                c.failed = EAGAIN != errno && EWOULDBLOCK != errno;
+                return;
+            }
+        }
+    }
+
+    void send(Connection & c) {
+        while (c.out_pos < c.out.size()) {
+            ssize_t sent = ::send(c.fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos, MSG_NOSIGNAL);
+            if (sent >= 0) {
+                c.out_pos += sent;
+            } else if (EINTR != errno) {
+                c.failed = EAGAIN != errno && EWOULDBLOCK != errno;
+                return;
+            }
+        }
+        c.out.clear();
+        c.out_pos = 0;
+    }
+
+    // serve_batch - Answer the complete requests of all connections (up to
+    // max_batch), send the responses, and close finished connections
+    // Returns whether complete requests are left for the next batch.
+    bool serve_batch() {
+        bool backlog = false;
+        pending.clear();
+        for (auto & entry : connections) {
+            Connection & c = *entry.second;
+            char const *body;
+            std::size_t size;
+            c.stalled = false;
+            while (!c.failed && !c.closing) {
+                if (pending.size() >= max_batch || c.out.size() - c.out_pos >= max_output) {
+                    c.stalled = true;
+                    break;
+                }
+                try {
+                    if (!take_frame(c.in, &c.in_pos, &body, &size)) {
+                        break;
+                    }
+                } catch (std::runtime_error const &) {
+                    // A frame too large, or a length that is no varint
+                    pending.push_back(Pending{&c, Request(), std::string()});
+                    put_frame(&pending.back().response, std::string(1, static_cast<char>(malformed)));
+                    c.closing = true;
+                    c.in.clear();
+                    c.in_pos = 0;
+                    break;
+                }
+                pending.push_back(Pending{&c, Request(), std::string()});
+                if (!decode_request(body, size, &pending.back().request)) {
+                    // Answered right away: a frame holding the status alone
+                    put_frame(&pending.back().response, std::string(1, static_cast<char>(malformed)));
+                }
+            }
+            c.in.erase(0, c.in_pos);
+            c.in_pos = 0;
+        }
+        if (!pending.empty()) {
+            ++batches;
+            requests += pending.size();
+            largest_batch = std::max(largest_batch, pending.size());
+            run_slices(pending.size(), threads, 16, [&](std::size_t begin, std::size_t end, std::size_t) {
+                std::vector<StreeIndex::Occurrence> occurrences;
+                for (std::size_t i = begin; i < end; ++i) {
+                    if (pending[i].response.empty()) {
+                        answer(index, pending[i].request, &pending[i].response, &occurrences);
+                    }
+                }
+            });
+            for (auto & p : pending) {
+                p.connection->out.append(p.response);
+            }
+        }
+        for (auto it = connections.begin(); it != connections.end();) {
+            Connection & c = *it->second;
+            send(c);
+            if (c.failed || ((c.peer_closed || c.closing) && c.out.empty() && !c.stalled)) {
+                it = connections.erase(it);
+                continue;
+            }
+            // Write while responses are left, read while they are few; a
+            // full batch leaves requests for the next one
+            std::uint32_t events = c.out.empty() ? 0u : std::uint32_t(EPOLLOUT);
+            if (c.out.size() - c.out_pos < max_output) {
+                backlog = backlog || c.stalled;
+                if (!c.peer_closed && !c.closing) {
+                    events |= EPOLLIN;
+                }
+            }
+            if (events != c.events) {
+                watch(c.fd, events, EPOLL_CTL_MOD);
+                c.events = events;
+            }
+            ++it;
+        }
+        return backlog;
+    }
+
+    StreeIndex const & index;
+    std::string socket_path;
+    std::size_t threads;
+    std::size_t max_batch;
+    int listener;
+    int signal_fd;
+    int epoll;
+    std::map<int, std::unique_ptr<Connection>> connections;
+    std::vector<Pending> pending;
+    std::uint64_t requests;
+    std::uint64_t batches;
+    std::size_t largest_batch;
+    std::uint64_t accepted;
+};
+
+int main(int argc, char **argv) {
+    std::string index_path, socket_path;
+    std::size_t threads = default_threads();
+    std::size_t max_batch = 1 << 16;
+    bool stats = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if ("--stats" == a) {
+            stats = true;
+        } else if (i + 1 < argc && "-i" == a) {
+            index_path = argv[++i];
+        } else if (i + 1 < argc && "-s" == a) {
+            socket_path = argv[++i];
+        } else if (i + 1 < argc && "--threads" == a) {
+            threads = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (i + 1 < argc && "--max-batch" == a) {
+            max_batch = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (index_path.empty() || socket_path.empty()) {
+        usage();
+        return 2;
+    }
+    try {
+        StreeIndex index;
+        {
+            std::unique_ptr<std::FILE, int(*)(std::FILE*)> f(std::fopen(index_path.c_str(), "rb"), &std::fclose);
+            if (!f) {
+                throw std::runtime_error("cannot open " + index_path);
+            }
+            BufferedReader in(f.get());
+            index.load(in, threads);
+        }
+        Server server(index, socket_path, threads, max_batch);
+        std::cerr << "stree_server: " << index.record_count() << " records, listening on " << socket_path
+                  << std::endl;
+        server.run();
+        if (stats) {
+            server.print_stats(std::cerr);
+        }
+    } catch (std::exception const & e) {
+        std::cerr << "stree_server: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
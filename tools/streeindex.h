@@ -0,0 +1,421 @@
+#ifndef _STREE_INDEX_HPP_INCLUDED_
+#define _STREE_INDEX_HPP_INCLUDED_
+
+// The index of the stree tool: records (lines of text, or whole files) split
+// into shards, one SuffixTree per shard, and the batched execution of
+// queries against it.
+
+#include "suffixtree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// run_parallel - Call @task(i) for i in [0, @n), on at most @threads threads
+template <typename Task>
+void run_parallel(std::size_t n, std::size_t threads, Task task) {
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        for (std::size_t i; (i = next++) < n;) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < std::min(n, threads); ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto & th : pool) {
+        th.join();
+    }
+}
+
+// run_slices - Cut [0, @n) into contiguous slices of at least @min_slice
+// items, at most @threads of them, and call @task(begin, end, slice) for each
+// slice on its own thread (the calling thread takes one)
+template <typename Task>
+std::size_t run_slices(std::size_t n, std::size_t threads, std::size_t min_slice, Task task) {
+    std::size_t slices = std::max<std::size_t>(1, std::min(threads, n / std::max<std::size_t>(1, min_slice)));
+    run_parallel(slices, slices, [&](std::size_t slice) {
+        task(n * slice / slices, n * (slice + 1) / slices, slice);
+    });
+    return slices;
+}
+
+inline std::size_t default_threads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// StreeIndex - Records indexed by a few suffix trees
+//
+// The records are cut into shards of contiguous records with about as many
+// characters each; every shard is a SuffixTree built (and rebuilt when
+// loaded, see save) by its own thread. Queries look into every shard. Occurrences are reported as
+// (record, offset), records being numbered from 0 in input order.
+//
+// A record that is a suffix of a record of the same shard (a duplicate line,
+// say) is rejected by the tree: it is kept as an alias of that record from
+// the offset where it starts, and its occurrences are derived from those of
+// the longer record. These records are counted as dropped; in a shard
+// holding some, count takes time proportional to the number of occurrences,
+// like find_all. Records holding the end token '$' cannot be indexed, and
+// are counted as skipped.
+class StreeIndex {
+public:
+    typedef SuffixTree<char> Tree;
+
+    struct Occurrence {
+        std::uint64_t record;
+        std::uint64_t offset;
+        bool operator<(Occurrence const & o) const {
+            return record < o.record || (record == o.record && offset < o.offset);
+        }
+    };
+
+    StreeIndex() : records(0), characters(0), dropped(0), skipped(0) {}
+
+    // build - Index records
+    // @input[in]: The records
+    // @n_shards[in]: Number of shards (and of building threads)
+    // @max_depth[in]: Depth of truncated trees, 0 for full trees
+    void build(std::vector<std::string> const & input, std::size_t n_shards, Tree::index_type max_depth = 0) {
+        if (!shards.empty()) {
+            throw std::logic_error("StreeIndex: already built");
+        }
+        records = input.size();
+        std::size_t total = 0;
+        for (auto const & r : input) {
+            total += r.size();
+        }
+        characters = total;
+        n_shards = std::max<std::size_t>(1, std::min(n_shards, input.size()));
+        // Contiguous records, a new shard once the current one has its share
+        std::vector<std::size_t> first {0};
+        std::size_t seen = 0;
+        for (std::size_t i = 0; i < input.size(); ++i) {
+            seen += input[i].size();
+            if (first.size() < n_shards && seen >= total / n_shards * first.size() && i + 1 < input.size()) {
+                first.push_back(i + 1);
+            }
+        }
+        first.push_back(input.size());
+        for (std::size_t s = 0; s + 1 < first.size(); ++s) {
+            shards.emplace_back(new Shard(max_depth));
+        }
+        std::vector<std::uint64_t> shard_dropped(shards.size(), 0);
+        std::vector<std::uint64_t> shard_skipped(shards.size(), 0);
+        run_parallel(shards.size(), shards.size(), [&](std::size_t s) {
+            Shard & shard = *shards[s];
+            for (std::size_t i = first[s]; i < first[s + 1]; ++i) {
+                std::string const & r = input[i];
+                if (r.empty() || std::string::npos != r.find('$')) {
+                    ++shard_skipped[s];
+                } else if (shard.tree->add_string(r.begin(), r.end()) < 0) {
+                    shard.add_alias(r, i);
+                    ++shard_dropped[s];
+                } else {
+                    shard.records.push_back(i);
+                }
+            }
+        });
+        for (std::size_t s = 0; s < shards.size(); ++s) {
+            dropped += shard_dropped[s];
+            skipped += shard_skipped[s];
+        }
+    }
+
+    // save - Header ("STIX", version 2), counts, then for each shard its
+    // delta-coded record numbers, its aliases (record, string id, offset)
+    // and its saved tree (see SuffixTree::save), prefixed by its size so
+    // that shards can be loaded concurrently. A saved tree is its strings,
+    // not its nodes: the file is the input of the shards, and persisting
+    // the trees themselves is left for a later format version.
+    void save(BufferedWriter& out) const {
+        out.write("STIX");
+        out.put(2);
+        out.write_varint(records);
+        out.write_varint(characters);
+        out.write_varint(dropped);
+        out.write_varint(skipped);
+        out.write_varint(shards.size());
+        for (auto const & shard : shards) {
+            out.write_varint(shard->records.size());
+            std::uint64_t previous = 0;
+            for (std::uint64_t r : shard->records) {
+                out.write_varint(r - previous);
+                previous = r;
+            }
+            std::size_t n_aliases = 0;
+            for (auto const & a : shard->aliases) {
+                n_aliases += a.second.size();
+            }
+            out.write_varint(n_aliases);
+            for (auto const & a : shard->aliases) {
+                for (Alias const & alias : a.second) {
+                    out.write_varint(alias.record);
+                    out.write_varint(a.first);
+                    out.write_varint(alias.offset);
+                }
+            }
+            std::string blob;
+            {
+                BufferedWriter tree_out(&blob);
+                shard->tree->save(tree_out);
+            }
+            out.write_varint(blob.size());
+            out.write(blob);
+        }
+        out.flush();
+    }
+
+    // load - Read a saved index, rebuilding the shards (as long as the build
+    // took) on up to @threads threads
+    void load(BufferedReader& in, std::size_t threads = default_threads()) {
+        if (!shards.empty()) {
+            throw std::logic_error("StreeIndex: already built");
+        }
+        char magic[5];
+        in.read(magic, 5);
+        if (0 != std::memcmp(magic, "STIX", 4)) {
+            throw std::runtime_error("not an stree index");
+        } else if (2 != magic[4]) {
+            throw std::runtime_error("unsupported stree index version, rebuild it");
+        }
+        records = in.read_varint();
+        characters = in.read_varint();
+        dropped = in.read_varint();
+        skipped = in.read_varint();
+        std::uint64_t n_shards = in.read_varint();
+        std::vector<std::string> blobs;
+        for (std::uint64_t s = 0; s < n_shards; ++s) {
+            shards.emplace_back(new Shard(0));
+            Shard & shard = *shards.back();
+            std::uint64_t n = in.read_varint();
+            std::uint64_t previous = 0;
+            for (std::uint64_t i = 0; i < n; ++i) {
+                previous += in.read_varint();
+                shard.records.push_back(previous);
+            }
+            std::uint64_t n_aliases = in.read_varint();
+            for (std::uint64_t i = 0; i < n_aliases; ++i) {
+                std::uint64_t record = in.read_varint();
+                int id = static_cast<int>(in.read_varint());
+                std::uint64_t offset = in.read_varint();
+                shard.aliases[id].push_back(Alias{record, offset});
+            }
+            std::uint64_t size = in.read_varint();
+            blobs.emplace_back();
+            while (blobs.back().size() < size) {
+                std::size_t done = blobs.back().size();
+                blobs.back().resize(done + std::min<std::uint64_t>(size - done, 1 << 20));
+                in.read(&blobs.back()[done], blobs.back().size() - done);
+            }
+        }
+        run_parallel(shards.size(), threads, [&](std::size_t s) {
+            BufferedReader tree_in(&blobs[s]);
+            shards[s]->tree->load(tree_in);
+            std::string().swap(blobs[s]);
+        });
+    }
+
+    bool contains(std::string const & pattern) const {
+        if (!queryable(pattern)) {
+            return false;
+        }
+        for (auto const & shard : shards) {
+            if (shard->tree->is_substring(pattern.begin(), pattern.end())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::size_t count(std::string const & pattern) const {
+        if (!queryable(pattern)) {
+            return 0;
+        }
+        std::size_t n = 0;
+        for (auto const & shard : shards) {
+            if (shard->aliases.empty()) {
+                n += shard->tree->count(pattern.begin(), pattern.end());
+                continue;
+            }
+            for (auto const & e : shard->tree->find_all(pattern.begin(), pattern.end())) {
+                ++n;
+                shard->for_each_alias(e, [&](std::uint64_t, std::uint64_t) {
+                    ++n;
+                });
+            }
+        }
+        return n;
+    }
+
+    // find_all - Occurrences of a pattern, by record then offset
+    void find_all(std::string const & pattern, std::vector<Occurrence> *out) const {
+        out->clear();
+        if (!queryable(pattern)) {
+            return;
+        }
+        for (auto const & shard : shards) {
+            for (auto const & e : shard->tree->find_all(pattern.begin(), pattern.end())) {
+                out->push_back(Occurrence{shard->records[e.ref_str - 1], std::uint64_t(e.offset)});
+                shard->for_each_alias(e, [&](std::uint64_t record, std::uint64_t offset) {
+                    out->push_back(Occurrence{record, offset});
+                });
+            }
+        }
+        std::sort(out->begin(), out->end());
+    }
+
+    std::uint64_t record_count() const {
+        return records;
+    }
+
+    std::uint64_t character_count() const {
+        return characters;
+    }
+
+    std::uint64_t dropped_count() const {
+        return dropped;
+    }
+
+    std::uint64_t skipped_count() const {
+        return skipped;
+    }
+
+    std::size_t shard_count() const {
+        return shards.size();
+    }
+
+    Tree const & shard(std::size_t s) const {
+        return *shards[s]->tree;
+    }
+
+private:
+    // A record equal to the suffix of a string of the tree from an offset
+    struct Alias {
+        std::uint64_t record;
+        std::uint64_t offset;
+    };
+
+    struct Shard {
+        // Truncated trees are so from their construction
+        std::unique_ptr<Tree> tree;
+        // Record number of each string of the tree (string id - 1)
+        std::vector<std::uint64_t> records;
+        // The records the tree rejected, by the string id they are a suffix of
+        std::unordered_map<int, std::vector<Alias>> aliases;
+        explicit Shard(Tree::index_type max_depth) :
+          tree(max_depth > 0 ? new Tree(max_depth) : new Tree())
+          {}
+
+        // add_alias - Keep record @i, rejected by the tree: its first
+        // occurrence in lexicographic order is followed by the end token, so
+        // it is the suffix the tree found
+        void add_alias(std::string const & r, std::uint64_t i) {
+            Tree::SuffixEntry e;
+            auto cursor = tree->iterate_occurrences(r.begin(), r.end());
+            if (!cursor.next(&e) ||
+                    tree->get_string(e.ref_str).size() != static_cast<std::size_t>(e.offset) + r.size() + 1) {
+                throw std::logic_error("StreeIndex: rejected record not found as a suffix");
+            }
+            aliases[e.ref_str].push_back(Alias{i, std::uint64_t(e.offset)});
+        }
+
+        // for_each_alias - Call @f(record, offset) for the occurrences in
+        // aliased records matching the occurrence @e of a pattern
+        template <typename Function>
+        void for_each_alias(Tree::SuffixEntry const & e, Function f) const {
+            auto it = aliases.find(e.ref_str);
+            if (aliases.end() == it) {
+                return;
+            }
+            // An alias ends with the string: the occurrences starting in it
+            // are in it
+            for (Alias const & a : it->second) {
+                if (std::uint64_t(e.offset) >= a.offset) {
+                    f(a.record, e.offset - a.offset);
+                }
+            }
+        }
+    };
+
+    static bool queryable(std::string const & pattern) {
+        return !pattern.empty() && std::string::npos == pattern.find('$');
+    }
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::uint64_t records;
+    std::uint64_t characters;
+    std::uint64_t dropped;
+    std::uint64_t skipped;
+};
+
+// The answers of `answer_batch`
+enum class QueryMode {
+    // 1 or 0
+    exists,
+    // Number of occurrences
+    count,
+    // "record:offset" pairs separated by spaces
+    find
+};
+
+// answer_batch - Answer a batch of patterns, one line per pattern
+// @index[in]: The index
+// @patterns[in]: The patterns
+// @mode[in]: What to answer
+// @limit[in]: At most that many occurrences per pattern in find mode (0:
+//             all, as in the server protocol)
+// @threads[in]: The batch is cut into this many contiguous slices, each
+//               answered by its own thread into its own buffer
+// @out[out]: Receives the answers, in the order of the patterns
+inline void answer_batch(StreeIndex const & index, std::vector<std::string> const & patterns, QueryMode mode,
+                         std::size_t limit, std::size_t threads, std::string *out) {
+    std::vector<std::string> answers(threads);
+    if (0 == limit) {
+        limit = std::numeric_limits<std::size_t>::max();
+    }
+    std::size_t slices = run_slices(patterns.size(), threads, 256,
+                                    [&](std::size_t begin, std::size_t end, std::size_t slice) {
+        BufferedWriter w(&answers[slice], 1 << 16);
+        std::vector<StreeIndex::Occurrence> occurrences;
+        for (std::size_t i = begin; i < end; ++i) {
+            std::string const & p = patterns[i];
+            switch (mode) {
+            case QueryMode::exists:
+                w.put(index.contains(p) ? '1' : '0');
+                break;
+            case QueryMode::count:
+                w.write_decimal(index.count(p));
+                break;
+            case QueryMode::find:
+                index.find_all(p, &occurrences);
+                for (std::size_t k = 0; k < occurrences.size() && k < limit; ++k) {
+                    if (k > 0) {
+                        w.put(' ');
+                    }
+                    w.write_decimal(occurrences[k].record);
+                    w.put(':');
+                    w.write_decimal(occurrences[k].offset);
+                }
+                break;
+            }
+            w.put('\n');
+        }
+    });
+    out->clear();
+    for (std::size_t slice = 0; slice < slices; ++slice) {
+        out->append(answers[slice]);
+    }
+}
+
+#endif // _STREE_INDEX_HPP_INCLUDED_
@@ -0,0 +1,206 @@
+#ifndef _STREE_PROTOCOL_HPP_INCLUDED_
+#define _STREE_PROTOCOL_HPP_INCLUDED_
+
+// Wire protocol of stree_server
+//
+// Requests and responses are frames: the body length (LEB128 varint) then
+// the body. A client may send any number of requests without waiting; the
+// responses of a connection come back in request order. A frame longer than
+// max_frame gets a malformed response, and the server then closes the
+// connection.
+//
+// Request body:
+//   mode     1 byte: 0 exists, 1 count, 2 find (see QueryMode)
+//   limit    varint: find only, at most that many occurrences (0: all)
+//   pattern  the remaining bytes
+//
+// Response body:
+//   status   1 byte: 0 ok, 1 malformed request
+//   exists:  1 byte, 1 or 0
+//   count:   varint, the number of occurrences
+//   find:    varint, the number of occurrences; varint n, the number
+//            returned; n times varint record, varint offset, by record then
+//            offset
+
+#include "streeindex.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace stree_protocol {
+
+// Larger frames are a protocol error
+const std::size_t max_frame = 1 << 24;
+
+enum Status : unsigned char {
+    ok = 0,
+    malformed = 1
+};
+
+struct Request {
+    QueryMode mode;
+    std::uint64_t limit;
+    std::string pattern;
+};
+
+struct Response {
+    Status status;
+    // 1 or 0 (exists), number of occurrences (count, find)
+    std::uint64_t value;
+    std::vector<StreeIndex::Occurrence> occurrences;
+};
+
+inline void put_varint(std::string *out, std::uint64_t v) {
+    while (v >= 0x80) {
+        out->push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out->push_back(static_cast<char>(v));
+}
+
+// get_varint - Decode a varint at *@p, advancing it; false if the input
+// ends first
+inline bool get_varint(char const **p, char const *end, std::uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; *p < end; shift += 7) {
+        if (shift > 63) {
+            throw std::runtime_error("malformed varint");
+        }
+        unsigned char byte = static_cast<unsigned char>(*(*p)++);
+        *v |= std::uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// take_frame - The next complete frame of @in from @pos, advancing @pos past
+// it; false (and @pos unchanged) if the frame is not complete yet
+inline bool take_frame(std::string const & in, std::size_t *pos, char const **body, std::size_t *size) {
+    char const *p = in.data() + *pos;
+    char const *end = in.data() + in.size();
+    std::uint64_t n;
+    if (!get_varint(&p, end, &n)) {
+        return false;
+    }
+    if (n > max_frame) {
+        throw std::runtime_error("frame too large");
+    }
+    if (static_cast<std::uint64_t>(end - p) < n) {
+        return false;
+    }
+    *body = p;
+    *size = n;
+    *pos = p + n - in.data();
+    return true;
+}
+
+// put_frame - Append the frame of @body to @out
+inline void put_frame(std::string *out, std::string const & body) {
+    put_varint(out, body.size());
+    out->append(body);
+}
+
+inline void encode_request(std::string *out, Request const & r) {
+    std::string body;
+    body.push_back(static_cast<char>(r.mode));
+    put_varint(&body, QueryMode::find == r.mode ? r.limit : 0);
+    body.append(r.pattern);
+    put_frame(out, body);
+}
+
+// decode_request - false if the body is malformed
+inline bool decode_request(char const *body, std::size_t size, Request *r) {
+    char const *end = body + size;
+    if (body == end || static_cast<unsigned char>(*body) > static_cast<unsigned char>(QueryMode::find)) {
+        return false;
+    }
+    r->mode = static_cast<QueryMode>(*body++);
+    if (!get_varint(&body, end, &r->limit)) {
+        return false;
+    }
+    r->pattern.assign(body, end);
+    return true;
+}
+
+// answer - Append the response frame of @r to @out
+// @occurrences[in]: Scratch space of find requests
+inline void answer(StreeIndex const & index, Request const & r, std::string *out,
+                   std::vector<StreeIndex::Occurrence> *occurrences) {
+    std::string body(1, static_cast<char>(ok));
+    switch (r.mode) {
+    case QueryMode::exists:
+        body.push_back(index.contains(r.pattern) ? 1 : 0);
+        break;
+    case QueryMode::count:
+        put_varint(&body, index.count(r.pattern));
+        break;
+    case QueryMode::find: {
+        index.find_all(r.pattern, occurrences);
+        std::size_t n = occurrences->size();
+        if (r.limit > 0 && r.limit < n) {
+            n = r.limit;
+        }
+        put_varint(&body, occurrences->size());
+        put_varint(&body, n);
+        for (std::size_t k = 0; k < n; ++k) {
+            put_varint(&body, (*occurrences)[k].record);
+            put_varint(&body, (*occurrences)[k].offset);
+        }
+        break;
+    }
+    }
+    put_frame(out, body);
+}
+
+// decode_response - Decode the response to a request of mode @mode; throws
+// std::runtime_error if the body is malformed
+inline void decode_response(char const *body, std::size_t size, QueryMode mode, Response *r) {
+    char const *end = body + size;
+    auto varint = [&]() {
+        std::uint64_t v;
+        if (!get_varint(&body, end, &v)) {
+            throw std::runtime_error("truncated response");
+        }
+        return v;
+    };
+    if (body == end) {
+        throw std::runtime_error("truncated response");
+    }
+    r->status = static_cast<Status>(*body++);
+    r->value = 0;
+    r->occurrences.clear();
+    if (ok != r->status) {
+        return;
+    }
+    switch (mode) {
+    case QueryMode::exists:
+        if (body == end) {
+            throw std::runtime_error("truncated response");
+        }
+        r->value = static_cast<unsigned char>(*body++);
+        break;
+    case QueryMode::count:
+        r->value = varint();
+        break;
+    case QueryMode::find: {
+        r->value = varint();
+        std::uint64_t n = varint();
+        if (n > size) {
+            throw std::runtime_error("malformed response");
+        }
+        for (std::uint64_t k = 0; k < n; ++k) {
+            std::uint64_t record = varint();
+            r->occurrences.push_back(StreeIndex::Occurrence{record, varint()});
+        }
+        break;
+    }
+    }
+}
+
+} // namespace stree_protocol
+
+#endif // _STREE_PROTOCOL_HPP_INCLUDED_
@@ -0,0 +1,339 @@
+#ifndef _WORD_SUFFIX_TREE_HPP_INCLUDED_
+#define _WORD_SUFFIX_TREE_HPP_INCLUDED_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+
+#include "suffixtree.h"
+
+// A token of a text: its normalized form and the byte offset where it starts
+struct WordToken {
+    std::string word;
+    std::size_t offset;
+    WordToken(std::string w, std::size_t off) : word(std::move(w)), offset(off) {}
+};
+
+// WhitespaceTokenizer - Tokens are the maximal runs of non-space characters
+struct WhitespaceTokenizer {
+    void operator()(std::string const & text, std::vector<WordToken> *tokens) const {
+        std::size_t i = 0;
+        while (i < text.size()) {
+            while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) {
+                ++i;
+            }
+            std::size_t start = i;
+            while (i < text.size() && !std::isspace(static_cast<unsigned char>(text[i]))) {
+                ++i;
+            }
+            if (start < i) {
+                tokens->push_back(WordToken(text.substr(start, i - start), start));
+            }
+        }
+    }
+};
+
+// AlnumTokenizer - Tokens are the maximal runs of ASCII letters and digits,
+// lowercased: punctuation and case do not split phrases
+struct AlnumTokenizer {
+    void operator()(std::string const & text, std::vector<WordToken> *tokens) const {
+        std::size_t i = 0;
+        while (i < text.size()) {
+            while (i < text.size() && !std::isalnum(static_cast<unsigned char>(text[i]))) {
+                ++i;
+            }
+            std::size_t start = i;
+            std::string word;
+            for (; i < text.size() && std::isalnum(static_cast<unsigned char>(text[i])); ++i) {
+                word.push_back(std::tolower(static_cast<unsigned char>(text[i])));
+            }
+            if (!word.empty()) {
+                tokens->push_back(WordToken(std::move(word), start));
+            }
+        }
+    }
+};
+
+// WordSuffixTree - Generalized suffix tree of documents over their words
+//
+// The documents are split by a tokenizer (any callable
+// `void(std::string const &, std::vector<WordToken> *)`), each distinct word
+// gets an id (1, 2, ...; 0 is the end token) and the tree is a
+// SuffixTree<std::uint32_t, 0> of the id sequences. It has one leaf per
+// word position instead of one per character, and a phrase query follows one
+// transition per word.
+//
+// Phrases are tokenized the same way. Positions (SuffixEntry offsets, repeat
+// and substring lengths) count words; `char_offset` maps a word position back
+// to the document text. Documents are numbered 1, 2, ... in the order they
+// are added. As in StreeIndex, a document whose word sequence is a suffix of
+// a previous one (which the tree rejects) is kept as an alias of that
+// document from the position where it starts: its occurrences are derived
+// from those of the longer document. In a tree holding aliases, count takes
+// time proportional to the number of occurrences, like find_all.
+template <typename Tokenizer = WhitespaceTokenizer>
+class WordSuffixTree {
+public:
+    typedef std::uint32_t word_id;
+    typedef SuffixTree<word_id, 0> tree_type;
+    typedef typename tree_type::string phrase_type;
+    typedef typename tree_type::index_type index_type;
+    typedef typename tree_type::SuffixEntry SuffixEntry;
+    typedef typename tree_type::SubstringEntry SubstringEntry;
+    typedef typename tree_type::Repeat Repeat;
+
+    static const word_id no_word = 0;
+
+private:
+    // Where the words of a document are: a string of the tree, from a word
+    // position (0 unless the document is an alias)
+    struct Placement {
+        int ref_str;
+        index_type offset;
+    };
+
+    // A document equal to the suffix of a string of the tree from a position
+    struct Alias {
+        int document;
+        index_type offset;
+    };
+
+    Tokenizer tokenizer;
+    tree_type tree;
+    std::unordered_map<std::string, word_id> ids;
+    std::vector<std::string> words;
+    // By document id - 1: where its words are, and the byte offset of each
+    // of them in its text
+    std::vector<Placement> placements;
+    std::vector<std::vector<std::size_t>> offsets;
+    // Document id of each string of the tree (string id - 1)
+    std::vector<int> documents;
+    // The documents the tree rejected, by the string id they are a suffix of
+    std::unordered_map<int, std::vector<Alias>> aliases;
+
+    // intern - The id of a word, new words getting the next ids in @fresh
+    // (committed to the vocabulary by the caller)
+    word_id intern(std::string const & word, std::unordered_map<std::string, word_id> *fresh) const {
+        auto it = ids.find(word);
+        if (ids.end() != it) {
+            return it->second;
+        }
+        word_id id = words.size() + fresh->size() + 1;
+        return fresh->emplace(word, id).first->second;
+    }
+
+    // The ids of a phrase; false if a word never occurs in the documents
+    bool lookup(std::string const & text, phrase_type *phrase) const {
+        std::vector<WordToken> tokens;
+        tokenizer(text, &tokens);
+        for (auto const & t : tokens) {
+            auto it = ids.find(t.word);
+            if (ids.end() == it) {
+                return false;
+            }
+            phrase->push_back(it->second);
+        }
+        return true;
+    }
+
+    // add_alias - Keep a document the tree rejected: its first occurrence in
+    // lexicographic order is followed by the end token, so it is the suffix
+    // the tree found
+    Placement add_alias(phrase_type const & phrase, int document) {
+        SuffixEntry e;
+        auto cursor = tree.iterate_occurrences(phrase.begin(), phrase.end());
+        if (!cursor.next(&e) ||
+                tree.get_string(e.ref_str).size() != static_cast<std::size_t>(e.offset) + phrase.size() + 1) {
+            throw std::logic_error("WordSuffixTree: rejected document not found as a suffix");
+        }
+        aliases[e.ref_str].push_back(Alias{document, e.offset});
+        return Placement{e.ref_str, e.offset};
+    }
+
+    // for_each_occurrence - Call @f(SuffixEntry) for the occurrence @e of a
+    // phrase in the tree, then for those in the documents aliasing it
+    template <typename Function>
+    void for_each_occurrence(SuffixEntry const & e, Function f) const {
+        f(SuffixEntry(documents[e.ref_str - 1], e.offset));
+        auto it = aliases.find(e.ref_str);
+        if (aliases.end() == it) {
+            return;
+        }
+        // An alias ends with the string: the occurrences starting in it are
+        // in it
+        for (Alias const & a : it->second) {
+            if (e.offset >= a.offset) {
+                f(SuffixEntry(a.document, e.offset - a.offset));
+            }
+        }
+    }
+
+    // Throws unless @document is the id of a document
+    void check_document(int document) const {
+        if (document < 1 || static_cast<std::size_t>(document) > placements.size()) {
+            throw std::out_of_range("WordSuffixTree: no such document");
+        }
+    }
+
+public:
+    explicit WordSuffixTree(Tokenizer t = Tokenizer()) : tokenizer(t) {}
+
+    // add_document - Tokenize a text and add its words to the tree
+    // Returns the id of the document (1, 2, ...). The vocabulary is left
+    // unchanged if the tree throws.
+    int add_document(std::string const & text) {
+        std::vector<WordToken> tokens;
+        tokenizer(text, &tokens);
+        std::unordered_map<std::string, word_id> fresh;
+        phrase_type phrase;
+        std::vector<std::size_t> starts;
+        phrase.reserve(tokens.size());
+        starts.reserve(tokens.size());
+        for (auto const & t : tokens) {
+            phrase.push_back(intern(t.word, &fresh));
+            starts.push_back(t.offset);
+        }
+        int document = placements.size() + 1;
+        int id = tree.add_string(phrase.begin(), phrase.end());
+        if (0 < id) {
+            documents.push_back(document);
+            placements.push_back(Placement{id, 0});
+        } else {
+            // A suffix of a document holds no new word
+            placements.push_back(add_alias(phrase, document));
+        }
+        offsets.push_back(std::move(starts));
+        words.resize(words.size() + fresh.size());
+        for (auto & w : fresh) {
+            words[w.second - 1] = w.first;
+            ids.insert(std::move(w));
+        }
+        return document;
+    }
+
+    // contains - Whether a phrase occurs in the documents
+    bool contains(std::string const & text) const {
+        phrase_type phrase;
+        return lookup(text, &phrase) && tree.is_substring(phrase.begin(), phrase.end());
+    }
+
+    // count - Number of occurrences of a phrase
+    std::size_t count(std::string const & text) const {
+        phrase_type phrase;
+        if (!lookup(text, &phrase)) {
+            return 0;
+        }
+        if (aliases.empty()) {
+            return tree.count(phrase.begin(), phrase.end());
+        }
+        std::size_t n = 0;
+        for (auto const & e : tree.find_all(phrase.begin(), phrase.end())) {
+            for_each_occurrence(e, [&n](SuffixEntry const &) {
+                ++n;
+            });
+        }
+        return n;
+    }
+
+    // find_all - Occurrences of a phrase, as (document id, word position)
+    // in the lexicographic order of the word suffixes starting with them
+    std::vector<SuffixEntry> find_all(std::string const & text) const {
+        std::vector<SuffixEntry> result;
+        phrase_type phrase;
+        if (!lookup(text, &phrase)) {
+            return result;
+        }
+        for (auto const & e : tree.find_all(phrase.begin(), phrase.end())) {
+            for_each_occurrence(e, [&result](SuffixEntry const & o) {
+                result.push_back(o);
+            });
+        }
+        return result;
+    }
+
+    // char_offset - Byte offset in its document of the word at a position
+    // Throws std::out_of_range if there is no such word.
+    std::size_t char_offset(SuffixEntry const & e) const {
+        check_document(e.ref_str);
+        std::vector<std::size_t> const & starts = offsets[e.ref_str - 1];
+        if (e.offset < 0 || static_cast<std::size_t>(e.offset) >= starts.size()) {
+            throw std::out_of_range("WordSuffixTree: word position out of range");
+        }
+        return starts[e.offset];
+    }
+
+    // phrase - The words of a document starting at a word position
+    // @length[in]: Number of words
+    // Throws std::out_of_range if the document has no such words.
+    std::vector<std::string> phrase(SuffixEntry const & e, index_type length) const {
+        check_document(e.ref_str);
+        std::size_t size = offsets[e.ref_str - 1].size();
+        if (e.offset < 0 || length < 0 || static_cast<std::size_t>(e.offset) > size ||
+                static_cast<std::size_t>(length) > size - e.offset) {
+            throw std::out_of_range("WordSuffixTree: phrase out of range");
+        }
+        Placement const & p = placements[e.ref_str - 1];
+        phrase_type const & s = tree.get_string(p.ref_str);
+        std::vector<std::string> result;
+        for (index_type i = p.offset + e.offset; i < p.offset + e.offset + length; ++i) {
+            result.push_back(words[s[i] - 1]);
+        }
+        return result;
+    }
+
+    // longest_common_phrase - Longest phrase shared by several documents
+    // @min_documents[in]: How many of the documents the tree holds must
+    // contain it (0: all); aliases are not counted
+    SubstringEntry longest_common_phrase(std::size_t min_documents = 0) const {
+        SubstringEntry best = tree.longest_common_substring(min_documents);
+        if (0 < best.ref_str) {
+            best.ref_str = documents[best.ref_str - 1];
+        }
+        return best;
+    }
+
+    // repeats - Right-maximal repeated phrases, lengths in words
+    // Counted over the documents the tree holds, aliases excluded.
+    std::vector<Repeat> repeats(index_type min_length = 1) const {
+        std::vector<Repeat> result = tree.repeats(min_length);
+        for (Repeat & r : result) {
+            r.first.ref_str = documents[r.first.ref_str - 1];
+        }
+        return result;
+    }
+
+    // The word of an id
+    std::string const & word(word_id id) const {
+        return words[id - 1];
+    }
+
+    // The id of a word, no_word if it does not occur
+    word_id id(std::string const & word) const {
+        auto it = ids.find(word);
+        return (ids.end() == it) ? word_id(no_word) : it->second;
+    }
+
+    std::size_t vocabulary_size() const {
+        return words.size();
+    }
+
+    std::size_t document_count() const {
+        return placements.size();
+    }
+
+    // Number of documents kept as aliases
+    std::size_t alias_count() const {
+        return placements.size() - documents.size();
+    }
+
+    // The underlying tree over word ids, for traversals and exports; its
+    // string ids are not document ids when some documents are aliases
+    tree_type const & word_tree() const {
+        return tree;
+    }
+};
+
+#endif // _WORD_SUFFIX_TREE_HPP_INCLUDED_